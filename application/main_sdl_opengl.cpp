@@ -1,5 +1,8 @@
 #include "yacvat/version.h"
 #include "yacvat/app.h"
+#include "yacvat/wakeup.h"
+#include "yacvat/startup.h"
+#include "yacvat/frame_profile.h"
 
 #include "imgui.h"
 #include "imgui_impl_sdl.h"
@@ -8,6 +11,9 @@
 
 #include <filesystem>
 #include <stdio.h>
+#include <chrono>
+#include <algorithm>
+#include <sys/resource.h>
 #include "getopt.h"
 #include <SDL.h>
 #if defined(IMGUI_IMPL_OPENGL_ES2)
@@ -16,19 +22,37 @@
 #include <SDL_opengl.h>
 #endif
 
+static const Uint32 BUSY_TIMEOUT = 100;  // ms between two frames while background work is shown
+static const Uint32 TEXT_TIMEOUT = 500;  // ms between two frames while typing (blink of the cursor)
+static const Uint32 IDLE_TIMEOUT = 1000; // ms between two frames when nothing happens
+static const int SETTLE_FRAMES = 3;      // frames drawn after an event (hover states, layout of new windows)
+
 // Main code
 int main(int argc, char **argv)
 {
+    startup_begin();
+
     // logs level
     spdlog::set_level(spdlog::level::critical);
 
     int c;
     int verbose_flag = 0;
     int version_flag = 0;
+    int no_idle_flag = 0;
+    int cpu_report_flag = 0;
+    int no_baked_fonts_flag = 0;
+    int startup_benchmark_flag = 0;
+    int no_session_flag = 0;
     static struct option long_options[] =
         {
             {"verbose", no_argument, &verbose_flag, 1},
-            {"version", no_argument, &version_flag, 1}};
+            {"version", no_argument, &version_flag, 1},
+            {"no-idle", no_argument, &no_idle_flag, 1},       // draw continuously (the behaviour of the versions before the idle mode)
+            {"cpu-report", no_argument, &cpu_report_flag, 1}, // print the cpu time used when quitting
+            {"no-baked-fonts", no_argument, &no_baked_fonts_flag, 1}, // rasterise the fonts at startup (to compare the startup times)
+            {"startup-benchmark", no_argument, &startup_benchmark_flag, 1}, // print the startup timeline and quit after the first frame
+            {"no-session", no_argument, &no_session_flag, 1},               // start on the welcome popup, the session is neither restored nor saved
+            {0, 0, 0, 0}};
 
     int option_index;
     while ((c = getopt_long(argc, argv, ":::", long_options, &option_index)) != -1)
@@ -59,11 +83,14 @@ int main(int argc, char **argv)
     // Setup SDL
     // (Some versions of SDL before <2.0.10 appears to have performance/stalling issues on a minority of Windows systems,
     // depending on whether SDL_INIT_GAMECONTROLLER is enabled or disabled.. updating to latest version of SDL is recommended!)
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0)
+    // The game controllers (enumeration of the input devices) are initialised after the first frame.
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0)
     {
         printf("Error: %s\n", SDL_GetError());
         return -1;
     }
+    ui_wakeup_init();
+    startup_mark("SDL");
 
     // Decide GL+GLSL versions
 #if defined(IMGUI_IMPL_OPENGL_ES2)
@@ -100,6 +127,7 @@ int main(int argc, char **argv)
     SDL_GLContext gl_context = SDL_GL_CreateContext(window);
     SDL_GL_MakeCurrent(window, gl_context);
     SDL_GL_SetSwapInterval(1); // Enable vsync
+    startup_mark("window and GL context");
 
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
@@ -112,10 +140,18 @@ int main(int argc, char **argv)
     // Setup Platform/Renderer backends
     ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
     ImGui_ImplOpenGL3_Init(glsl_version);
+    startup_mark("ImGui");
 
     // context application
     AnnotationApp app;
-    app.ui_initialize();
+    startup_mark("application");
+    app.ui_initialize(!no_baked_fonts_flag);
+    startup_mark("style and fonts");
+    if (!no_session_flag)
+    {
+        app.restore_session();
+        startup_mark("session");
+    }
 
     // Our state
     bool show_demo_window = false;
@@ -124,6 +160,11 @@ int main(int argc, char **argv)
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
     // Main loop
+    // The loop sleeps in SDL_WaitEventTimeout when nothing changes : it draws a few frames after each
+    // input, a few frames per second while background work is shown, and when a job wakes it up.
+    auto start_time = std::chrono::steady_clock::now();
+    long frames = 0;
+    int settle = SETTLE_FRAMES;
     bool done = false;
     while (!done)
     {
@@ -133,17 +174,39 @@ int main(int argc, char **argv)
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application, or clear/overwrite your copy of the keyboard data.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
         SDL_Event event;
-        while (SDL_PollEvent(&event))
+        bool waited = false;
+        if (!no_idle_flag && (settle <= 0))
         {
-            ImGui_ImplSDL2_ProcessEvent(&event);
-            if (event.type == SDL_QUIT)
-                done = true;
-            if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
-                done = true;
+            Uint32 timeout = app.animating() ? BUSY_TIMEOUT : (io.WantTextInput ? TEXT_TIMEOUT : IDLE_TIMEOUT);
+            waited = (SDL_WaitEventTimeout(&event, timeout) != 0);
+        }
+        settle--;
+
+        // the frame is timed from here, the wait is not part of it
+        frame_profile_begin();
+        {
+            FrameTimer timer(PHASE_EVENTS);
+            while (waited || SDL_PollEvent(&event))
+            {
+                waited = false;
+
+                // a background job only asks for a frame
+                if (ui_wakeup_event(event))
+                    continue;
+
+                settle = SETTLE_FRAMES;
+                ImGui_ImplSDL2_ProcessEvent(&event);
+                if (event.type == SDL_QUIT)
+                    done = true;
+                if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
+                    done = true;
+            }
         }
 
-        // Start the Dear ImGui frame
+        // Start the Dear ImGui frame (the first one creates the shaders and the font texture)
         ImGui_ImplOpenGL3_NewFrame();
+        if (frames == 0)
+            startup_mark("GL objects");
         ImGui_ImplSDL2_NewFrame();
         ImGui::NewFrame();
 
@@ -157,16 +220,56 @@ int main(int argc, char **argv)
         // render main app window
         app.ui_main_window();
 
+        // frame profile overlay : ctrl+p
+        if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_P, false))
+            frame_profile_enable(!frame_profile_flag);
+        if (frame_profile_flag)
+            frame_profile_window();
+
         // Rendering
-        ImGui::Render();
-        glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-        glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
-        glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        SDL_GL_SwapWindow(window);
+        {
+            FrameTimer timer(PHASE_RENDER);
+            ImGui::Render();
+            glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
+            glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
+            glClear(GL_COLOR_BUFFER_BIT);
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        {
+            FrameTimer timer(PHASE_SWAP);
+            SDL_GL_SwapWindow(window);
+        }
+        frame_profile_end();
+        frames++;
+
+        // the ui is on screen : the rest of the initialisation is off the critical path
+        if (frames == 1)
+        {
+            startup_mark("first frame");
+            startup_report(startup_benchmark_flag);
+            if (startup_benchmark_flag)
+                done = true;
+            else if (SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) != 0)
+                spdlog::warn("No game controller support : {}", SDL_GetError());
+        }
+    }
+
+    // whole process : ui and background threads
+    if (cpu_report_flag)
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        double cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        printf("CPU time %.2f s over %.1f s (%.1f%% of a core), %ld frames drawn (%.1f per second)\n", cpu, wall, 100.0 * cpu / std::max(wall, 1e-3), frames, frames / std::max(wall, 1e-3));
     }
 
+    // for the next launch
+    if (!no_session_flag)
+        app.save_session();
+
     // Cleanup
+    app.release_gl();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
@@ -9,6 +9,7 @@
 #include "fsm.h"
 #include "imgui.h"
 #include "rectangle.h"
+#include "overlay.h"
 
 /*
 
@@ -71,9 +72,12 @@ public:
     void set_color(float color[4]);    // set color
     void draw_area(void);              // draw itself on picture
     void draw_point(void);             // draw itself on picture
-    void update_point(void);           // update fsm
-    void update_area(void);            // update fsm
+    void overlay_area(OverlayRenderer &overlay);  // same as draw_area, batched in the overlay
+    void overlay_point(OverlayRenderer &overlay); // same as draw_point, batched in the overlay
+    void update_point(vec2f origin, float zoom); // update fsm, the box is shown at origin + zoom * rect_on_image
+    void update_area(vec2f origin, float zoom);  // update fsm, the box is shown at origin + zoom * rect_on_image
     void update_bounding_box(void);    // update inner and outer hover box;
+    void rescale(float ratio);         // resize the coordinates on image when the display scale changes
 
     // attributes
     Rectangle rect_on_image;                                              // coordinates on image : x_start, y_start, x_end, y_end
@@ -87,12 +91,14 @@ public:
 private:
     vec2f offset;           // mouse to box center off when starting to drag
     int delta;              // offset to compute bounding boxes from the actual annotation box
-    vec2f window_pos;       // window position on screen
+    vec2f window_pos;       // position on screen of the origin of the image
+    float zoom;             // screen pixels per unit of rect_on_image
     Rectangle rect;         // actual annotation box on screen
     Rectangle outer_rect;   // bounding box to detect mouse hover
     Rectangle inner_rect;   // bounding box to detect mouse hover
     bool dragging_flag;     // is the instance being dragged
     Direction resizing_dir; // is the instance being resized (!=0)
+    bool refresh_flag;      // force the update of the box on screen
 };
 
 class Annotation
@@ -7,22 +7,60 @@
 #include <set>
 #include <fstream>
 #include <map>
+#include <unordered_map>
 
 #include <SDL_opengl.h>
 #include "annotations.h"
+#include "shards.h"
+#include "yolo.h"
+#include "voc.h"
+#include "tfrecord.h"
+#include "thread_pool.h"
+#include "scanner.h"
+#include "watcher.h"
+#include "image_index.h"
+#include "image_orders.h"
+#include "array_view.h"
+#include "video_source.h"
+#include "duplicates.h"
+#include "mipmaps.h"
+#include "minimap.h"
+#include "thumbnails.h"
+#include "thumbnail_atlas.h"
+#include "thumbnail_grid.h"
+#include "boxes.h"
+#include "decode_ahead.h"
+#include "session.h"
 #include "nlohmann/json.hpp"
 
+typedef struct
+{
+    double first_pixel;     // ms from the click to the first frame showing the image (its thumbnail or the full image)
+    double full;            // ms to the full resolution
+    double first_pixel_sum; // over the images opened, for the mean
+    long count;             // images opened
+    bool from_thumbnail;    // the first pixel of the last image came from its thumbnail
+} display_times_t;
+
 class AnnotationApp
 {
 public:
     AnnotationApp();           // default init
-    void ui_initialize(void);  // init ui
+    void ui_initialize(bool baked_fonts); // init ui, with the font atlas baked at build time or by rasterising the fonts
     void ui_main_window(void); // main window
+    bool animating(void);      // is some background work shown on screen (the ui is then drawn a few times per second)
+    void restore_session(void); // open the folder of the last session, its image and view once listed
+    void save_session(void);    // folder, image, view, label and scroll of the list, for the next launch
+    void release_gl(void);      // textures and buffers of the app, deleted before the GL context
 
 private:
     bool open_images_folder_flag;             // flag to open file dialog
     bool load_json_flag;                      // flag to open and read a json
     bool save_json_flag;                      // flag to open and read a json
+    bool import_coco_flag;                    // flag to open and import a COCO file
+    bool export_coco_flag;                    // flag to open and export a COCO file
+    bool export_voc_flag;                     // flag to choose a folder and export VOC files
+    bool export_tfrecord_flag;                // flag to choose a folder and export TFRecord files
     bool startup_flag;                        // popup on startup
     bool annotations_file_exists;             // is there an annotation file in the folder
     std::string images_folder;                // path to valid folder containing images
@@ -30,9 +68,38 @@ private:
     std::vector<int> annotation_count;        // number of annotation on the current image
     std::set<std::string> ext_set;            // list of extensions accepted as images
     GLuint current_image_texture;             // opengl texture for the loaded image
+    GLuint image_texture;                     // texture of the current image when decoded by stb (arrays and frames own theirs)
     int current_image_width;                  // width of the picture
     int current_image_height;                 // height of the picture
     float scale;                              // scaling factor on the displayed image
+    float zoom;                               // magnification of the view over the image fitted to the panel
+    vec2f pan;                                // offset of the image in the panel (pixels on screen)
+    vec2f view_origin;                        // top left corner of the image on screen
+    bool panning_flag;                        // the image follows the mouse
+    Minimap minimap;                          // overview of the image while part of it is out of view
+    bool minimap_flag;                        // show the overview
+    bool minimap_dirty;                       // the instances of the image changed since the density of the overview
+    MipmapBuilder mipmaps;                    // levels of the current texture, built after its upload
+    DecodeAhead decode_ahead;                 // images of the last session decoded while the folder is scanned, and the image opened
+    ThumbnailCache thumbnails;                // small versions of the images shown, displayed while they are decoded again
+    std::string loading_fname;                // image decoded in the background (full path), shown from its thumbnail meanwhile
+    bool placeholder_flag;                    // the image is decoded and has no thumbnail : nothing of it is shown yet
+    std::string image_error;                  // image whose decode failed, shown in the panel until another one is opened
+    ThumbnailAtlas thumbnail_atlas;           // thumbnails of every image of the folder, cached on disk
+    ThumbnailGrid grid;                       // layers of the visible thumbnails and their instanced drawing
+    bool grid_flag;                           // show the thumbnails of the list instead of the current image
+    bool grid_pending;                        // thumbnails of the grid left for the next frames (uploads per frame are limited)
+    bool grid_boxes_dirty;                    // grid_boxes must be gathered again
+    std::unordered_map<std::string, std::vector<image_box_t>> grid_boxes; // boxes and points of each image (pixels), drawn on the thumbnails
+    double open_time;                         // when the current image was opened (ms since startup)
+    bool first_pixel_flag;                    // the first frame showing the current image is still to come
+    display_times_t display_times;            // time to first pixel and to the full resolution
+    session_t pending_session;                // session restored, applied as the folder is listed
+    bool pending_session_flag;                // part of the session is still to apply
+    float list_scroll;                        // scroll of the list of images, saved with the session
+    OverlayRenderer overlay;                  // instances of the current image drawn in one instanced call
+    bool batched_overlay_flag;                // draw the instances with the overlay renderer (draw list otherwise)
+    overlay_stats_t overlay_stats;            // traffic of the instances drawn by the last frame
     std::vector<Annotation> annotations;      // list of annotations available
     std::fstream fs;                          // file pointer to the annotation file
     std::string temp_annotation_fname;        // full path
@@ -41,19 +108,84 @@ private:
     bool compute_scale_flag;                  // compute scale factor to resize image
     std::map<std::string, int> ninstperimage; // dict to count the number of instances per image
     vec2f img_view;                           // view size to display image (and check if resize)
+    bool sharded_flag;                        // save one annotation file per image instead of the temp file
+    AnnotationShards shards;                  // sharded layout of the annotations
+    std::set<std::string> dirty_images;       // images whose annotations changed since the last save
+    bool dirty_labels;                        // labels configuration changed since the last save
+    float annotations_scale;                  // scale used on the annotations currently in memory
+    bool yolo_flag;                           // keep a YOLO label directory in sync with the annotations
+    YoloSync yolo;                            // background writer of the YOLO label files
+    std::set<std::string> yolo_dirty_images;  // images whose annotations changed since the last YOLO sync
+    ThreadPool pool;                          // worker threads of the background jobs
+    VocExporter voc;                          // Pascal VOC export running on the pool
+    TFRecordExporter tfrecord;                // TFRecord export pipeline
+    FolderScanner scanner;                    // recursive listing of the images folder
+    bool scanning_flag;                       // the list of images is still growing
+    double last_merge_time;                   // time of the last merge of scanned files into the list
+    FolderWatcher watcher;                    // live changes of the images folder once scanned
+    ImageIndex image_index;                   // ids and filtering indexes of the images
+    std::vector<uint32_t> image_ids;          // id of each entry of image_files
+    image_filter_t filter;                    // current filter of the list
+    char filter_text[128];                    // text typed in the filter bar
+    std::vector<uint32_t> view_rows;          // positions in image_files of the images shown, in the order of the list
+    bool view_dirty;                          // view_rows must be computed again
+    ImageOrders orders;                       // cached orders of the list
+    image_order_t sort_order;                 // order of the list
+    double last_order_time;                   // time of the last computation of an order
+    std::vector<std::pair<std::string, std::string>> unsupported_files; // files of the folder which cannot be decoded, and their format
+    bool array_flag;                          // the current image is an array (.npy or raw file)
+    ArraySource array_source;                 // mapping of the current array
+    ArrayView array_view;                     // textures and display range of the current array (or planes of the current frame)
+    bool video_flag;                          // the current image is a frame of a video
+    VideoSource video_source;                 // mapping of the video of the current frame
+    DuplicateFinder duplicates;               // hashes of the folder and clusters of duplicates
+    bool filter_rebuild_flag;                 // instance counts of the index must be computed again
 
     bool read_image(const char *filename, GLuint *out_texture, int *out_width, int *out_height);
+    void show_decoded(unsigned char *pixels, int width, int height); // upload the pixels of the current image (freed once its levels are built)
+    void poll_image(void);                         // swap the full resolution in once decoded
+    void image_failed(const std::string &fname);   // the image cannot be read : nothing of it is shown, the panel tells why
+    bool read_array(const char *filename, GLuint *out_texture, int *out_width, int *out_height); // map an array and upload the channels shown
+    bool read_frame(const std::string &video, long frame, GLuint *out_texture, int *out_width, int *out_height); // upload the planes of a frame, prefetch the next ones
+    void open_image(const std::string &fname);     // show an image of the list (relative to the folder)
+    void apply_session(void);                      // image, view, label and scroll of the session restored, as soon as possible
     void check_annotations_file(void);             // look for the presence of an annotations file
     void activate_annotation(long unsigned int n); // activate annotation n and deactivate all others
     void parse_images_folder(std::string path);    // list image files
+    void merge_scanned_files(void);                // insert the files found by the scanner in the sorted list
+    void apply_watch_events(void);                 // apply the changes seen by the watcher to the list
+    void report_unsupported_files(void);           // list the files of the scan which cannot be decoded
+    void insert_image_file(const std::string &fname); // binary search insert in the sorted list
+    void remove_image_file(const std::string &fname); // binary search removal from the sorted list
+    bool filter_active(void);                      // is the list filtered
+    void ui_filter_bar(void);                      // search and annotation filters of the list
+    bool view_active(void);                        // is the list filtered or sorted
+    void update_order(void);                       // install the orders computed, start the one selected if outdated
+    void update_view_rows(void);                   // images of the list matching the filter, in the order selected
+    void refresh_index(void);                      // count the instances of the index again if needed
+    void index_instance(int label, const std::string &fname, bool added); // keep the filter indexes up to date after an edit
     void ui_images_folder(void);                   // draw the UI to displays files
     void ui_image_current(void);                   // display current image
+    void update_view(void);                        // zoom and pan of the image from the mouse
+    void reset_view(void);                         // image fitted to the panel
+    bool ui_minimap(ImDrawList *draw_list, vec2f image_size); // overview of the image, true while the mouse is used by it
+    void ui_thumbnail_grid(void);                  // thumbnails of the list with their instances, a click opens the image
     void ui_annotations_panel(void);               // create/edit annotations type
+    void ui_array_panel(void);                     // channels and display range of an array
     void json_read(std::string name);              // read/write info to the annotation file
     void json_write(std::string name);             // read/write info to the annotation file
     void update_annotation_fsm(void);              // update the logic to handle annotation instances
     void clear_annotations(void);                  // clear all annotations
     void import_annotations_from_prev(void);       // import annotations from the previous image in the list
+    void save_annotations(void);                   // dump the changes to the temp file or to the shards
+    void mark_image_dirty(std::string fname);      // annotations of an image need to be saved
+    void mark_label_dirty(long unsigned int n);    // label n changed : every image using it needs to be saved
+    void set_sharded(bool enable);                 // switch between the temp file and the sharded layout
+    void count_instances(void);                    // recompute the number of instances per image
+    void import_coco(std::string fname);           // replace the annotations by the content of a COCO file
+    void set_yolo(bool enable);                    // start or stop the YOLO label directory sync
+    void sync_yolo(bool full);                     // send the dirty images (or all of them) to the YOLO sync
+    std::vector<image_boxes_t> snapshot_boxes(const std::set<std::string> *fnames); // boxes of some images (all if null), in pixels
 };
 
 #endif
\ No newline at end of file
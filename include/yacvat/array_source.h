@@ -0,0 +1,72 @@
+#ifndef ARRAY_SOURCE_H
+#define ARRAY_SOURCE_H
+
+#include <string>
+#include <cstddef>
+#include "mapped_file.h"
+
+/*
+
+Images stored as arrays rather than encoded pictures : NumPy .npy files and raw files. A raw file is
+described by a json file next to it (x.raw -> x.raw.json) :
+
+    {"width": 640, "height": 480, "channels": 4, "dtype": "uint16", "layout": "planar", "offset": 0}
+
+where dtype is a type name (uint8, int16, float32, ...) or a NumPy descr ("<u2", ">f4"), layout is
+"planar" (channel after channel, the default) or "interleaved", and offset the size of a header to skip.
+The shape of a .npy is (height, width), (height, width, channels) or (channels, height, width) : the
+channels of a 3d array are its smallest dimension, first (planar, as (3, 480, 640)) or last. When the
+smallest is not unique ((480, 3, 3), (4, 4, 4)) the array is read as (height, width, channels) unless a
+json next to it (x.npy.json) gives the "layout", which always decides when present.
+
+The file is mapped and never decoded : the planes are given as they are to the texture upload, and the
+range of the values is estimated from a sample of the mapping.
+*/
+
+typedef enum
+{
+    ARRAY_UINT8,
+    ARRAY_INT8,
+    ARRAY_UINT16,
+    ARRAY_INT16,
+    ARRAY_UINT32,
+    ARRAY_INT32,
+    ARRAY_FLOAT32,
+    ARRAY_FLOAT64,
+} array_dtype_t;
+
+typedef struct
+{
+    array_dtype_t dtype;
+    bool swap;       // stored in the other byte order
+    int width;
+    int height;
+    int channels;
+    bool planar;     // (channels, height, width), (height, width, channels) otherwise
+    size_t offset;   // bytes before the values
+} array_layout_t;
+
+class ArraySource
+{
+public:
+    ArraySource(); // default init
+
+    static bool handles(const std::string &fname);                         // is the file a .npy or a .raw
+    static bool probe(const std::string &fname, array_layout_t *layout);   // read the header, false if the file is shorter than the array it describes
+    static size_t element_size(array_dtype_t dtype);                       // bytes per value
+
+    bool open(const std::string &fname);          // map a file and check its size against its header
+    void close(void);                             // unmap the file
+    bool is_open(void) { return this->file.data() != nullptr; }
+    const array_layout_t &layout(void) { return this->shape; }
+    const unsigned char *plane(int channel);      // first value of a channel (planar) or first value of the data (interleaved)
+    size_t pixel_stride(void);                    // bytes between two values of a channel
+    double value(const unsigned char *p);         // one value of the array
+    void sample_range(int channel, float low, float high, float *vmin, float *vmax); // percentiles (in [0, 1]) of a channel from a sample
+
+private:
+    MappedFile file;     // mapping of the whole file
+    array_layout_t shape; // layout read from the header
+};
+
+#endif
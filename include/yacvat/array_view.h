@@ -0,0 +1,71 @@
+#ifndef ARRAY_VIEW_H
+#define ARRAY_VIEW_H
+
+#include <SDL_opengl.h>
+#include "imgui.h"
+#include "array_source.h"
+#include "video_source.h"
+
+/*
+
+Display of an ArraySource. The channels shown (one in gray, or three in rgb) are uploaded to textures
+straight from the mapping : a plane of a planar file is one texture, an interleaved file of up to 4
+channels is a single texture whose components are picked by the shader. The values keep their type
+(8 and 16 bits integers are stored as they are, the other types as floats converted by the driver),
+only float64 values and interleaved files of more than 4 channels go through a copy.
+
+The normalisation to the display range runs in a fragment shader : the image is drawn by ImGui with
+a draw list callback that replaces the ImGui program by this one for the image only, so changing the
+range or the gamma does not upload anything again.
+
+The same program shows the frames of a video : the y, u and v planes are three textures (the chroma
+ones at their own resolution, the sampling scales them up) and the conversion to rgb is done in the
+shader, with the BT.601 matrix for standard definition and BT.709 from 720 lines, in limited range.
+*/
+
+typedef enum
+{
+    YUV_NONE,  // an array, shown with the display settings
+    YUV_GRAY,  // a video without chroma
+    YUV_BT601,
+    YUV_BT709,
+} yuv_matrix_t;
+
+typedef struct
+{
+    bool rgb;          // three channels in rgb, the first one in gray otherwise
+    int channels[3];   // channel shown in red, green and blue (the first one in gray)
+    float low[3];      // values shown as black
+    float high[3];     // values shown at full intensity
+    float gamma;       // applied after the normalisation
+    bool auto_range;   // range estimated again on every image
+} array_display_t;
+
+class ArrayView
+{
+public:
+    ArrayView();  // default init
+    ~ArrayView(); // release the textures
+
+    bool upload(ArraySource &source);         // textures of the channels shown, from the mapping of the source
+    bool upload_yuv(const video_frame_t &frame); // textures of the planes of a video frame
+    void release(void);                       // delete the textures
+    void auto_range(ArraySource &source);     // range of the channels shown from the 1st and 99th percentiles
+    GLuint texture(void) { return this->textures[0]; } // texture to give to ImGui::Image
+    const GLuint *planes(void) { return this->textures; } // textures of the three outputs (0 if unused, may repeat)
+    void begin(ImDrawList *draw_list);        // the next image of the draw list is normalised by the shader
+    void end(ImDrawList *draw_list);          // back to the ImGui program
+
+    array_display_t display; // channels and range shown
+
+private:
+    GLuint textures[3];    // texture sampled for each output
+    int components[3];     // component of the texture read for each output
+    float value_scale;     // texture value of 1 in the type of the array (normalised integer formats)
+    yuv_matrix_t yuv;      // conversion of a video frame
+    float yuv_scale;       // texture value of 1 in 8 bits samples
+
+    static void render(const ImDrawList *draw_list, const ImDrawCmd *cmd); // draw list callback
+};
+
+#endif
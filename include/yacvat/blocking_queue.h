@@ -0,0 +1,60 @@
+#ifndef BLOCKING_QUEUE_H
+#define BLOCKING_QUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// bounded fifo between two threads : push blocks while the queue is full, pop while it is empty
+template <typename T>
+class BlockingQueue
+{
+public:
+    BlockingQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+    // false if the queue was closed, the item is dropped
+    bool push(T &&item)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->not_full.wait(lock, [this]
+                            { return this->closed || (this->items.size() < this->capacity); });
+        if (this->closed)
+            return false;
+        this->items.push_back(std::move(item));
+        this->not_empty.notify_one();
+        return true;
+    }
+
+    // false once the queue is closed and drained
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->not_empty.wait(lock, [this]
+                             { return this->closed || !this->items.empty(); });
+        if (this->items.empty())
+            return false;
+        item = std::move(this->items.front());
+        this->items.pop_front();
+        this->not_full.notify_one();
+        return true;
+    }
+
+    // no more items : wakes up every thread waiting on the queue
+    void close(void)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->closed = true;
+        this->not_full.notify_all();
+        this->not_empty.notify_all();
+    }
+
+private:
+    std::deque<T> items;                // queued items
+    size_t capacity;                    // maximum number of items queued
+    bool closed;                        // producer is done (or consumer gave up)
+    std::mutex mutex;                   // protects items and closed
+    std::condition_variable not_full;   // room for a push
+    std::condition_variable not_empty;  // item available or queue closed
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef BOXES_H
+#define BOXES_H
+
+#include <string>
+#include <vector>
+
+// snapshot of the boxes of an image, handed over to the exporters running in the background
+
+typedef struct
+{
+    int label;                            // index of the label (class id)
+    float x_start, y_start, x_end, y_end; // coordinates on the image (pixels)
+} image_box_t;
+
+typedef struct
+{
+    std::string fname;              // image file name, relative to the images folder
+    std::vector<image_box_t> boxes; // boxes drawn on the image
+} image_boxes_t;
+
+#endif
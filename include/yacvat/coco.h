@@ -0,0 +1,25 @@
+#ifndef COCO_H
+#define COCO_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "annotations.h"
+
+/*
+
+Export / import of the annotations with the COCO detection format (https://cocodataset.org/#format-data)
+- AREA labels are categories of boxes : "bbox" = [x, y, width, height] in pixels
+- POINT labels are categories with a single keypoint : "keypoints" = [x, y, 2] and a bbox of size 0
+
+Both ways are streamed so that a document is never built in memory : the exporter writes the json text
+while iterating on the annotations and the importer uses a SAX parser, keeping only the id -> name maps
+of the images and the categories. Sizes of the images are read from the file headers. The import fills
+new containers and swaps them in at the end : a truncated or malformed file leaves the annotations as
+they were.
+*/
+
+bool coco_export(const std::string &fname, const std::string &images_folder, const std::vector<std::string> &image_files, std::vector<Annotation> &annotations, float scale);
+bool coco_import(const std::string &fname, std::vector<Annotation> &annotations, std::map<std::string, int> &ninstperimage, float scale);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <stdint.h>
+
+// CRC-32C (Castagnoli) : sse4.2 instruction when the cpu has it, slicing-by-8 tables otherwise
+uint32_t crc32c_extend(uint32_t crc, const void *data, size_t length); // crc of the previous data followed by these bytes
+uint32_t crc32c(const void *data, size_t length);                      // crc of a buffer
+uint32_t crc32c_mask(uint32_t crc);                                    // masked crc stored in the TFRecord files
+
+#endif
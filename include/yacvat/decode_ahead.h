@@ -0,0 +1,55 @@
+#ifndef DECODE_AHEAD_H
+#define DECODE_AHEAD_H
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "thread_pool.h"
+
+/*
+
+Images decoded ahead of their display, by tasks of the pool : at launch the image of the last session
+and its nearest neighbours are decoded while the window opens and the folder is scanned, so they are
+shown without waiting for stb_image once selected. The image opened is decoded the same way, while
+the ui shows its thumbnail. Taking an image hands its pixels over (the caller frees them with
+stbi_image_free) ; an image still being decoded is either waited for, or taken on a later frame.
+
+A few images at most are held (decoded or in progress). clear() forgets them (another folder) : the decodes in progress finish
+in the background and their pixels are freed.
+*/
+
+class DecodeAhead
+{
+public:
+    DecodeAhead();  // default init
+    ~DecodeAhead(); // forget the images
+
+    bool request(ThreadPool &pool, const std::string &fname); // decode an image in the background, false if too many are held (true if already requested)
+    // rgba pixels of an image requested (null if it cannot be decoded), false if it was not requested or without wait is not decoded yet
+    bool take(const std::string &fname, unsigned char **pixels, int *width, int *height, bool wait = true);
+    void forget(const std::string &fname);                    // abandon an image requested (its decode in progress is freed)
+    void clear(void);                                         // forget every image requested
+
+private:
+    typedef struct
+    {
+        bool done;             // decode finished
+        unsigned char *pixels; // rgba, null if the file cannot be decoded
+        int width;
+        int height;
+    } entry_t;
+
+    typedef struct state_s
+    {
+        std::mutex mutex;
+        std::condition_variable decoded;       // an entry is done
+        std::map<std::string, entry_t> images; // by full file name
+        ~state_s();                            // free the pixels never taken
+    } state_t;
+
+    std::shared_ptr<state_t> state; // shared with the tasks in progress, replaced by clear()
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef DUPLICATES_H
+#define DUPLICATES_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+#include "thread_pool.h"
+#include "manifest.h"
+#include "image_hash.h"
+
+/*
+
+Background search of the duplicates of a dataset, started at the end of a scan. The images (and the
+frames of the videos) without hashes in the listing of the scan are hashed by chunks spread over
+every thread of the pool. The hashes are written to the manifest every few seconds and at the end,
+so a search which was stopped (folder closed, application quit) resumes from its last write : the scan
+keeps the hashes of the files which did not change. Once cancelled a search writes nothing more, the
+manifest belongs to the scan which replaced it.
+
+Once every image is hashed, the images are grouped in clusters :
+- identical : same content hash
+- similar : the sum of the distances of their average and difference hashes is small. Two hashes
+  under the threshold share at least 2 of the 8 bands of 16 bits : only the pairs of a bucket of a
+  band are compared (the buckets of more than a few dozen images are split by a second band), which
+  finds every pair under the threshold without comparing all of them. The images with the same
+  perceptual hashes (the frames of a static scene) are grouped before and compared only once.
+*/
+
+typedef struct
+{
+    uint32_t size; // images of the cluster
+    bool exact;    // every image of the cluster has the same content
+} duplicate_cluster_t;
+
+class DuplicateFinder
+{
+public:
+    DuplicateFinder();  // default init
+    ~DuplicateFinder(); // cancel the search in progress
+
+    // cancel the previous search and start a new one from the listing of a scan
+    void start(ThreadPool &pool, std::string folder, std::shared_ptr<const DatasetManifest> listing, std::string manifest_fname, uint64_t extensions_hash);
+    void cancel(void);                          // stop the search, the hashes computed since the last write are dropped
+    bool running(void);                         // is the search in progress
+    void progress(long *done, long *total);     // images hashed by this search and images to hash
+    bool poll(void);                            // install the clusters of a search which ended, true if installed
+    int cluster(const std::string &entry, duplicate_cluster_t *info); // cluster of an entry of the list (from 1), 0 if it has no duplicate
+    size_t clusters(void) { return this->infos.size(); }
+
+private:
+    typedef struct
+    {
+        uint32_t dir;   // position in the dirs of the manifest
+        uint32_t file;  // position in the files of the folder
+        uint32_t first; // first frame of a video
+        uint32_t count; // frames of a video, 1 for an image
+    } item_t;
+
+    typedef struct
+    {
+        std::vector<item_t> items;
+        std::vector<image_hash_t> hashes; // hashes of the items, frame after frame
+    } chunk_t;
+
+    typedef struct
+    {
+        std::string folder;
+        std::string manifest_fname;
+        uint64_t extensions_hash;
+        DatasetManifest manifest;             // copy of the listing, receives the hashes (only by the task which saves)
+        std::mutex mutex;                     // protects finished
+        std::vector<chunk_t> finished;        // chunks hashed and not in the manifest yet
+        std::atomic<bool> saving;             // a task is writing the manifest
+        std::atomic<int64_t> last_save;       // time of the last save (ms)
+        std::atomic<long> pending;            // chunks queued or being hashed
+        std::atomic<long> done;               // images hashed
+        std::atomic<long> total;              // images to hash
+        std::atomic<bool> cancel_flag;        // abandon the search
+        std::atomic<bool> done_flag;          // clusters ready
+        std::unordered_map<std::string, uint32_t> entries; // cluster of the entries which have duplicates
+        std::vector<duplicate_cluster_t> infos;            // clusters, the first one is numbered 1
+    } job_t;
+
+    std::shared_ptr<job_t> job;                         // shared with the tasks which keep it alive
+    std::unordered_map<std::string, uint32_t> entries;  // clusters installed
+    std::vector<duplicate_cluster_t> infos;
+
+    static void plan(std::shared_ptr<job_t> job, ThreadPool *pool, std::shared_ptr<const DatasetManifest> listing); // task : list the images without hashes
+    static void hash_chunk(std::shared_ptr<job_t> job, std::shared_ptr<chunk_t> chunk); // task : hash the items of a chunk
+    static void finish_chunk(std::shared_ptr<job_t> &job);                             // save from time to time, clusters after the last chunk
+    static void save(std::shared_ptr<job_t> &job);                                     // move the finished chunks to the manifest and write it
+    static void find_clusters(std::shared_ptr<job_t> &job);                            // group the identical and similar images
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef FILES_H
+#define FILES_H
+
+#include <string>
+
+// small helpers around the posix file api (until boost is used to handle paths)
+bool file_exists(const std::string &fname);                                  // does the file exist
+bool make_directories(const std::string &path);                              // create a directory and all its parents
+std::string parent_directory(const std::string &fname);                      // path without the last element
+std::string file_extension(const std::string &fname);                        // lower case extension without the dot, "" if none
+bool write_file_atomic(const std::string &fname, const std::string &content); // write to a temp file and rename it
+void prefetch_file(const std::string &fname);                                // ask the kernel to read a whole file ahead of its use
+
+#endif
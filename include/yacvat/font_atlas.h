@@ -0,0 +1,28 @@
+#ifndef FONT_ATLAS_H
+#define FONT_ATLAS_H
+
+#include <vector>
+#include <stddef.h>
+#include "imgui.h"
+
+/*
+
+Font atlas of the ui baked at build time. Decompressing the embedded fonts (Noto Sans and the Font
+Awesome icons) and rasterising them with stb_truetype takes a good part of the startup : the
+bake_fonts tool does it once during the build, with the same ImGui sources, and writes the atlas
+(alpha texture, glyphs and metrics of the fonts) as a blob linked into yacvatlib. At startup the
+atlas is restored from the blob : a copy of the pixels and of the glyph tables, then the usual
+texture upload by the backend.
+
+The blob records the ImGui version and the size of its glyphs : a blob which does not match is
+refused and the fonts are rasterised at startup as before.
+*/
+
+void font_atlas_add_fonts(ImFontAtlas *atlas);                                   // fonts of the ui, rasterised by the next build of the atlas
+bool font_atlas_bake(ImFontAtlas *atlas, std::vector<unsigned char> &blob);      // build the atlas of the fonts added and serialise it
+bool font_atlas_restore(ImFontAtlas *atlas, const unsigned char *blob, size_t size); // fonts and texture of an empty atlas from a blob
+
+extern const unsigned char font_atlas_blob[]; // generated by bake_fonts
+extern const size_t font_atlas_blob_size;
+
+#endif
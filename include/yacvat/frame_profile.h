@@ -0,0 +1,63 @@
+#ifndef FRAME_PROFILE_H
+#define FRAME_PROFILE_H
+
+#include <chrono>
+
+/*
+
+Where the time of a frame goes. Scoped timers around the phases of a frame (events, panels, current
+image, fsm of the instances, json, decode and upload of the images, render and swap) add their time to
+the frame in progress; the last frames are kept in a ring and shown in an overlay : frame times as a
+rolling histogram, p50 and p99 of the frame and of each phase.
+
+Off by default and toggled by a hotkey of the main loop. When off a timer only reads a flag : the
+clock is read only while the profile is shown. The phases can nest (the fsm runs inside the current
+image) and a phase can run several times per frame (uploads) : its time is the sum. The frame is timed
+from the end of the wait for events to the end of the swap, the idle wait is not counted.
+*/
+
+typedef enum
+{
+    PHASE_EVENTS,            // polling and dispatch of the SDL events
+    PHASE_IMAGES_FOLDER,     // list of the images
+    PHASE_ANNOTATIONS_PANEL, // labels and their instances
+    PHASE_IMAGE_CURRENT,     // current image (or the thumbnail grid) and its instances
+    PHASE_ANNOTATION_FSM,    // creation and edition of the instances
+    PHASE_JSON,              // annotation files read and written
+    PHASE_DECODE,            // images decoded (or their header read) on the ui thread
+    PHASE_UPLOAD,            // textures uploaded
+    PHASE_RENDER,            // draw data built and sent to GL
+    PHASE_SWAP,              // swap of the buffers (waits for vsync)
+    PHASE_COUNT
+} frame_phase_t;
+
+extern bool frame_profile_flag; // are the frames profiled (read by every timer)
+
+void frame_profile_enable(bool enable);                 // start or stop the profile, the history is cleared
+void frame_profile_begin(void);                         // start of a frame
+void frame_profile_add(frame_phase_t phase, double ms); // time spent in a phase by the frame in progress
+void frame_profile_end(void);                           // end of a frame : its times join the history
+void frame_profile_window(void);                        // overlay of the history (between NewFrame and Render)
+
+class FrameTimer
+{
+public:
+    // time of the scope added to a phase, nothing is read but the flag while the profile is off
+    FrameTimer(frame_phase_t phase) : phase(phase), active(frame_profile_flag)
+    {
+        if (this->active)
+            this->start = std::chrono::steady_clock::now();
+    }
+    ~FrameTimer()
+    {
+        if (this->active)
+            frame_profile_add(this->phase, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->start).count());
+    }
+
+private:
+    frame_phase_t phase;
+    bool active; // the profile was on when the scope started
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
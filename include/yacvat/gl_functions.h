@@ -0,0 +1,74 @@
+#ifndef GL_FUNCTIONS_H
+#define GL_FUNCTIONS_H
+
+#include <SDL_opengl.h>
+#include "imgui.h"
+
+/*
+
+Entry points past OpenGL 1.1 used by the app (shaders of the array view, of the overlay of the
+instances and of the thumbnail grid, mipmaps built by the driver), loaded once from the context by
+SDL_GL_GetProcAddress. They are grouped by what they provide : a renderer checks the groups it needs,
+so a context without instancing still shows the arrays through their shader.
+
+The shaders run from draw list callbacks, between the commands of ImGui : gl_callback_setup gives
+them the projection the backend uses for the draw data and the scissor of their command.
+*/
+
+typedef struct
+{
+    bool shaders;   // programs and uniforms (OpenGL 2.0)
+    bool textures;  // texture units, array textures and mipmaps (OpenGL 3.0)
+    bool instanced; // vertex arrays, buffers and instanced attributes (OpenGL 3.3)
+
+    PFNGLCREATESHADERPROC CreateShader;
+    PFNGLSHADERSOURCEPROC ShaderSource;
+    PFNGLCOMPILESHADERPROC CompileShader;
+    PFNGLGETSHADERIVPROC GetShaderiv;
+    PFNGLGETSHADERINFOLOGPROC GetShaderInfoLog;
+    PFNGLDELETESHADERPROC DeleteShader;
+    PFNGLCREATEPROGRAMPROC CreateProgram;
+    PFNGLDELETEPROGRAMPROC DeleteProgram;
+    PFNGLATTACHSHADERPROC AttachShader;
+    PFNGLBINDATTRIBLOCATIONPROC BindAttribLocation;
+    PFNGLLINKPROGRAMPROC LinkProgram;
+    PFNGLGETPROGRAMIVPROC GetProgramiv;
+    PFNGLGETPROGRAMINFOLOGPROC GetProgramInfoLog;
+    PFNGLUSEPROGRAMPROC UseProgram;
+    PFNGLGETATTRIBLOCATIONPROC GetAttribLocation;
+    PFNGLGETUNIFORMLOCATIONPROC GetUniformLocation;
+    PFNGLUNIFORM1IPROC Uniform1i;
+    PFNGLUNIFORM1FPROC Uniform1f;
+    PFNGLUNIFORM3IPROC Uniform3i;
+    PFNGLUNIFORM3FPROC Uniform3f;
+    PFNGLUNIFORM4FPROC Uniform4f;
+    PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+
+    PFNGLACTIVETEXTUREPROC ActiveTexture;
+    PFNGLTEXIMAGE3DPROC TexImage3D;
+    PFNGLTEXSUBIMAGE3DPROC TexSubImage3D;
+    PFNGLGENERATEMIPMAPPROC GenerateMipmap;
+
+    PFNGLGENVERTEXARRAYSPROC GenVertexArrays;
+    PFNGLDELETEVERTEXARRAYSPROC DeleteVertexArrays;
+    PFNGLBINDVERTEXARRAYPROC BindVertexArray;
+    PFNGLGENBUFFERSPROC GenBuffers;
+    PFNGLDELETEBUFFERSPROC DeleteBuffers;
+    PFNGLBINDBUFFERPROC BindBuffer;
+    PFNGLBUFFERDATAPROC BufferData;
+    PFNGLBUFFERSUBDATAPROC BufferSubData;
+    PFNGLENABLEVERTEXATTRIBARRAYPROC EnableVertexAttribArray;
+    PFNGLVERTEXATTRIBPOINTERPROC VertexAttribPointer;
+    PFNGLVERTEXATTRIBDIVISORPROC VertexAttribDivisor;
+    PFNGLDRAWARRAYSINSTANCEDPROC DrawArraysInstanced;
+} gl_functions_t;
+
+extern gl_functions_t gl; // entry points of the current context
+
+void gl_load(void); // load the entry points on the first call (a context must be current), the groups tell what was found
+// program of a vertex and a fragment shader in the language of the context, the attributes bound to their locations before the link (negative ones are left to the linker) : 0 if it cannot be built
+GLuint gl_build_program(const char *name, const char *vertex_shader, const char *fragment_shader, const char *const *attributes, const GLint *locations, int count);
+// orthographic projection of the draw data (column major, as the backend builds it) and scissor of a callback command : false if the command is clipped out
+bool gl_callback_setup(const ImDrawCmd *cmd, float proj[16]);
+
+#endif
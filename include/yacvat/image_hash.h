@@ -0,0 +1,42 @@
+#ifndef IMAGE_HASH_H
+#define IMAGE_HASH_H
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+#include "video_source.h"
+
+/*
+
+Hashes of an image used to find the duplicates of a dataset :
+- a content hash (XXH64) of the bytes of the file, or of the planes of a video frame : equal for
+  copies of the same file
+- two perceptual hashes of the luminance reduced to a few cells : an average hash (8 x 8 cells
+  brighter than their mean) and a difference hash (8 x 8 cells brighter than their right neighbour,
+  from 9 x 8 cells). Near identical images (recompressed, consecutive frames of a still scene) have
+  hashes a few bits apart.
+
+The reduction sums the rows into a line of the image width, a loop without dependencies between
+the columns that the compiler vectorises, and splits the line into cells once per band of rows.
+*/
+
+typedef enum
+{
+    HASH_CONTENT = 1,    // content is set
+    HASH_PERCEPTUAL = 2, // ahash and dhash are set (the image could be decoded)
+} image_hash_flag_t;
+
+typedef struct
+{
+    uint64_t content; // XXH64 of the bytes
+    uint64_t ahash;   // average hash
+    uint64_t dhash;   // difference hash
+    uint8_t flags;    // image_hash_flag_t set, 0 when not computed yet
+} image_hash_t;
+
+uint64_t xxh64(const void *data, size_t length, uint64_t seed = 0);                    // XXH64 of a buffer
+bool hash_image_file(const std::string &fname, image_hash_t *hash);                    // content of a file, perceptual hashes of its decoded pixels
+void hash_video_frame(const video_frame_t &frame, image_hash_t *hash);                 // content of the planes, perceptual hashes of the y plane
+int hash_distance(uint64_t a, uint64_t b);                                             // number of bits which differ
+
+#endif
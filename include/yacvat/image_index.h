@@ -0,0 +1,74 @@
+#ifndef IMAGE_INDEX_H
+#define IMAGE_INDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include "annotations.h"
+
+/*
+
+Indexes used to filter the list of images without going through all the names or annotations :
+    - every image name gets a stable id (order of first appearance), the indexes are bitsets over ids
+    - one bitset per label of the images with at least one instance of the label, and one of the
+      images with any instance (its complement is the set of images without annotation)
+    - a trigram index of the lower case names : a search of 3 characters or more intersects the lists
+      of ids of its trigrams and only checks the names of the candidates left
+
+The counts behind the bitsets are updated on each instance added or removed. Bulk changes (loading a
+file, removing a label, ...) rebuild them from the annotations. The trigram index is only built with
+the first text search, and kept up to date with the new names from then on.
+*/
+
+typedef enum
+{
+    FILTER_ALL,
+    FILTER_UNANNOTATED,
+    FILTER_ANNOTATED,
+    FILTER_LABEL,
+} image_filter_mode_t;
+
+typedef struct
+{
+    image_filter_mode_t mode;
+    int label;        // FILTER_LABEL only
+    std::string text; // part of the name (case insensitive), empty for any
+} image_filter_t;
+
+class ImageIndex
+{
+public:
+    ImageIndex(); // default init
+
+    void clear(void);                                             // forget every image
+    uint32_t id(const std::string &fname);                        // id of an image, created on first use
+    size_t size(void) { return this->names.size(); }              // number of ids
+    const std::string &name(uint32_t id) { return this->names[id]; } // name of an id
+    uint32_t count(uint32_t id) { return (id < this->totals.size()) ? this->totals[id] : 0; } // number of instances of an image
+
+    void rebuild(std::vector<Annotation> &annotations);           // count the instances of every image again
+    void add_instance(int label, const std::string &fname);       // one more instance of a label on an image
+    void remove_instance(int label, const std::string &fname);    // one instance less
+
+    size_t match(const image_filter_t &filter, std::vector<uint64_t> &bits); // bitset of the ids matching a filter, returns their number
+    bool match(const image_filter_t &filter, uint32_t id);                   // does an image match a filter
+
+    static bool test(const std::vector<uint64_t> &bits, uint32_t id) { return (id >> 6) < bits.size() && ((bits[id >> 6] >> (id & 63)) & 1); }
+
+private:
+    std::vector<std::string> names;                             // id -> image name
+    std::unordered_map<std::string, uint32_t> ids;              // image name -> id
+    std::vector<uint32_t> totals;                               // id -> number of instances
+    std::vector<uint64_t> annotated;                            // images with at least one instance
+    std::vector<std::unordered_map<uint32_t, uint32_t>> counts; // label -> id -> number of instances (images with some only)
+    std::vector<std::vector<uint64_t>> labels;                  // label -> images with at least one instance of it
+    bool trigrams_ready;                                        // is the trigram index built
+    std::unordered_map<uint32_t, std::vector<uint32_t>> trigrams; // trigram -> sorted ids of the names containing it
+
+    void add_trigrams(uint32_t id);                             // index the name of an image
+    void search(const std::string &text, std::vector<uint32_t> &found); // sorted ids of the names containing a text
+    void update_bits(int label, uint32_t id);                   // bitsets of an image after a count change
+};
+
+#endif
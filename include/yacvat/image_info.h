@@ -0,0 +1,35 @@
+#ifndef IMAGE_INFO_H
+#define IMAGE_INFO_H
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+// formats recognised by their signature, TGA, raw arrays and raw videos (which have none) by their extension
+typedef enum
+{
+    IMAGE_FORMAT_UNKNOWN,
+    IMAGE_FORMAT_JPEG,
+    IMAGE_FORMAT_PNG,
+    IMAGE_FORMAT_BMP,
+    IMAGE_FORMAT_GIF,
+    IMAGE_FORMAT_TGA,
+    IMAGE_FORMAT_PNM,
+    IMAGE_FORMAT_PSD,
+    IMAGE_FORMAT_HDR,
+    IMAGE_FORMAT_TIFF, // recognised, not decoded
+    IMAGE_FORMAT_WEBP, // recognised, not decoded
+    IMAGE_FORMAT_NPY,  // arrays, read by ArraySource
+    IMAGE_FORMAT_RAW,
+    IMAGE_FORMAT_Y4M,  // videos, read by VideoSource
+    IMAGE_FORMAT_YUV,
+} image_format_t;
+
+bool probe_image_size(const std::string &fname, int *width, int *height, int *channels = nullptr); // dimensions read from the file header, without decoding the pixels
+bool probe_image_buffer(const unsigned char *data, size_t length, int *width, int *height, int *channels = nullptr); // same on an encoded image already in memory
+image_format_t detect_image_format(const unsigned char *head, size_t length, const std::string &fname); // format from the first bytes of a file, its name as a hint
+const char *image_format_name(image_format_t format);                                                // short name of a format
+bool probe_image_file(const std::string &fname, image_format_t *format, int *width, int *height);      // format and dimensions, false if the file cannot be decoded
+bool probe_capture_time(const std::string &fname, int64_t *time); // EXIF DateTimeOriginal of a JPEG as YYYYMMDDhhmmss, false if missing
+
+#endif
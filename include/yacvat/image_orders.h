@@ -0,0 +1,86 @@
+#ifndef IMAGE_ORDERS_H
+#define IMAGE_ORDERS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <stdint.h>
+#include "thread_pool.h"
+#include "manifest.h"
+#include "image_index.h"
+
+/*
+
+Orders of the list of images other than the lexical order of the paths : each one is a permutation of
+the ids of the images, computed once on the thread pool and cached, so that switching between them
+only changes the permutation used to draw the list.
+
+The sort keys are cached by id as well : sizes and times come from the listing of the scan (a stat
+for the files added since), capture times from the EXIF segment of the files. When the list changes
+the orders are computed again in the background, but only the keys of the new images are read and
+the previous permutation is used until then. The order by number of instances follows the edits :
+an image whose count changes is moved in the permutation with two binary searches.
+
+Ties are broken by name, images without a key (no EXIF date) come last.
+*/
+
+typedef enum
+{
+    ORDER_NAME,    // lexical order of the paths, the order of the list itself
+    ORDER_NATURAL, // numbers compared by value : frame_2 before frame_10
+    ORDER_MTIME,   // modification time
+    ORDER_SIZE,    // size of the file
+    ORDER_COUNT,   // number of instances
+    ORDER_CAPTURE, // EXIF capture time
+    ORDER_MODES,
+} image_order_t;
+
+class ImageOrders
+{
+public:
+    ImageOrders(); // default init
+
+    void set_folder(std::string folder);    // folder of the images, forgets the orders and keys of the previous one
+    void invalidate(void);                  // the list changed : every order must be computed again
+    void invalidate(image_order_t order);   // the keys of an order changed
+    bool stale(image_order_t order);        // must an order be computed (again)
+    bool busy(image_order_t order);         // is an order being computed
+    const std::vector<uint32_t> *get(image_order_t order); // ids in an order, null before its first computation
+    bool poll(void);                        // install the orders computed since the last call, true if any
+
+    // compute an order from a snapshot of the list (ids and names, in lexical order) and of the instance counts (by id, ORDER_COUNT only)
+    void compute(ThreadPool &pool, image_order_t order, std::vector<std::pair<uint32_t, std::string>> &images, std::vector<uint32_t> &counts, std::shared_ptr<const DatasetManifest> listing);
+    bool update_count(uint32_t id, uint32_t count, ImageIndex &index); // move an image in the count order, true if the order changed
+
+    static bool natural_less(const std::string &a, const std::string &b); // names compared with their numbers by value
+
+private:
+    typedef struct
+    {
+        image_order_t order;
+        std::string folder;
+        std::vector<std::pair<uint32_t, std::string>> images; // ids and names, in lexical order
+        std::vector<int64_t> keys;                            // id -> sort key
+        std::vector<size_t> missing;                          // positions in images of the keys to read
+        std::shared_ptr<const DatasetManifest> listing;       // sizes and times of the scan
+        std::vector<uint32_t> result;                         // ids in order
+        long generation;                                      // generation of the order when started
+        std::atomic<long> pending;                            // chunks of keys left to read
+        std::atomic<bool> done_flag;                          // result is ready
+    } job_t;
+
+    std::string folder;                          // folder of the images
+    std::vector<uint32_t> orders[ORDER_MODES];   // ids in each order
+    std::vector<int64_t> keys[ORDER_MODES];      // id -> sort key of each order
+    bool ready[ORDER_MODES];                     // has the order been computed once
+    bool stale_flags[ORDER_MODES];               // must the order be computed again
+    long generation[ORDER_MODES];                // bumped when the list or the keys change
+    std::vector<std::shared_ptr<job_t>> jobs;    // computations in progress
+
+    static void read_stats(std::shared_ptr<job_t> job);                          // task : sizes or times of the images
+    static void read_captures(std::shared_ptr<job_t> job, size_t start, size_t end); // task : capture times of some images
+    static void sort(std::shared_ptr<job_t> job);                                // last step of a computation
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <set>
+#include "image_hash.h"
+
+/*
+
+Binary manifest of an images folder (.yacvat-manifest), written after a scan so that reopening the
+folder does not list and sort it again. For every folder of the tree it records its modification
+time and its images, with their size, modification time, format and dimensions (read from the headers).
+Files with an image extension which cannot be decoded are kept with their format, so that they are
+reported without being probed again, but they are not part of the list of paths.
+Files are stored in the order of the sorted list of relative paths, so it is read back already sorted.
+A video is stored once with its number of frames, and gives one path per frame. The hashes computed
+by the search of duplicates are stored with the files and kept as long as the files do not change.
+
+The modification time of a folder changes when an entry is added, removed or renamed in it : the
+folders whose time did not change are reused as they are, only the others are read again.
+*/
+
+typedef struct
+{
+    std::string name; // file name inside its folder
+    uint64_t size;    // size in bytes
+    int64_t mtime;    // modification time (ns)
+    int32_t width;    // dimensions, 0 when unknown
+    int32_t height;
+    uint8_t format;   // image_format_t found from the signature of the file
+    bool supported;   // can the file be decoded
+    uint32_t frames;  // frames of a video (one entry each in the list), 0 for an image
+    std::vector<image_hash_t> hashes; // hashes of the image (of each frame), empty until the duplicates are searched
+} manifest_file_t;
+
+typedef struct
+{
+    std::string path;                    // relative to the root, "" for the root
+    int64_t mtime;                       // modification time (ns)
+    std::vector<manifest_file_t> files;  // images of the folder, sorted by name
+    std::vector<std::string> subdirs;    // relative paths of the sub folders
+} manifest_dir_t;
+
+class DatasetManifest
+{
+public:
+    DatasetManifest(); // default init
+
+    // read a manifest, false if missing, corrupted or written for other extensions ; paths receives the relative paths of the supported files (and of the frames of the videos)
+    bool read(const std::string &fname, uint64_t extensions_hash, std::vector<std::string> *paths);
+    bool write(const std::string &fname, uint64_t extensions_hash); // dump the folders
+    const manifest_dir_t *find(const std::string &path);           // folder by relative path, nullptr if unknown
+    void clear(void);
+
+    std::vector<manifest_dir_t> dirs; // every folder of the tree
+
+private:
+    std::unordered_map<std::string, size_t> index; // relative path -> position in dirs
+
+    void build_index(void); // index and sub folders of dirs
+};
+
+std::string manifest_join(const std::string &dir, const std::string &name); // relative path of an entry of a folder
+int64_t manifest_mtime(const struct stat &st);                             // modification time of a stat (ns)
+uint64_t manifest_extensions_hash(const std::set<std::string> &extensions); // manifests of other extensions are ignored
+
+// entries of the list for a file : its path, or the paths of its frames starting at the first one
+void manifest_entries(const std::string &path, const manifest_file_t &f, std::vector<std::string> &entries, uint32_t first = 0);
+
+#endif
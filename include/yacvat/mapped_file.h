@@ -0,0 +1,28 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+// read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile();  // default init
+    ~MappedFile(); // unmap the file
+
+    bool open(const std::string &fname);         // map the file, false if it cannot be read
+    void close(void);                            // unmap the file
+    void prefetch(size_t offset, size_t length); // ask the kernel to read a range ahead of its use
+    const unsigned char *data(void) { return this->ptr; }
+    size_t size(void) { return this->length; }
+
+private:
+    unsigned char *ptr; // start of the mapping
+    size_t length;      // size of the file
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <vector>
+#include <stdint.h>
+#include "imgui.h"
+
+/*
+
+Overview of the current image in a corner of the panel while part of it is out of view (zoomed in or
+panned). The image is drawn from its own texture at a small size : sampled through its mipmaps, the
+GPU reads one of the small levels already built, nothing is decoded or uploaded again. Over it the
+part of the image in view is outlined, and the instances of the image are shown as a density grid :
+the bins are counted again only when the instances of the image change, not every frame.
+
+Clicking or dragging in the overview moves the view to the point under the cursor.
+*/
+
+class Minimap
+{
+public:
+    Minimap(); // default init
+
+    // corner of the panel where an image of width x height is shown
+    static void layout(ImVec2 panel_min, ImVec2 panel_max, int width, int height, ImVec2 *min, ImVec2 *max);
+    void set_density(const std::vector<ImVec2> &points); // instances of the image (centers, in [0, 1] over the image)
+    // density and part in view (in [0, 1]) over the image drawn in [min, max] : true while the mouse is used by the overview, target is the point clicked if any
+    bool draw(ImDrawList *draw_list, ImVec2 min, ImVec2 max, ImVec2 view_min, ImVec2 view_max, bool *clicked, ImVec2 *target);
+
+private:
+    std::vector<uint16_t> bins; // instances per cell of the grid, row after row
+    int max_count;              // of a bin, for the opacity
+    bool dragging_flag;         // the left button was pressed over the overview and is still down
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef MIPMAPS_H
+#define MIPMAPS_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <SDL_opengl.h>
+#include "thread_pool.h"
+
+/*
+
+Mipmaps of the texture shown, built after its upload so the image is on screen at once : until its
+levels are ready the texture is sampled without them (GL_LINEAR), then it switches to trilinear
+sampling and no longer aliases when the view is zoomed out.
+
+- decoded images : a task of the pool reduces the pixels level after level (2x2 box filter from the
+  previous level), the ui thread uploads the levels once they are all computed
+- arrays and video frames (sampled by the array shader, in their own formats) : the driver builds
+  the levels with glGenerateMipmap, on the frame after the upload
+
+One of the levels computed can be kept for the thumbnails of the images already shown : the first one
+whose largest side fits the size asked.
+
+Starting again (another image) abandons the levels in progress : they never reach a texture which
+was deleted in the meantime.
+*/
+
+class MipmapBuilder
+{
+public:
+    MipmapBuilder();  // default init
+    ~MipmapBuilder(); // abandon the levels in progress
+
+    // levels of an rgba texture from its pixels (the builder frees them with stbi_image_free), the level fitting thumbnail_size is kept
+    void start(ThreadPool &pool, GLuint texture, unsigned char *pixels, int width, int height, int thumbnail_size = 0);
+    void start_gpu(const GLuint *textures, int count); // levels of textures built by the driver on the next frame
+    void cancel(void);                                 // forget the texture, before it is deleted
+    bool poll(void);                                   // ui thread : upload the levels ready, true when the texture switched
+    bool take_thumbnail(std::vector<unsigned char> &pixels, int *width, int *height); // level kept by the last poll which switched, if any
+
+private:
+    typedef struct
+    {
+        int width;
+        int height;
+        std::vector<unsigned char> pixels; // rgba
+    } level_t;
+
+    typedef struct
+    {
+        std::atomic<bool> cancel_flag; // abandon the reduction
+        std::atomic<bool> done_flag;   // levels ready
+        std::vector<level_t> levels;   // from level 1, written by the task only
+        int thumbnail_size;            // largest side of the level kept, 0 for none
+        level_t thumbnail;             // copy of that level
+    } job_t;
+
+    std::shared_ptr<job_t> job;       // shared with the task which keeps it alive
+    GLuint texture;                   // texture of the job
+    std::vector<GLuint> gpu_textures; // textures waiting for glGenerateMipmap
+    int gpu_wait;                     // frames left before glGenerateMipmap
+    level_t thumbnail;                // level kept from the last job uploaded
+
+    static void reduce(std::shared_ptr<job_t> job, unsigned char *pixels, int width, int height); // task : compute the levels
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <vector>
+#include <SDL_opengl.h>
+#include "imgui.h"
+
+/*
+
+Batched drawing of the boxes and points of the current image. Drawn one by one with AddRect and
+AddCircle, every instance adds its own triangles to the ImGui draw list (a few dozen vertices each, a
+few hundred for a circle), which makes megabytes of vertices per frame with thousands of instances.
+Here an instance is 48 bytes : the instances of the frame are uploaded as one buffer and drawn by a
+single instanced call, from a draw list callback (like the array shader). The vertex shader expands
+each instance to a quad around its shape, the fragment shader draws the outline (and the fill of the
+instance being edited) from the distance to the shape.
+
+Without the OpenGL 3.3 entry points (instanced attributes), available() is false and the caller
+draws the instances with the draw list as before.
+*/
+
+typedef enum
+{
+    OVERLAY_BOX,    // rectangle from (x0, y0) to (x1, y1)
+    OVERLAY_CIRCLE, // circle of center (x0, y0) and radius x1
+} overlay_shape_t;
+
+typedef struct
+{
+    float rect[4];  // shape on screen (pixels) : x0, y0, x1, y1
+    float color[4]; // rgba in [0, 1]
+    float style[4]; // outline thickness (pixels), alpha of the fill, shape, unused
+} overlay_instance_t;
+
+typedef struct
+{
+    long instances;   // instances drawn by the last frame
+    long bytes;       // bytes sent for them (instance buffer or draw list vertices and indices)
+    long vertices;    // vertices added to the draw list (0 when batched)
+} overlay_stats_t;
+
+class OverlayRenderer
+{
+public:
+    OverlayRenderer();  // default init
+    ~OverlayRenderer(); // release the buffers
+
+    bool available(void); // can the instances be batched (GL entry points loaded, program linked)
+    void clear(ImVec2 clip_min, ImVec2 clip_max); // forget the instances of the previous frame, the next ones out of the clip rectangle are skipped
+    void add_box(float x0, float y0, float x1, float y1, const uint8_t color[4], float thickness, float fill_alpha);
+    void add_circle(float x, float y, float radius, const uint8_t color[4], float thickness, float fill_alpha);
+    void draw(ImDrawList *draw_list); // queue the drawing of the instances added, between the other commands of the list
+    void release(void);               // delete the buffers, while the GL context is alive
+    size_t size(void) { return this->instances.size(); }
+
+private:
+    std::vector<overlay_instance_t> instances; // instances of the frame, uploaded when the list is rendered
+    ImVec2 clip_min;                           // visible part of the screen
+    ImVec2 clip_max;
+    GLuint vao;                                // vertex array of the instance attributes
+    GLuint vbo;                                // instance buffer
+    size_t capacity;                           // instances the buffer can hold
+
+    static void render(const ImDrawList *draw_list, const ImDrawCmd *cmd); // draw list callback
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+#include "thread_pool.h"
+#include "manifest.h"
+
+/*
+
+Recursive listing of the images of a folder, running on the thread pool : every subfolder is a task,
+so the branches of the tree are read in parallel (useful on network storage where each readdir waits
+on the server). Hidden files and folders are skipped and symbolic links to folders are not followed.
+File names are relative to the scanned folder ("camera/date/x.jpg").
+
+Files are selected by their extension, whatever its case, then recognised by their signature : only
+the files that stb can decode are listed, the others stay in the manifest with their format so that
+they are reported at once. A video (.y4m, .yuv) is listed as one entry per frame, its frame index is
+built by the task which reads its folder.
+
+Results are streamed : the tasks append the files they find to a batch that the ui thread takes at
+its own pace, so the first images can be used before the scan ends.
+
+With a manifest of the previous scan, its sorted list is published first, then each folder is checked
+with a single stat : only the folders modified since are read again, and the files added or removed
+in them are published as changes. The manifest is rewritten at the end of a scan if anything changed.
+*/
+
+class FolderScanner
+{
+public:
+    FolderScanner();  // default init
+    ~FolderScanner(); // cancel the scan in progress
+
+    // cancel the previous scan and start a new one, the manifest is optional
+    void start(ThreadPool &pool, std::string folder, const std::set<std::string> &extensions, std::string manifest_fname = "");
+    void cancel(void);                                                       // stop the scan in progress, the batch is dropped
+    bool running(void);                                                      // are some folders still to be read
+    size_t available(void);                                                  // number of changes not taken yet
+    void take(std::vector<std::string> &added, std::vector<std::string> &removed); // move the changes since the last call (unsorted)
+    long found(void);                                                        // number of files listed by the current (or last) scan
+    void folders(std::vector<std::pair<std::string, int64_t>> &folders);     // relative path and modification time of the folders listed
+    std::shared_ptr<const DatasetManifest> listing(void);                    // folders and files of the last complete scan, null before its end
+
+private:
+    typedef struct
+    {
+        ThreadPool *pool;
+        std::string folder;
+        std::string manifest_fname;
+        std::set<std::string> extensions;
+        uint64_t extensions_hash;             // manifests of other extensions are ignored
+        DatasetManifest cache;                // previous scan, read only once loaded
+        std::mutex mutex;                     // protects batch, removed, scanned, folders and listing
+        std::vector<std::string> batch;       // files found and not taken yet
+        std::vector<std::string> removed;     // files gone and not taken yet
+        std::vector<manifest_dir_t> scanned;  // folders listed by this scan
+        std::vector<std::pair<std::string, int64_t>> folders; // path and time of the folders listed
+        std::shared_ptr<const DatasetManifest> listing;       // content of the scan once complete
+        std::atomic<long> pending;            // folders queued or being read
+        std::atomic<long> found;              // files listed
+        std::atomic<bool> changed;            // some folders differ from the manifest
+        std::atomic<bool> cancel_flag;        // abandon the scan
+    } job_t;
+
+    std::shared_ptr<job_t> job; // shared with the tasks which keep it alive
+
+    static void load(std::shared_ptr<job_t> job);                                    // task : publish the manifest, then scan the root
+    static void scan_folder(std::shared_ptr<job_t> job, std::string path);          // task : check or read one folder (path relative to the root)
+    static void read_folder(std::shared_ptr<job_t> &job, const manifest_dir_t *cached, manifest_dir_t &dir); // list a folder from the disk
+    static void remove_tree(std::shared_ptr<job_t> &job, const std::string &path);  // publish the removal of a folder of the manifest
+    static void finish(std::shared_ptr<job_t> &job);                                // end of a task, the last one saves the manifest
+    static void flush(std::shared_ptr<job_t> &job, std::vector<std::string> &files, bool removed); // publish the changes found by a task
+};
+
+#endif
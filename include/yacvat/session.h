@@ -0,0 +1,34 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <string>
+#include <vector>
+
+/*
+
+Session of the ui saved on exit and restored on the next launch : the folder, the image shown and
+its view, the active label and the scroll of the list. The file is small and written atomically, in
+the state directory of the user ($XDG_STATE_HOME/yacvat, ~/.local/state/yacvat by default).
+
+The names of the images around the one shown are saved as well : they can be read ahead at launch,
+before the scan of the folder has listed them.
+*/
+
+typedef struct
+{
+    std::string folder;                  // images folder, empty when none was opened
+    std::string image;                   // image shown (relative to the folder)
+    float zoom;                          // view over the image
+    float pan_x;
+    float pan_y;
+    std::string label;                   // active label, empty when none
+    float scroll;                        // scroll of the list of images
+    std::vector<std::string> neighbours; // images of the list around the one shown, nearest first
+} session_t;
+
+std::string session_path(void);                                        // file of the session
+void session_clear(session_t &session);                                // no folder, default view
+bool session_load(const std::string &fname, session_t &session);       // false (session cleared) when there is none or it cannot be read
+bool session_save(const std::string &fname, const session_t &session); // create the directory and replace the file
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef SHARDS_H
+#define SHARDS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include "annotations.h"
+
+/*
+
+Optional sharded layout of the annotations, stored in a sidecar directory of the images folder :
+    - .yacvat/labels.json : configuration of the labels (type, color), in display order
+    - .yacvat/shards/<image>.json : instances of one image, grouped by label
+
+Saving an edit only rewrites the shard of the edited image (and the labels file if the configuration
+changed). Every file is written atomically with a temp name unique to the process, so several instances
+of the tool can work on disjoint subsets of the images of the same folder without conflicting. The labels
+file is merged when written : the labels added by another instance since it was read are kept, the ones
+this instance removed or renamed are dropped. Two instances saving labels at the same moment can still
+lose the addition of one of them (the merge and the replace are not locked).
+*/
+
+class AnnotationShards
+{
+public:
+    AnnotationShards();                  // default init
+    void set_folder(std::string folder); // folder containing the images
+    bool exists(void);                   // is there a sharded layout in the folder
+    void remove_labels(void);            // remove the labels file so that the folder is not detected as sharded anymore
+
+    bool write_labels(std::vector<Annotation> &annotations);                                                  // dump the configuration of the labels
+    bool write_shards(const std::set<std::string> &img_fnames, std::vector<Annotation> &annotations, float scale); // dump the instances of some images
+    void read(std::vector<Annotation> &annotations, std::map<std::string, int> &ninstperimage, float scale);
+
+private:
+    std::string root;          // sidecar directory
+    std::string labels_fname;  // full path of the labels configuration
+    std::string shards_folder; // directory containing one file per image
+    std::set<std::string> known_labels; // labels read or written by this instance, the others on disk belong to another instance
+
+    std::string shard_fname(std::string img_fname);                       // full path of the shard of an image
+    void list_shards(std::string path, std::vector<std::string> &fnames); // recursive listing of the shard files
+    void read_shard(std::string fname, std::vector<Annotation> &annotations, std::map<std::string, size_t> &label_index, std::map<std::string, int> &ninstperimage, float scale);
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+/*
+
+Timeline of the startup, up to the first frame on screen. The main thread marks the end of each phase
+(SDL, window and GL context, ImGui, application, fonts, first frame) : the time of a phase is the time
+since the previous mark, the first one is timed from startup_begin(). The timeline is logged once the
+first frame is shown, or printed by --startup-benchmark which quits right after it.
+*/
+
+void startup_begin(void);              // start of the timeline, first thing of main
+void startup_mark(const char *phase);  // end of a phase (main thread only)
+double startup_elapsed(void);          // ms since startup_begin()
+void startup_report(bool print);       // phases and total, printed on stdout or logged at info level
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef TFRECORD_H
+#define TFRECORD_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+#include "boxes.h"
+#include "mapped_file.h"
+#include "blocking_queue.h"
+
+/*
+
+Export of the images and their boxes as TFRecord files of tf.train.Example messages, with the feature
+names of the TensorFlow object detection API (image/encoded, image/object/bbox/xmin, ...). Boxes are
+normalised by the true size of the images and class ids start at 1, as in the label_map.pbtxt written
+next to the records. Files are named <name>-00000-of-00012.tfrecord and cut once they reach a size ;
+the files of a previous export with the same name and another count are removed at the end. The
+frames of the videos and the arrays have no encoded file to embed : they are skipped, not failed.
+
+The export is a pipeline of three threads linked by bounded queues :
+    - read : maps the image files and asks the kernel to read them ahead, probes their size
+    - serialize : encodes the Example around the image bytes and computes the crc of the record
+    - write : appends the records to the current file, the image bytes being taken from the mapping
+The encoded images are never copied in user space, so the export is bound by the disk, not the cpu.
+*/
+
+class TFRecordExporter
+{
+public:
+    TFRecordExporter();  // default init
+    ~TFRecordExporter(); // cancel the export in progress
+
+    // start an export in the background, returns false if one is already running
+    bool start(std::string output_folder, std::string images_folder, std::vector<image_boxes_t> &images, std::vector<std::string> &classes, uint64_t max_file_size = 256ULL << 20);
+    bool running(void);       // is an export in progress
+    long done(void);          // number of images processed by the current (or last) export
+    long total(void);         // number of images of the current (or last) export
+    long failed(void);        // number of images which could not be exported
+    long skipped(void);       // number of video frames and arrays left out (no encoded image to embed)
+    uint64_t written(void);   // number of bytes written
+
+private:
+    typedef struct
+    {
+        size_t index;                     // position of the image in the job
+        std::shared_ptr<MappedFile> file; // encoded image
+        int width;                        // size read from the header
+        int height;
+        std::string format;               // "jpeg", "png", ...
+    } image_item_t;
+
+    typedef struct
+    {
+        std::string head;                 // length, its crc and the Example up to the image bytes
+        std::shared_ptr<MappedFile> file; // image bytes, end of the Example
+        std::string tail;                 // crc of the Example
+    } record_t;
+
+    typedef struct job_s
+    {
+        std::string output_folder;
+        std::string name;                     // prefix of the record files
+        std::string images_folder;
+        std::vector<image_boxes_t> images;
+        std::vector<std::string> classes;
+        uint64_t max_file_size;
+        BlockingQueue<image_item_t> images_queue;  // read -> serialize
+        BlockingQueue<record_t> records_queue;     // serialize -> write
+        std::atomic<long> done;
+        std::atomic<long> failed;
+        long skipped;                         // video frames and arrays, not part of images
+        std::atomic<uint64_t> written;
+        std::atomic<bool> finished;
+
+        job_s() : images_queue(32), records_queue(32) {}
+    } job_t;
+
+    std::shared_ptr<job_t> job;                  // current (or last) export
+    std::thread reader, serializer, writer;      // stages of the pipeline
+
+    void join(void);                                         // wait for the threads of the last export
+    static void read_stage(std::shared_ptr<job_t> job);      // map the images
+    static void serialize_stage(std::shared_ptr<job_t> job); // encode the records
+    static void write_stage(std::shared_ptr<job_t> job);     // append the records to the files
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+/*
+
+Fixed set of worker threads shared by the background jobs (exports, folder scan, ...).
+Every worker owns a deque of tasks : a task submitted from a worker goes to the back of its deque and
+is taken back from there (depth first, hot caches), idle workers steal from the front of the others.
+Tasks submitted from other threads are spread round robin over the deques.
+*/
+
+class ThreadPool
+{
+public:
+    ThreadPool(unsigned int nthreads = 0); // 0 : one thread per core
+    ~ThreadPool();                         // finish the pending tasks and join the threads
+
+    void submit(std::function<void(void)> task); // queue a task
+    void wait(void);                             // block until every task queued is done
+    unsigned int size(void) { return this->workers.size(); }
+
+private:
+    typedef struct
+    {
+        std::mutex mutex;                            // protects tasks
+        std::deque<std::function<void(void)>> tasks; // tasks of one worker
+    } worker_queue_t;
+
+    std::vector<std::thread> workers;                     // worker threads
+    std::vector<std::unique_ptr<worker_queue_t>> queues;  // one deque per worker
+    std::atomic<long> queued;                             // tasks waiting in the deques
+    std::atomic<unsigned int> next_queue;                 // round robin of the external submissions
+    std::mutex mutex;                                     // protects pending and stop_flag, orders the wake ups
+    std::condition_variable cond;                         // a task is available
+    std::condition_variable done_cond;                    // every task is done
+    long pending;                                         // tasks queued or running
+    bool stop_flag;                                       // threads must exit once the tasks are done
+
+    bool take(unsigned int index, std::function<void(void)> &task); // own deque first, then steal
+    void run(unsigned int index);                                   // worker loop
+};
+
+#endif
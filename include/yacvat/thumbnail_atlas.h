@@ -0,0 +1,114 @@
+#ifndef THUMBNAIL_ATLAS_H
+#define THUMBNAIL_ATLAS_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+#include "thread_pool.h"
+#include "manifest.h"
+#include "mapped_file.h"
+
+/*
+
+Thumbnails of every image of a folder, for the grid view of the list. They are computed in the
+background by small chunks spread over every thread of the pool (decode, then the mean of the pixels
+under each pixel of a cell of 64 x 64) and kept in a cache next to the manifest :
+- .yacvat-thumbs : the cells one after the other, 16 KB of rgba each. Written by the tasks, mapped
+  by the ui which reads the cells it shows and nothing else.
+- .yacvat-thumbs.idx : path, size and modification time of the image of each cell, and the size of
+  its thumbnail. Saved every few seconds and at the end, like the hashes of the duplicates.
+
+A thumbnail is computed again only when its image changed (size or time of the listing of the scan),
+the cells of the images gone are reused. The cells asked for by the ui (the visible part of the grid)
+are computed before the others, the last ones asked first.
+
+Videos and arrays have no thumbnail.
+*/
+
+static const int THUMBNAIL_CELL = 64; // side of a cell (pixels)
+
+typedef struct
+{
+    std::string path;      // relative to the folder, as in the list
+    uint64_t size;         // of the image file when its thumbnail was computed
+    int64_t mtime;
+    uint32_t cell;         // position in the cells
+    uint16_t width;        // of the thumbnail from the top left corner of its cell, 0 if the image cannot be decoded
+    uint16_t height;
+    uint32_t image_width;  // of the image
+    uint32_t image_height;
+} thumbnail_record_t;
+
+class ThumbnailAtlas
+{
+public:
+    ThumbnailAtlas();  // default init
+    ~ThumbnailAtlas(); // cancel the computation in progress
+
+    // cancel the previous computation, read the cache of the folder and compute the thumbnails missing from the listing of a scan
+    void start(ThreadPool &pool, std::string folder, std::shared_ptr<const DatasetManifest> listing);
+    void cancel(void);                             // stop the computation, the thumbnails computed since the last save are dropped
+    bool started(const std::string &folder);       // was the cache of this folder opened
+    bool running(void);                            // is the computation in progress
+    void progress(long *done, long *total);        // thumbnails computed by this computation and thumbnails to compute
+    void poll(void);                               // ui : install the thumbnails computed since the last poll
+    const thumbnail_record_t *find(const std::string &entry); // thumbnail of an entry of the list, null if not computed
+    const unsigned char *pixels(const thumbnail_record_t *record); // rgba of its cell (THUMBNAIL_CELL pixels per row), null if not mapped
+    void prefetch(const thumbnail_record_t *record); // read the cell ahead of its use
+    void want(const std::string &entry);           // compute the thumbnail of an entry before the others
+
+private:
+    typedef struct
+    {
+        std::string path;
+        uint64_t size;
+        int64_t mtime;
+    } item_t;
+
+    typedef struct job_s
+    {
+        std::string folder;
+        std::string cells_fname;
+        std::string index_fname;
+        int fd;                                     // cells file, written by the tasks
+        std::vector<item_t> items;                  // images to compute
+        std::unordered_map<std::string, size_t> item_index; // path -> position in items, read only once planned
+        std::unique_ptr<std::atomic<uint8_t>[]> states; // of the items : idle, wanted, claimed
+        std::atomic<size_t> cursor;                 // next item in order
+        std::atomic<bool> planned;                  // items ready
+        std::mutex mutex;                           // protects wanted, records and free_cells
+        std::vector<size_t> wanted;                 // items asked for by the ui, the last one first
+        std::vector<thumbnail_record_t> records;    // every thumbnail of the cache, the new ones at the end
+        std::vector<uint32_t> free_cells;           // cells of images gone
+        uint32_t next_cell;                         // first cell never used
+        std::atomic<bool> saving;                   // a task is writing the index
+        std::atomic<int64_t> last_save;             // time of the last save (ms)
+        std::atomic<long> pending;                  // tasks queued or running
+        std::atomic<long> done;                     // thumbnails computed
+        std::atomic<long> total;                    // thumbnails to compute
+        std::atomic<bool> cancel_flag;              // abandon the computation
+        std::atomic<bool> done_flag;                // every thumbnail computed and saved
+        std::atomic<long> writers;                  // tasks writing the cells or the index, none starts once cancelled
+        std::shared_ptr<job_s> previous;            // cancelled job of the same cache, its writes end before the plan
+        ~job_s();                                   // close the cells file
+    } job_t;
+
+    std::shared_ptr<job_t> job;                                 // shared with the tasks which keep it alive
+    std::string folder;                                         // of the cache opened
+    std::string cells_fname;
+    std::unordered_map<std::string, thumbnail_record_t> records; // installed
+    size_t installed;                                           // records of the job installed
+    MappedFile cells;                                           // mapping of the cells file
+    uint32_t mapped_cells;                                      // cells in the mapping
+
+    static void plan(std::shared_ptr<job_t> job, ThreadPool *pool, std::shared_ptr<const DatasetManifest> listing); // task : read the index, list the images to compute
+    static void compute(std::shared_ptr<job_t> job, ThreadPool *pool);  // task : a few thumbnails, then queued again while some are left
+    static bool next_item(std::shared_ptr<job_t> &job, size_t *item);   // wanted first, then in order
+    static void save(std::shared_ptr<job_t> &job);                      // write the index
+};
+
+#endif
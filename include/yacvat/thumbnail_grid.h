@@ -0,0 +1,61 @@
+#ifndef THUMBNAIL_GRID_H
+#define THUMBNAIL_GRID_H
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <SDL_opengl.h>
+#include "imgui.h"
+
+/*
+
+Drawing of the thumbnails of the grid view. The cells of the visible thumbnails are copied from the
+mapping of the thumbnail cache to the layers of a GL array texture, each one once while it stays
+visible : scrolling only uploads the cells which come into view, at most a few dozen per frame (the
+others are uploaded on the next frames). The layers of the cells not drawn for the longest time are
+reused. The thumbnails of the frame are drawn by a single instanced call from a draw list callback,
+like the overlays.
+
+Without the OpenGL 3.0 entry points (array textures), available() is false and the grid only shows
+the names of the images.
+*/
+
+typedef struct
+{
+    float rect[4]; // thumbnail on screen (pixels) : x0, y0, x1, y1
+    float tex[4];  // part of the cell used (in [0, 1]), layer, unused
+} grid_instance_t;
+
+class ThumbnailGrid
+{
+public:
+    ThumbnailGrid();  // default init
+    ~ThumbnailGrid(); // release the texture and the buffers
+
+    bool available(void); // can the thumbnails be drawn (GL entry points loaded, program linked)
+    void begin(void);     // new frame : forget the thumbnails of the previous one
+    // thumbnail of width x height pixels at the top left of a cell (pixels of the whole cell), drawn from min to max : false if it cannot be uploaded on this frame
+    bool add(uint32_t cell, const unsigned char *pixels, int width, int height, ImVec2 min, ImVec2 max);
+    void draw(ImDrawList *draw_list); // queue the drawing of the thumbnails added, between the other commands of the list
+    void reset(void);                 // the cells changed (another folder) : the layers are filled again
+    void release(void);               // delete the texture and the buffers, while the GL context is alive
+    long uploaded(void) { return this->uploads; } // cells uploaded by the current frame
+
+private:
+    std::vector<grid_instance_t> instances;    // thumbnails of the frame
+    GLuint texture;                            // array texture, a cell per layer
+    std::vector<uint32_t> layer_cells;         // cell of each layer
+    std::vector<uint64_t> layer_frames;        // frame where each layer was last drawn
+    std::unordered_map<uint32_t, int> layers;  // cell -> layer
+    size_t hand;                               // next layer looked at to be reused
+    uint64_t frame;                            // frames drawn
+    long uploads;                              // cells uploaded by the current frame
+    GLuint vao;                                // vertex array of the instance attributes
+    GLuint vbo;                                // instance buffer
+    size_t capacity;                           // instances the buffer can hold
+
+    int layer(uint32_t cell, const unsigned char *pixels); // layer holding a cell, uploaded if needed, -1 if none can be
+    static void render(const ImDrawList *draw_list, const ImDrawCmd *cmd); // draw list callback
+};
+
+#endif
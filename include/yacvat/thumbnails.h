@@ -0,0 +1,42 @@
+#ifndef THUMBNAILS_H
+#define THUMBNAILS_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+
+/*
+
+Small versions of the images already shown, kept in memory so that an image opened again is on screen
+at once : its thumbnail is uploaded and drawn while the full image is decoded in the background. The
+thumbnails are one of the mipmap levels computed after the upload of each image (no extra decode, no
+extra reduction). The least recently used ones are dropped past a budget of bytes.
+*/
+
+typedef struct
+{
+    int width;
+    int height;
+    std::vector<unsigned char> pixels; // rgba
+} thumbnail_t;
+
+class ThumbnailCache
+{
+public:
+    ThumbnailCache(size_t budget); // bytes of pixels kept at most
+
+    void put(const std::string &fname, int width, int height, std::vector<unsigned char> &pixels); // the pixels are moved into the cache
+    const thumbnail_t *get(const std::string &fname); // null if not cached, valid until the next put
+    void clear(void);                                 // forget every thumbnail (another folder)
+
+private:
+    typedef std::pair<std::string, thumbnail_t> entry_t;
+
+    std::list<entry_t> entries;                                          // most recently used first
+    std::unordered_map<std::string, std::list<entry_t>::iterator> index; // file name -> entry
+    size_t bytes;                                                        // of the pixels cached
+    size_t budget;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef VIDEO_SOURCE_H
+#define VIDEO_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+#include "mapped_file.h"
+
+/*
+
+Uncompressed video streams read frame by frame : YUV4MPEG2 files (.y4m) and raw planar YUV files (.yuv).
+A raw file has no header, it is described by a json file next to it (x.yuv -> x.yuv.json) :
+
+    {"width": 1920, "height": 1080, "chroma": "420", "depth": 8, "offset": 0}
+
+where chroma is "420" (the default), "422", "444" or "mono", and depth the bits per sample (8, or up
+to 16 stored on 2 little endian bytes).
+
+Every frame of a video is an entry of the image list, named after the video and the frame number
+("camera/clip.y4m/000042") : the annotations of a frame are keyed by this name like those of an image.
+
+The frames of a .y4m start with a "FRAME" line which may carry parameters, so their positions are only
+known by walking the stream. The offsets are found once, when the folder is scanned, and saved in a
+hidden file next to the video (.clip.y4m.yacvat-index) ; a stream whose frame lines are all the same
+is stored as a first offset and a stride. The file is mapped and the planes of a frame are given as
+they are to the texture upload, the conversion to rgb is done by the ArrayView shader.
+*/
+
+typedef enum
+{
+    CHROMA_420,
+    CHROMA_422,
+    CHROMA_444,
+    CHROMA_MONO,
+} video_chroma_t;
+
+typedef struct
+{
+    int width;
+    int height;
+    video_chroma_t chroma;
+    int depth;          // bits per sample, on 2 bytes above 8
+    size_t header;      // bytes before the first frame line (y4m) or the first frame (raw)
+    size_t frame_size;  // bytes of the planes of a frame
+    bool y4m;           // frames start with a FRAME line
+} video_format_t;
+
+typedef struct
+{
+    const unsigned char *planes[3]; // y, u and v, u and v are null in mono
+    int width[3];                   // dimensions of each plane
+    int height[3];
+    int depth;                      // bits per sample
+} video_frame_t;
+
+class VideoSource
+{
+public:
+    VideoSource(); // default init
+
+    static bool handles(const std::string &fname);                        // is the file a .y4m or a .yuv
+    static bool probe(const std::string &fname, video_format_t *format);  // read the stream header (or the description of a raw file) only
+    static long count_frames(const std::string &fname);                   // frames of a video from its index, built and saved if missing, -1 on error
+
+    bool open(const std::string &fname);          // map a video and load its frame index
+    void close(void);                             // unmap the video
+    bool is_open(void) { return this->file.data() != nullptr; }
+    const std::string &name(void) { return this->fname; }
+    const video_format_t &format(void) { return this->fmt; }
+    long frames(void) { return this->count; }
+    bool frame(long n, video_frame_t *frame);     // planes of a frame, pointing in the mapping
+    void prefetch(long n, long count);            // ask the kernel to read frames [n, n + count) ahead
+
+private:
+    typedef struct
+    {
+        uint64_t count;                  // frames of the stream
+        uint64_t first;                  // offset of the first frame data
+        uint64_t stride;                 // bytes between two frames, 0 when they are irregular
+        std::vector<uint64_t> offsets;   // offset of every frame data when irregular
+    } frame_index_t;
+
+    MappedFile file;          // mapping of the whole video
+    std::string fname;        // path of the mapped video
+    video_format_t fmt;       // format read from the header
+    frame_index_t index;      // position of the frames
+    long count;               // frames of the stream
+
+    static bool build_index(const std::string &fname, const video_format_t &format, MappedFile &file, frame_index_t *index); // walk the frame lines
+    static bool load_index(const std::string &fname, frame_index_t *index); // saved index, false if missing or outdated
+    static bool save_index(const std::string &fname, const frame_index_t &index);
+    static bool get_index(const std::string &fname, const video_format_t &format, MappedFile &file, frame_index_t *index); // saved or built
+    size_t offset(long n);    // offset of the data of a frame
+};
+
+std::string video_frame_name(const std::string &video, long frame);               // entry of the image list for a frame of a video
+bool video_frame_of(const std::string &name, std::string *video, long *frame);    // video and frame of an entry, false for an image
+
+#endif
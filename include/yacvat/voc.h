@@ -0,0 +1,47 @@
+#ifndef VOC_H
+#define VOC_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include "boxes.h"
+#include "thread_pool.h"
+
+/*
+
+Export of the annotations as Pascal VOC xml files, one per image (folder/x.jpg -> output/x.xml).
+Images are split in chunks spread over the thread pool. Each task probes the size of its images
+from their headers and streams the xml text to the files, no document is built. The progress is
+read from the ui thread without waiting on the workers.
+*/
+
+class VocExporter
+{
+public:
+    VocExporter(); // default init
+
+    // start an export in the background, returns false if one is already running
+    bool start(ThreadPool &pool, std::string output_folder, std::string images_folder, std::vector<image_boxes_t> &images, std::vector<std::string> &classes);
+    bool running(void);  // is an export in progress
+    long done(void);     // number of images processed by the current (or last) export
+    long total(void);    // number of images of the current (or last) export
+    long failed(void);   // number of images not exported (size unknown or file not written)
+
+private:
+    typedef struct
+    {
+        std::string output_folder;
+        std::string images_folder;
+        std::vector<image_boxes_t> images;
+        std::vector<std::string> classes;
+        std::atomic<long> done;
+        std::atomic<long> failed;
+    } job_t;
+
+    std::shared_ptr<job_t> job; // shared with the tasks which keep it alive
+
+    static void write_chunk(std::shared_ptr<job_t> job, size_t start, size_t end); // task : export images [start, end)
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef WAKEUP_H
+#define WAKEUP_H
+
+#include <SDL.h>
+
+/*
+
+Wake up of the ui thread, which sleeps in SDL_WaitEventTimeout while nothing changes on screen. The
+background work calls ui_wakeup() when it has something for the ui (the thread pool once its tasks
+are all done, the watcher when files changed) : an SDL user event is pushed, so the main loop draws
+a frame. Whatever the number of calls, a single event is pending at a time. ui_wakeup_after() does
+the same from an SDL timer, for the ui which has to come back later (throttled work).
+*/
+
+void ui_wakeup_init(void);                    // register the event, after SDL_Init : the calls before are ignored
+void ui_wakeup(void);                         // thread safe, push the wake up event if none is pending
+void ui_wakeup_after(Uint32 ms);              // wake up in ms milliseconds (unless an earlier wake up is planned)
+bool ui_wakeup_event(const SDL_Event &event); // is it the wake up event (it is then no longer pending)
+
+#endif
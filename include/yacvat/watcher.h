@@ -0,0 +1,74 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+
+/*
+
+Live watching of an images folder with inotify, started once the folder is scanned : a thread
+watches every folder of the tree and turns the notifications into changes of the list of images.
+- a file is added when it is closed after writing or moved in (not on creation, it is still empty)
+- a move inside the tree is a rename when both ends are seen, a removal or an addition otherwise
+- a folder created or moved in is watched and listed, a folder removed or moved out is dropped
+- videos are ignored, their frames are listed by the next scan
+
+The folders modified between their scan and their watch are listed again, so that the images added
+in between are not missed. Notifications only come from the local kernel : changes made through
+another client of a network file system are not seen.
+*/
+
+typedef enum
+{
+    WATCH_ADDED,
+    WATCH_REMOVED,
+    WATCH_RENAMED,
+    WATCH_FOLDER_REMOVED,
+} watch_event_type_t;
+
+typedef struct
+{
+    watch_event_type_t type;
+    std::string path;     // relative to the watched folder
+    std::string new_path; // WATCH_RENAMED only
+} watch_event_t;
+
+class FolderWatcher
+{
+public:
+    FolderWatcher();  // default init
+    ~FolderWatcher(); // stop the thread
+
+    // stop the previous watch and start a new one on the folders listed by a scan (relative path, modification time)
+    bool start(std::string folder, const std::set<std::string> &extensions, const std::vector<std::pair<std::string, int64_t>> &folders);
+    void stop(void);                              // stop watching
+    bool running(void) { return this->worker.joinable(); }
+    void take(std::vector<watch_event_t> &events); // move the changes since the last call, in order
+
+private:
+    std::string folder;                             // watched folder
+    std::set<std::string> extensions;               // accepted extensions
+    int inotify_fd;                                 // inotify instance
+    int stop_pipe[2];                               // wakes the thread up to stop it
+    std::thread worker;                             // thread reading the notifications
+    std::mutex mutex;                               // protects events
+    std::vector<watch_event_t> events;              // changes not taken yet
+    std::unordered_map<int, std::string> watches;   // watch descriptor -> relative path (worker only)
+    std::unordered_map<std::string, int> watched;   // relative path -> watch descriptor (worker only)
+    std::vector<std::pair<std::string, int64_t>> initial; // folders to watch on startup (worker only)
+
+    void run(void);                                                // worker loop
+    void add_watch(const std::string &path, std::vector<watch_event_t> &batch, bool list); // watch a folder, list its images if needed
+    void drop_watches(const std::string &path);                    // forget a folder and its sub folders
+    bool accepted(const std::string &name);                        // is the extension of a file accepted
+    bool decodable(const std::string &path);                       // can a new file be decoded (relative path)
+    void publish(std::vector<watch_event_t> &batch);               // hand changes to the ui thread
+};
+
+#endif
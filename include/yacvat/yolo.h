@@ -0,0 +1,68 @@
+#ifndef YOLO_H
+#define YOLO_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdint.h>
+#include "boxes.h"
+
+/*
+
+Synchronisation of the annotations with a YOLO label directory : one text file per image with a
+line "class x_center y_center width height" per box, normalised by the true size of the image.
+The directory is the sibling "labels" folder when the images are in a folder named "images"
+(the usual YOLO layout), a "labels" subfolder otherwise. Point annotations have no YOLO equivalent
+and are not written, but they keep their class index.
+
+Only the images flagged as dirty are sent to the background worker, and the worker only writes the
+files whose content changed since the last sync : a hash of the boxes of every synced image is
+appended to a journal in the label directory, so that the diff also holds across sessions.
+*/
+
+class YoloSync
+{
+public:
+    YoloSync();  // default init, starts the worker
+    ~YoloSync(); // finish the pending jobs and stop the worker
+
+    void set_folder(std::string folder);                                             // folder containing the images
+    bool exists(void);                                                               // has the folder already been synced
+    void request(std::vector<image_boxes_t> &images, std::vector<std::string> &classes); // queue a sync of some images
+    bool busy(void);                                                                 // is the worker processing a job
+    long files_written(void) { return this->nwritten; }                              // number of label files written since startup
+
+private:
+    typedef struct
+    {
+        std::string images_folder;
+        std::string labels_folder;
+        std::vector<image_boxes_t> images;
+        std::vector<std::string> classes;
+    } job_t;
+
+    std::string images_folder;                           // folder containing the images
+    std::string labels_folder;                           // folder containing the label files
+    std::deque<job_t> jobs;                              // pending jobs
+    std::mutex mutex;                                    // protects jobs and stop_flag
+    std::condition_variable cond;                        // wakes the worker up
+    std::thread worker;                                  // background thread writing the files
+    bool stop_flag;                                      // worker must exit once the jobs are done
+    std::atomic<bool> busy_flag;                         // a job is being processed
+    std::atomic<long> nwritten;                          // number of label files written
+    std::string synced_folder;                           // label folder the hashes below belong to
+    std::unordered_map<std::string, uint64_t> synced;    // image -> hash of the boxes written (worker only)
+    std::unordered_map<std::string, std::pair<int, int>> sizes; // image -> probed width and height (worker only)
+    std::string synced_classes;                          // content of classes.txt written (worker only)
+
+    void run(void);                 // worker loop
+    void process(job_t &job);       // write the label files of a job
+    void load_journal(job_t &job);  // read the hashes of the previous syncs
+};
+
+#endif
@@ -52,8 +52,11 @@ AnnotationInstance::AnnotationInstance(void)
     this->inner_rect = Rectangle(vec2f(0, 0), vec2f(0, 0));
     this->delta = 10.0;
     this->selected = false;
+    this->request_json_write = false;
     this->dragging_flag = false;
     this->resizing_dir = Direction::NONE;
+    this->refresh_flag = false;
+    this->zoom = 1.0;
 }
 
 void AnnotationInstance::update_bounding_box(void)
@@ -83,30 +86,42 @@ void AnnotationInstance::set_fname(std::string fname)
     this->img_fname = fname;
 }
 
+void AnnotationInstance::rescale(float ratio)
+{
+    vec2f _tl = this->rect_on_image.get_topleft_vertex() * ratio;
+    vec2f _br = this->rect_on_image.get_bottomright_vertex() * ratio;
+    this->rect_on_image = Rectangle(_tl, _br);
+
+    // the box on screen is recomputed on the next update
+    this->refresh_flag = true;
+}
+
 void AnnotationInstance::set_color(float color[4])
 {
     for (int k = 0; k < 4; k++)
         this->color_u8[k] = color[k] * 255;
 }
 
-void AnnotationInstance::update_point(void)
+void AnnotationInstance::update_point(vec2f origin, float zoom)
 {
-    vec2f _w = ImGui::GetWindowPos();
-    bool update_flag = false;
-    if ((_w.x != this->window_pos.x) || (_w.y != this->window_pos.y))
+    // the view moved (window, pan or zoom) : the box on screen is computed again
+    bool update_flag = this->refresh_flag;
+    if ((origin.x != this->window_pos.x) || (origin.y != this->window_pos.y) || (zoom != this->zoom))
     {
         update_flag = true;
-        this->window_pos = _w;
+        this->window_pos = origin;
+        this->zoom = zoom;
     }
+    this->refresh_flag = false;
 
     vec2<float> _m = ImGui::GetMousePos();
 
-    // compute absolute coodinates of the start vertex
-    vec2f _rect_on_image_topleft = this->rect_on_image.get_topleft_vertex();
-    vec2f _rect_on_image_bottomright = this->rect_on_image.get_bottomright_vertex();
+    // coordinates of the vertices relative to the origin of the image on screen
+    vec2f _rect_on_image_topleft = this->rect_on_image.get_topleft_vertex() * this->zoom;
+    vec2f _rect_on_image_bottomright = this->rect_on_image.get_bottomright_vertex() * this->zoom;
 
     if (update_flag == true)
-        this->rect.set_topleft_vertex(vec2f(window_pos.x + _rect_on_image_topleft.x, window_pos.y + _rect_on_image_topleft.y));
+        this->rect.set_topleft_vertex(this->window_pos + _rect_on_image_topleft);
 
     // update HOVER fsm
     if ((this->hover_fsm.state() == HoverStates::HOVER) && !outer_rect.inside(_m))
@@ -139,7 +154,7 @@ void AnnotationInstance::update_point(void)
 
         // position on screen of the end vertex
         if (update_flag == true)
-            this->rect.set_bottomright_vertex(vec2f(_rect_on_image_bottomright.x + window_pos.x, _rect_on_image_bottomright.y + window_pos.y));
+            this->rect.set_bottomright_vertex(this->window_pos + _rect_on_image_bottomright);
 
         if (this->status_fsm.state() == StatusStates::IDLE)
         {
@@ -184,7 +199,7 @@ void AnnotationInstance::update_point(void)
                     update_flag = true;                                                         // request bounding box update
                     this->dragging_flag = false;                                                // reset the processing flag
                     this->request_json_write = true;                                            // request a json dump
-                    this->rect_on_image.set_center(this->rect.get_center() - this->window_pos); // update position
+                    this->rect_on_image.set_center((this->rect.get_center() - this->window_pos) / this->zoom); // update position
                 }
             }
         }
@@ -199,24 +214,26 @@ void AnnotationInstance::update_point(void)
         this->update_bounding_box();
 }
 
-void AnnotationInstance::update_area(void)
+void AnnotationInstance::update_area(vec2f origin, float zoom)
 {
-    vec2f _w = ImGui::GetWindowPos();
-    bool update_flag = false;
-    if ((_w.x != this->window_pos.x) || (_w.y != this->window_pos.y))
+    // the view moved (window, pan or zoom) : the box on screen is computed again
+    bool update_flag = this->refresh_flag;
+    if ((origin.x != this->window_pos.x) || (origin.y != this->window_pos.y) || (zoom != this->zoom))
     {
         update_flag = true;
-        this->window_pos = _w;
+        this->window_pos = origin;
+        this->zoom = zoom;
     }
+    this->refresh_flag = false;
 
     vec2<float> _m = ImGui::GetMousePos();
 
-    // compute absolute coodinates of the start vertex
-    vec2f _rect_on_image_topleft = this->rect_on_image.get_topleft_vertex();
-    vec2f _rect_on_image_bottomright = this->rect_on_image.get_bottomright_vertex();
+    // coordinates of the vertices relative to the origin of the image on screen
+    vec2f _rect_on_image_topleft = this->rect_on_image.get_topleft_vertex() * this->zoom;
+    vec2f _rect_on_image_bottomright = this->rect_on_image.get_bottomright_vertex() * this->zoom;
 
     if (update_flag == true)
-        this->rect.set_topleft_vertex(vec2f(window_pos.x + _rect_on_image_topleft.x, window_pos.y + _rect_on_image_topleft.y));
+        this->rect.set_topleft_vertex(this->window_pos + _rect_on_image_topleft);
 
     // update HOVER fsm
     if ((this->hover_fsm.state() == HoverStates::HOVER) && !outer_rect.inside(_m))
@@ -249,7 +266,7 @@ void AnnotationInstance::update_area(void)
 
         // position on screen of the end vertex
         if (update_flag == true)
-            this->rect.set_bottomright_vertex(vec2f(_rect_on_image_bottomright.x + window_pos.x, _rect_on_image_bottomright.y + window_pos.y));
+            this->rect.set_bottomright_vertex(this->window_pos + _rect_on_image_bottomright);
 
         if (this->status_fsm.state() == StatusStates::IDLE)
         {
@@ -339,7 +356,7 @@ void AnnotationInstance::update_area(void)
                     update_flag = true;                                                         // request bounding box update
                     this->dragging_flag = false;                                                // reset the processing flag
                     this->request_json_write = true;                                            // request a json dump
-                    this->rect_on_image.set_center(this->rect.get_center() - this->window_pos); // update position
+                    this->rect_on_image.set_center((this->rect.get_center() - this->window_pos) / this->zoom); // update position
                 }
             }
 
@@ -375,6 +392,7 @@ void AnnotationInstance::update_area(void)
                     this->resizing_dir = Direction::NONE; // reset
                     this->request_json_write = true;      // request a json dump
                     update_flag = true;                   // request bounding box update
+                    this->rect_on_image = Rectangle((this->rect.get_topleft_vertex() - this->window_pos) / this->zoom, (this->rect.get_bottomright_vertex() - this->window_pos) / this->zoom);
                 }
             }
         }
@@ -450,3 +468,47 @@ void AnnotationInstance::draw_point(void)
 
     draw_list->AddCircle(this->rect.get_center(), 10.0, IM_COL32(this->color_u8[0], this->color_u8[1], this->color_u8[2], this->color_u8[3]), 16, _thickness);
 }
+
+void AnnotationInstance::overlay_area(OverlayRenderer &overlay)
+{
+    vec2f _tl = this->rect.get_topleft_vertex();
+    vec2f _br = this->rect.get_bottomright_vertex();
+    float _thickness = 1.0;
+    float _fill = 0.0;
+    if (this->status_fsm.state() == StatusStates::CREATE)
+    {
+        // the rectangle goes all the way to the mouse cursor
+        _br = ImGui::GetMousePos();
+    }
+    else if (this->status_fsm.state() == StatusStates::IDLE)
+    {
+        if ((this->hover_fsm.state() == HoverStates::HOVER) || (this->hover_fsm.state() == HoverStates::INSIDE))
+            _thickness = 3.0;
+    }
+    else if (this->status_fsm.state() == StatusStates::EDIT)
+    {
+        _thickness = 3.0;
+        if ((this->hover_fsm.state() == HoverStates::INSIDE) || (this->dragging_flag == true))
+            _fill = 25.0 / 255.0;
+    }
+    overlay.add_box(_tl.x, _tl.y, _br.x, _br.y, this->color_u8, _thickness, _fill);
+}
+
+void AnnotationInstance::overlay_point(OverlayRenderer &overlay)
+{
+    vec2f _c = this->rect.get_center();
+    float _thickness = 2.0;
+    float _fill = 0.0;
+    if (this->status_fsm.state() == StatusStates::IDLE)
+    {
+        if (this->hover_fsm.state() == HoverStates::HOVER)
+            _thickness = 3.0;
+    }
+    else if (this->status_fsm.state() == StatusStates::EDIT)
+    {
+        _thickness = 3.0;
+        if ((this->hover_fsm.state() == HoverStates::INSIDE) || (this->dragging_flag == true))
+            _fill = 25.0 / 255.0;
+    }
+    overlay.add_circle(_c.x, _c.y, 10.0, this->color_u8, _thickness, _fill);
+}
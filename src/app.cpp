@@ -1,9 +1,14 @@
 #include "yacvat/app.h"
 #include "yacvat/IconsFontAwesome4.h"
-#include "yacvat/notofont.h"
-#include "yacvat/fontawesome.h"
+#include "yacvat/font_atlas.h"
 #include "yacvat/IconsFontAwesome4.h"
 #include "yacvat/vec2.h"
+#include "yacvat/coco.h"
+#include "yacvat/image_info.h"
+#include "yacvat/wakeup.h"
+#include "yacvat/files.h"
+#include "yacvat/startup.h"
+#include "yacvat/frame_profile.h"
 
 #include "spdlog/spdlog.h"
 #include "imgui.h"
@@ -12,33 +17,100 @@
 
 #include <iostream>
 #include <vector>
-#include <dirent.h>
 #include <set>
 #include <fstream>
 #include <algorithm> // for reverse
+#include <unordered_map>
+#include <chrono>
+#include <cstring>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-AnnotationApp::AnnotationApp(void)
+static const long PREFETCH_FRAMES = 8; // frames of a video read ahead of the one shown
+static const float ZOOM_MIN = 0.125f;  // zoom of the view over the image fitted to the panel
+static const float ZOOM_MAX = 64.0f;
+static const float ZOOM_STEP = 1.25f;  // zoom factor of a notch of the wheel
+static const long SESSION_NEIGHBOURS = 4;   // images saved on each side of the one shown
+static const size_t DECODED_NEIGHBOURS = 2; // nearest of them decoded at launch, the others only read into the page cache
+static const int THUMBNAIL_SIZE = 256;      // largest side of the thumbnails shown while an image is decoded
+static const size_t THUMBNAIL_BUDGET = 64 << 20; // bytes of thumbnails kept in memory
+static const float GRID_SPACING = 8.0f;     // between the cells of the thumbnail grid (pixels)
+static const int GRID_PREFETCH_ROWS = 4;    // rows of the grid below the visible ones read ahead
+
+AnnotationApp::AnnotationApp(void) : thumbnails(THUMBNAIL_BUDGET)
 {
     spdlog::info("Instanciation of AnnotationApp object.");
 
     open_images_folder_flag = false;
+    import_coco_flag = false;
+    export_coco_flag = false;
+    export_voc_flag = false;
+    export_tfrecord_flag = false;
+    scanning_flag = false;
+    last_merge_time = 0.0;
+    filter.mode = FILTER_ALL;
+    filter.label = -1;
+    filter_text[0] = '\0';
+    view_dirty = false;
+    filter_rebuild_flag = true;
+    sort_order = ORDER_NAME;
+    last_order_time = 0.0;
 
     ext_set.clear();
     ext_set.insert("png");
     ext_set.insert("jpeg");
     ext_set.insert("jpg");
+    ext_set.insert("bmp");
+    ext_set.insert("tga");
+    ext_set.insert("gif");
+    ext_set.insert("pnm");
+    ext_set.insert("pgm");
+    ext_set.insert("ppm");
+    ext_set.insert("npy");
+    ext_set.insert("raw");
+    ext_set.insert("y4m");
+    ext_set.insert("yuv");
 
     current_image_texture = 0;
+    image_texture = 0;
+    zoom = 1.0f;
+    panning_flag = false;
+    minimap_flag = true;
+    minimap_dirty = true;
+    placeholder_flag = false;
+    grid_flag = false;
+    grid_pending = false;
+    grid_boxes_dirty = true;
+    open_time = 0.0;
+    first_pixel_flag = false;
+    display_times.first_pixel = 0.0;
+    display_times.full = 0.0;
+    display_times.first_pixel_sum = 0.0;
+    display_times.count = 0;
+    display_times.from_thumbnail = false;
+    compute_scale_flag = false;
+    pending_session_flag = false;
+    list_scroll = 0.0f;
+    session_clear(pending_session);
+    batched_overlay_flag = true;
+    overlay_stats.instances = 0;
+    overlay_stats.vertices = 0;
+    overlay_stats.bytes = 0;
+    array_flag = false;
+    video_flag = false;
     this->startup_flag = true;
+    this->scale = 1.0;
+    this->annotations_scale = 1.0;
+    this->sharded_flag = false;
+    this->dirty_labels = false;
+    this->yolo_flag = false;
 
     for (auto e : ext_set)
         spdlog::debug("set of extension allowed : {}", e);
 }
 
-void AnnotationApp::ui_initialize(void)
+void AnnotationApp::ui_initialize(bool baked_fonts)
 {
     ImGuiIO &io = ImGui::GetIO();
 
@@ -59,15 +131,16 @@ void AnnotationApp::ui_initialize(void)
     // io.Fonts->AddFontDefault();
     // io.Fonts->AddFontFromFileTTF("assets/NotoSans-Regular.ttf", 18.0f);
 
-    // basic font
-    io.Fonts->AddFontFromMemoryCompressedTTF(NotoFont_compressed_data, NotoFont_compressed_size, 18.0f);
-
-    // merge in icons from Font Awesome
-    static const ImWchar icons_ranges[] = {ICON_MIN_FA, ICON_MAX_16_FA, 0};
-    ImFontConfig icons_config;
-    icons_config.MergeMode = true;
-    icons_config.PixelSnapH = true;
-    io.Fonts->AddFontFromMemoryCompressedTTF(fontawesome_webfont_compressed_data, fontawesome_webfont_compressed_size, 16.0f, &icons_config, icons_ranges);
+    // atlas baked at build time (basic font with the icons from Font Awesome merged in), rasterised here if it cannot be used
+    auto start = std::chrono::steady_clock::now();
+    bool restored = baked_fonts && font_atlas_restore(io.Fonts, font_atlas_blob, font_atlas_blob_size);
+    if (!restored)
+    {
+        font_atlas_add_fonts(io.Fonts);
+        io.Fonts->Build();
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("Fonts ready in {:.1f} ms ({})", ms, restored ? "baked atlas" : "rasterised at startup");
     // io.Fonts->AddFontFromFileTTF("../../misc/fonts/Cousine-Regular.ttf", 15.0f);
     // io.Fonts->AddFontFromFileTTF("../../misc/fonts/DroidSans.ttf", 16.0f);
     // io.Fonts->AddFontFromFileTTF("../../misc/fonts/ProggyTiny.ttf", 10.0f);
@@ -81,7 +154,8 @@ void AnnotationApp::ui_main_window(void)
     ImGui::SetNextWindowPos(viewport->WorkPos);
     ImGui::SetNextWindowSize(viewport->WorkSize);
 
-    ImGui::Begin("Annotation Tool", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoResize);
+    // kept behind the overlays (frame profile) when clicked
+    ImGui::Begin("Annotation Tool", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoBringToFrontOnFocus);
 
     ImGui::PushStyleVar(ImGuiStyleVar_ChildRounding, 5.0f);
 
@@ -93,6 +167,16 @@ void AnnotationApp::ui_main_window(void)
         {
             if (ImGui::MenuItem("Open folder"))
                 this->open_images_folder_flag = true;
+            if (ImGui::MenuItem("Minimap", nullptr, this->minimap_flag))
+                this->minimap_flag = !this->minimap_flag;
+            if (ImGui::MenuItem("Thumbnail grid", nullptr, this->grid_flag))
+                this->grid_flag = !this->grid_flag;
+            if (this->display_times.count > 0)
+            {
+                ImGui::Separator();
+                ImGui::TextDisabled("First pixel in %.1f ms (%s), full resolution in %.1f ms", this->display_times.first_pixel, this->display_times.from_thumbnail ? "thumbnail" : "full image", this->display_times.full);
+                ImGui::TextDisabled("Mean time to first pixel %.1f ms over %ld images", this->display_times.first_pixel_sum / this->display_times.count, this->display_times.count);
+            }
 
             ImGui::EndMenu();
         }
@@ -119,7 +203,10 @@ void AnnotationApp::ui_main_window(void)
     }
 
     // display images files
-    this->ui_images_folder();
+    {
+        FrameTimer timer(PHASE_IMAGES_FOLDER);
+        this->ui_images_folder();
+    }
 
     ImGui::EndChild();
 
@@ -152,6 +239,36 @@ void AnnotationApp::ui_main_window(void)
             {
                 this->save_json_flag = true;
             }
+            if (ImGui::MenuItem("Import COCO"))
+            {
+                this->import_coco_flag = true;
+            }
+            if (ImGui::MenuItem("Export COCO", nullptr, false, !this->scanning_flag))
+            {
+                this->export_coco_flag = true;
+            }
+            if (ImGui::MenuItem("Export Pascal VOC", nullptr, false, !this->voc.running() && !this->scanning_flag))
+            {
+                this->export_voc_flag = true;
+            }
+            if (ImGui::MenuItem("Export TFRecord", nullptr, false, !this->tfrecord.running() && !this->scanning_flag))
+            {
+                this->export_tfrecord_flag = true;
+            }
+            if (ImGui::MenuItem("One file per image", nullptr, this->sharded_flag))
+            {
+                this->set_sharded(!this->sharded_flag);
+            }
+            if (ImGui::MenuItem("YOLO label sync", nullptr, this->yolo_flag))
+            {
+                this->set_yolo(!this->yolo_flag);
+            }
+            ImGui::Separator();
+            if (ImGui::MenuItem("Batched overlays", nullptr, this->batched_overlay_flag))
+            {
+                this->batched_overlay_flag = !this->batched_overlay_flag;
+            }
+            ImGui::TextDisabled("%ld instances : %ld vertices, %.1f KB per frame", this->overlay_stats.instances, this->overlay_stats.vertices, this->overlay_stats.bytes / 1024.0);
             ImGui::EndMenu();
         }
         ImGui::EndMenuBar();
@@ -189,7 +306,83 @@ void AnnotationApp::ui_main_window(void)
         }
     }
 
-    this->ui_annotations_panel();
+    if (this->import_coco_flag == true)
+    {
+        ImGuiFileDialog::Instance()->OpenDialog("COCOReadChooser", "Choose a COCO file", ".json", ".", ImGuiFileDialogFlags_Modal);
+        if (ImGuiFileDialog::Instance()->Display("COCOReadChooser"))
+        {
+            if (ImGuiFileDialog::Instance()->IsOk())
+            {
+                this->import_coco(ImGuiFileDialog::Instance()->GetFilePathName());
+            }
+
+            // close
+            ImGuiFileDialog::Instance()->Close();
+            this->import_coco_flag = false;
+        }
+    }
+
+    if (this->export_coco_flag == true)
+    {
+        ImGuiFileDialog::Instance()->OpenDialog("COCOWriteChooser", "Set a COCO file name", ".json", ".", ImGuiFileDialogFlags_Modal);
+        if (ImGuiFileDialog::Instance()->Display("COCOWriteChooser"))
+        {
+            if (ImGuiFileDialog::Instance()->IsOk())
+            {
+                coco_export(ImGuiFileDialog::Instance()->GetFilePathName(), this->images_folder, this->image_files, this->annotations, this->annotations_scale);
+            }
+
+            // close
+            ImGuiFileDialog::Instance()->Close();
+            this->export_coco_flag = false;
+        }
+    }
+
+    if (this->export_voc_flag == true)
+    {
+        ImGuiFileDialog::Instance()->OpenDialog("VOCFolderChooser", "Choose the output directory", nullptr, ".", ImGuiFileDialogFlags_Modal);
+        if (ImGuiFileDialog::Instance()->Display("VOCFolderChooser"))
+        {
+            if (ImGuiFileDialog::Instance()->IsOk())
+            {
+                std::vector<image_boxes_t> images = this->snapshot_boxes(nullptr);
+                std::vector<std::string> classes;
+                for (auto &annotation : this->annotations)
+                    classes.push_back(annotation.label);
+                this->voc.start(this->pool, ImGuiFileDialog::Instance()->GetCurrentPath(), this->images_folder, images, classes);
+            }
+
+            // close
+            ImGuiFileDialog::Instance()->Close();
+            this->export_voc_flag = false;
+        }
+    }
+
+    if (this->export_tfrecord_flag == true)
+    {
+        ImGuiFileDialog::Instance()->OpenDialog("TFRecordFolderChooser", "Choose the output directory", nullptr, ".", ImGuiFileDialogFlags_Modal);
+        if (ImGuiFileDialog::Instance()->Display("TFRecordFolderChooser"))
+        {
+            if (ImGuiFileDialog::Instance()->IsOk())
+            {
+                std::vector<image_boxes_t> images = this->snapshot_boxes(nullptr);
+                std::vector<std::string> classes;
+                for (auto &annotation : this->annotations)
+                    classes.push_back(annotation.label);
+                this->tfrecord.start(ImGuiFileDialog::Instance()->GetCurrentPath(), this->images_folder, images, classes);
+            }
+
+            // close
+            ImGuiFileDialog::Instance()->Close();
+            this->export_tfrecord_flag = false;
+        }
+    }
+
+    {
+        FrameTimer timer(PHASE_ANNOTATIONS_PANEL);
+        this->ui_annotations_panel();
+    }
+    this->ui_array_panel();
 
     ImGui::EndChild();
 
@@ -197,7 +390,13 @@ void AnnotationApp::ui_main_window(void)
 
     ImGui::BeginChild("Pane1", ImVec2(-1.f, -1.f), false, ImGuiWindowFlags_AlwaysAutoResize);
 
-    this->ui_image_current();
+    {
+        FrameTimer timer(PHASE_IMAGE_CURRENT);
+        if (this->grid_flag)
+            this->ui_thumbnail_grid();
+        else
+            this->ui_image_current();
+    }
 
     ImGui::EndChild();
 
@@ -281,6 +480,7 @@ void AnnotationApp::ui_annotations_panel(void)
             if (ImGui::ColorEdit4(_unused_ids, this->annotations[n].color, ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoLabel))
             {
                 update_json_flag = true;
+                this->dirty_labels = true;
                 this->annotations[n].update_color();
             }
 
@@ -293,6 +493,7 @@ void AnnotationApp::ui_annotations_panel(void)
             {
                 this->annotations[n].label = this->annotations[n].new_label; // basic recopy for now
                 spdlog::debug("[label {}] new label : {}", n, this->annotations[n].label);
+                this->mark_label_dirty(n);
                 update_json_flag = true;
             }
             ImGui::PopItemWidth();
@@ -304,6 +505,7 @@ void AnnotationApp::ui_annotations_panel(void)
             if (ImGui::Combo(_unused_ids, (int *)&this->annotations[n].type, "POINT\0AREA"))
             {
                 spdlog::debug("[label {}] new type : {}", n, this->annotations[n].type);
+                this->mark_label_dirty(n);
                 update_json_flag = true;
             }
             ImGui::PopItemWidth();
@@ -312,8 +514,19 @@ void AnnotationApp::ui_annotations_panel(void)
             sprintf(_unused_ids, ICON_FA_MINUS_CIRCLE "##delbuttont%ld", n);
             if (ImGui::Button(_unused_ids))
             {
+                // the following labels are shifted, so are their class indices
+                for (long unsigned int k = n; k < this->annotations.size(); k++)
+                    this->mark_label_dirty(k);
                 this->annotations.erase(this->annotations.begin() + n);
                 update_json_flag = true;
+
+                // so are the labels of the filter
+                if (this->filter.mode == FILTER_LABEL && this->filter.label == (int)n)
+                    this->filter.mode = FILTER_ALL;
+                else if (this->filter.mode == FILTER_LABEL && this->filter.label > (int)n)
+                    this->filter.label--;
+                this->filter_rebuild_flag = true;
+                this->view_dirty = true;
             }
         }
         ImGui::EndTable();
@@ -323,6 +536,7 @@ void AnnotationApp::ui_annotations_panel(void)
     if (ImGui::Button(ICON_FA_PLUS_CIRCLE "  Create new label"))
     {
         this->annotations.push_back(Annotation("new label"));
+        this->dirty_labels = true;
         update_json_flag = true;
     }
 
@@ -374,6 +588,8 @@ void AnnotationApp::ui_annotations_panel(void)
                     sprintf(_unused_ids, ICON_FA_MINUS_CIRCLE "##delbuttontinst%ldx%ld", n, m);
                     if (ImGui::Button(_unused_ids))
                     {
+                        this->mark_image_dirty(this->annotations[n].inst[m].img_fname);
+                        this->index_instance(n, this->annotations[n].inst[m].img_fname, false);
                         this->annotations[n].inst.erase(this->annotations[n].inst.begin() + m);
                         update_json_flag = true;
                     }
@@ -384,14 +600,56 @@ void AnnotationApp::ui_annotations_panel(void)
         ImGui::EndTable();
     }
 
+    if (this->voc.running())
+    {
+        char _overlay[64];
+        sprintf(_overlay, "VOC export %ld / %ld", this->voc.done(), this->voc.total());
+        ImGui::ProgressBar((float)this->voc.done() / this->voc.total(), ImVec2(-1, 0), _overlay);
+    }
+    else if (this->voc.failed() > 0)
+    {
+        // a partial export must not look like a complete one
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), ICON_FA_EXCLAMATION_TRIANGLE " VOC export : %ld of %ld images failed", this->voc.failed(), this->voc.total());
+    }
+    else if (this->voc.total() > 0)
+    {
+        ImGui::Text(ICON_FA_CHECK " VOC export : %ld files written", this->voc.total());
+    }
+
+    if (this->tfrecord.running())
+    {
+        char _overlay[64];
+        sprintf(_overlay, "TFRecord export %ld / %ld", this->tfrecord.done(), this->tfrecord.total());
+        ImGui::ProgressBar((float)this->tfrecord.done() / std::max(1L, this->tfrecord.total()), ImVec2(-1, 0), _overlay);
+    }
+    else if (this->tfrecord.failed() > 0)
+    {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), ICON_FA_EXCLAMATION_TRIANGLE " TFRecord export : %ld of %ld images failed", this->tfrecord.failed(), this->tfrecord.total());
+    }
+    else if (this->tfrecord.total() > 0)
+    {
+        ImGui::Text(ICON_FA_CHECK " TFRecord export : %ld images written", this->tfrecord.total());
+    }
+    if (!this->tfrecord.running() && (this->tfrecord.skipped() > 0))
+        ImGui::TextDisabled("TFRecord export : %ld video frames and arrays skipped", this->tfrecord.skipped());
+
+    if (this->yolo_flag)
+    {
+        if (this->yolo.busy())
+            ImGui::Text(ICON_FA_REFRESH " YOLO labels : syncing...");
+        else
+            ImGui::Text(ICON_FA_CHECK " YOLO labels : up to date (%ld written)", this->yolo.files_written());
+    }
+
     if (update_json_flag == true)
     {
-        this->json_write(this->temp_annotation_fname);
+        this->save_annotations();
     }
 }
 
 void AnnotationApp::json_write(std::string fname)
 {
+    FrameTimer timer(PHASE_JSON);
     spdlog::debug("Writing json file : {}", fname.c_str());
 
     // check if the annotation file exists, create it if needed
@@ -423,10 +681,10 @@ void AnnotationApp::json_write(std::string fname)
             json_data[this->annotations[n].label.c_str()]["instances"].push_back(
                 nlohmann::json::object({
                     {"file", this->annotations[n].inst[m].img_fname.c_str()},                                       // file
-                    {"x_start", this->annotations[n].inst[m].rect_on_image.get_topleft_vertex().x / this->scale},   // x start coordinates
-                    {"y_start", this->annotations[n].inst[m].rect_on_image.get_topleft_vertex().y / this->scale},   // y start coordinates
-                    {"x_end", this->annotations[n].inst[m].rect_on_image.get_bottomright_vertex().x / this->scale}, // x end coordinates
-                    {"y_end", this->annotations[n].inst[m].rect_on_image.get_bottomright_vertex().y / this->scale}  // y end coordinates
+                    {"x_start", this->annotations[n].inst[m].rect_on_image.get_topleft_vertex().x / this->annotations_scale},   // x start coordinates
+                    {"y_start", this->annotations[n].inst[m].rect_on_image.get_topleft_vertex().y / this->annotations_scale},   // y start coordinates
+                    {"x_end", this->annotations[n].inst[m].rect_on_image.get_bottomright_vertex().x / this->annotations_scale}, // x end coordinates
+                    {"y_end", this->annotations[n].inst[m].rect_on_image.get_bottomright_vertex().y / this->annotations_scale}  // y end coordinates
                 }));
 
             this->ninstperimage[this->annotations[n].inst[m].img_fname] = this->ninstperimage[this->annotations[n].inst[m].img_fname] + 1;
@@ -440,6 +698,7 @@ void AnnotationApp::json_write(std::string fname)
 
 void AnnotationApp::json_read(std::string file)
 {
+    FrameTimer timer(PHASE_JSON);
     spdlog::debug("Parsing json file : {}", file.c_str());
 
     // check if the annotation file exists
@@ -450,9 +709,10 @@ void AnnotationApp::json_read(std::string file)
     std::ifstream f(file.c_str());
     this->json = nlohmann::json::parse(f);
 
-    // empty list of annotations
+    // empty list of annotations, read at the display scale (pixels until the scale of an image is known)
     this->annotations.clear();
     this->ninstperimage.clear();
+    this->annotations_scale = (this->scale > 0.0f) ? this->scale : 1.0f;
 
     // extract annotations
     for (nlohmann::json::iterator i = json.begin(); i != json.end(); ++i)
@@ -505,10 +765,10 @@ void AnnotationApp::json_read(std::string file)
                 this->ninstperimage[_inst.img_fname] = this->ninstperimage[_inst.img_fname] + 1;
 
                 // retrieve corner positions of the instance
-                float x_start = val["x_start"].get<float>() * this->scale;
-                float y_start = val["y_start"].get<float>() * this->scale;
-                float x_end = val["x_end"].get<float>() * this->scale;
-                float y_end = val["y_end"].get<float>() * this->scale;
+                float x_start = val["x_start"].get<float>() * this->annotations_scale;
+                float y_start = val["y_start"].get<float>() * this->annotations_scale;
+                float x_end = val["x_end"].get<float>() * this->annotations_scale;
+                float y_end = val["y_end"].get<float>() * this->annotations_scale;
 
                 // spdlog::debug("[{}, {}, {}, {}] * {}", x_start, y_start, x_end, y_end, this->scale);
 
@@ -529,13 +789,14 @@ void AnnotationApp::json_read(std::string file)
             }
         }
     }
+
+    // instances were replaced
+    this->filter_rebuild_flag = true;
+    this->view_dirty = true;
 }
 
 void AnnotationApp::ui_images_folder(void)
 {
-    int n = 0;
-    static int selected = -1;
-
     static ImGuiTableFlags flags = ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV | ImGuiTableFlags_ContextMenuInBody;
 
     if (ImGui::Button(ICON_FA_FOLDER_OPEN " Load Folder", ImVec2(-1, 50)))
@@ -543,50 +804,286 @@ void AnnotationApp::ui_images_folder(void)
         this->open_images_folder_flag = true;
     }
 
-    if (ImGui::BeginTable("table_images", 2, flags))
+    // before the merge : the scroll is set once the whole list was drawn
+    if (this->pending_session_flag)
+        this->apply_session();
+
+    if (this->scanning_flag)
+    {
+        this->merge_scanned_files();
+        ImGui::Text(ICON_FA_REFRESH " Scanning... %ld images", this->scanner.found());
+    }
+    else if (this->watcher.running())
+    {
+        this->apply_watch_events();
+    }
+
+    this->duplicates.poll();
+    if (this->duplicates.running())
+    {
+        long done, total;
+        this->duplicates.progress(&done, &total);
+        ImGui::Text(ICON_FA_CLONE " Looking for duplicates... %ld / %ld images", done, total);
+    }
+
+    if (!this->unsupported_files.empty())
+    {
+        char _title[64];
+        sprintf(_title, ICON_FA_EXCLAMATION_TRIANGLE " %ld files cannot be read###unsupported", (long)this->unsupported_files.size());
+        if (ImGui::TreeNode(_title))
+        {
+            ImGuiListClipper clipper;
+            clipper.Begin(this->unsupported_files.size());
+            while (clipper.Step())
+            {
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+                    ImGui::Text("%s (%s)", this->unsupported_files[row].first.c_str(), this->unsupported_files[row].second.c_str());
+            }
+            ImGui::TreePop();
+        }
+    }
+
+    this->ui_filter_bar();
+    bool custom_view = this->view_active();
+
+    if (ImGui::BeginTable("table_images", 3, flags))
     {
         ImGui::TableSetupColumn(ICON_FA_STICKY_NOTE, ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn(ICON_FA_CLONE, ImGuiTableColumnFlags_WidthFixed);
         ImGui::TableSetupColumn(ICON_FA_PICTURE_O "  Pictures", ImGuiTableColumnFlags_WidthStretch);
         ImGui::TableHeadersRow();
 
-        for (auto e : this->image_files)
+        // only the visible rows are submitted, whatever the size of the folder
+        ImGuiListClipper clipper;
+        clipper.Begin(custom_view ? this->view_rows.size() : this->image_files.size());
+        while (clipper.Step())
         {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+            {
+                const std::string &e = this->image_files[custom_view ? this->view_rows[row] : row];
+
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                auto count = this->ninstperimage.find(e);
+                ImGui::Text("%d", (count == this->ninstperimage.end()) ? 0 : count->second);
+
+                // cluster of duplicates : red when identical, orange when similar
+                ImGui::TableSetColumnIndex(1);
+                duplicate_cluster_t cluster;
+                int c = this->duplicates.cluster(e, &cluster);
+                if (c > 0)
+                {
+                    ImGui::TextColored(cluster.exact ? ImVec4(1.0f, 0.4f, 0.4f, 1.0f) : ImVec4(1.0f, 0.7f, 0.3f, 1.0f), "%d", c);
+                    if (ImGui::IsItemHovered())
+                        ImGui::SetTooltip("%s %u other images", cluster.exact ? "Identical to" : "Similar to", cluster.size - 1);
+                }
 
-            ImGui::TableNextRow();
-            ImGui::TableSetColumnIndex(0);
-            ImGui::Text("%d", this->ninstperimage[e]);
+                // single selectable to display filenames, its id is the file name : rows keep their state when the list changes
+                ImGui::TableSetColumnIndex(2);
+                if (ImGui::Selectable(e.c_str(), e == this->image_fname))
+                    this->open_image(e);
+            }
+        }
 
-            // single selectable to display filenames
-            ImGui::TableSetColumnIndex(1);
-            if (ImGui::Selectable(e.c_str(), selected == n))
-            {
-                selected = n;
+        ImGui::EndTable();
+    }
 
-                // create full filename
-                // todo : use boost lib
-                std::string fn = this->images_folder + "/" + e;
-                spdlog::debug("Loading image in RAM : {}", fn);
+    // saved with the session
+    this->list_scroll = ImGui::GetScrollY();
+}
 
-                // current_image_texture = 0;
-                current_image_width = 0;
-                current_image_height = 0;
-                current_image_texture = 0;
-                bool ret = this->read_image(fn.c_str(), &current_image_texture, &current_image_width, &current_image_height);
-                IM_ASSERT(ret);
+void AnnotationApp::open_image(const std::string &fname)
+{
+    // create full filename
+    // todo : use boost lib
+    std::string fn = this->images_folder + "/" + fname;
+    spdlog::debug("Loading image in RAM : {}", fn);
+
+    // current_image_texture = 0;
+    current_image_width = 0;
+    current_image_height = 0;
+    current_image_texture = 0;
+    this->image_error.clear();
+    this->open_time = startup_elapsed();
+    if (!this->read_image(fn.c_str(), &current_image_texture, &current_image_width, &current_image_height))
+    {
+        // gone since the scan, truncated or not decodable : shown as an error, the session can still be restored
+        spdlog::error("Cannot read {}", fn.c_str());
+        this->image_failed(fname);
+        this->minimap_dirty = true;
+        return;
+    }
+    this->first_pixel_flag = true;
+    if (this->loading_fname.empty())
+        this->display_times.full = startup_elapsed() - this->open_time;
+
+    this->scale = 0.0;
+    this->image_fname = fname;
+    this->compute_scale_flag = true;
+    this->minimap_dirty = true;
+    this->reset_view();
+}
 
-                this->scale = 0.0;
-                this->image_fname = e;
-                this->compute_scale_flag = true;
-            }
-            n++;
+// images decoded by stb_image (arrays and video frames are mapped)
+static bool decoded_image(const std::string &fname)
+{
+    std::string video;
+    long frame;
+    return !video_frame_of(fname, &video, &frame) && !ArraySource::handles(fname);
+}
+
+void AnnotationApp::restore_session(void)
+{
+    session_t session;
+    if (!session_load(session_path(), session) || session.folder.empty())
+        return;
+    if (!file_exists(session.folder))
+    {
+        spdlog::info("The folder of the last session is gone : {}", session.folder.c_str());
+        return;
+    }
+    spdlog::info("Restoring the session of {}", session.folder.c_str());
+
+    // the annotations are read at once, the list is scanned in the background (from the manifest of the folder)
+    this->startup_flag = false;
+    this->parse_images_folder(session.folder);
+
+    // the image and its nearest neighbours are decoded during the scan, the next ones read into the page cache
+    if (!session.image.empty())
+    {
+        std::string fn = session.folder + "/" + session.image;
+        if (decoded_image(fn))
+            this->decode_ahead.request(this->pool, fn);
+    }
+    for (size_t n = 0; n < session.neighbours.size(); n++)
+    {
+        std::string fn = session.folder + "/" + session.neighbours[n];
+        if ((n < DECODED_NEIGHBOURS) && decoded_image(fn))
+            this->decode_ahead.request(this->pool, fn);
+        else
+            this->pool.submit([fn]()
+                              { prefetch_file(fn); });
+    }
+
+    this->pending_session = session;
+    this->pending_session_flag = true;
+}
+
+void AnnotationApp::apply_session(void)
+{
+    session_t &session = this->pending_session;
+
+    // the image as soon as the scan lists it, then the view saved over it
+    if (!session.image.empty())
+    {
+        if (std::binary_search(this->image_files.begin(), this->image_files.end(), session.image))
+        {
+            this->open_image(session.image);
+            this->zoom = std::min(ZOOM_MAX, std::max(ZOOM_MIN, session.zoom));
+            this->pan = vec2f(session.pan_x, session.pan_y);
+            session.image.clear();
+        }
+        else if (!this->scanning_flag)
+        {
+            spdlog::info("The image of the last session is gone : {}", session.image.c_str());
+            session.image.clear();
         }
+    }
 
-        ImGui::EndTable();
+    // the label once the annotations were read for the scale of the image
+    if (!session.label.empty() && session.image.empty() && ((this->current_image_texture == 0) || !this->compute_scale_flag))
+    {
+        for (long unsigned int n = 0; n < this->annotations.size(); n++)
+        {
+            if (this->annotations[n].label == session.label)
+                this->activate_annotation(n);
+        }
+        session.label.clear();
+    }
+
+    // the scroll once the whole list was drawn
+    if (!this->scanning_flag)
+    {
+        ImGui::SetScrollY(session.scroll);
+        session.scroll = 0.0f;
+    }
+
+    this->pending_session_flag = !session.image.empty() || !session.label.empty() || this->scanning_flag;
+}
+
+void AnnotationApp::release_gl(void)
+{
+    // the members are destroyed after the context : their GL objects are deleted now
+    this->mipmaps.cancel();
+    this->overlay.release();
+    this->grid.release();
+    this->array_view.release();
+    if (this->image_texture != 0)
+    {
+        glDeleteTextures(1, &this->image_texture);
+        this->image_texture = 0;
+    }
+    this->current_image_texture = 0;
+}
+
+void AnnotationApp::save_session(void)
+{
+    // nothing was shown yet : the session restored is kept as it is
+    if (this->pending_session_flag)
+    {
+        session_save(session_path(), this->pending_session);
+        return;
+    }
+
+    session_t session;
+    session_clear(session);
+    session.folder = this->images_folder;
+    session.image = this->image_fname;
+    session.zoom = this->zoom;
+    session.pan_x = this->pan.x;
+    session.pan_y = this->pan.y;
+    session.scroll = this->list_scroll;
+    for (auto &annotation : this->annotations)
+    {
+        if (annotation.selected)
+            session.label = annotation.label;
+    }
+
+    // neighbours in the list as shown, nearest first
+    bool custom_view = this->view_active();
+    long rows = custom_view ? this->view_rows.size() : this->image_files.size();
+    long position = -1;
+    for (long row = 0; (row < rows) && (position < 0) && !session.image.empty(); row++)
+    {
+        if (this->image_files[custom_view ? this->view_rows[row] : row] == session.image)
+            position = row;
     }
+    for (long d = 1; (position >= 0) && (d <= SESSION_NEIGHBOURS); d++)
+    {
+        if (position + d < rows)
+            session.neighbours.push_back(this->image_files[custom_view ? this->view_rows[position + d] : position + d]);
+        if (position - d >= 0)
+            session.neighbours.push_back(this->image_files[custom_view ? this->view_rows[position - d] : position - d]);
+    }
+
+    if (session_save(session_path(), session))
+        spdlog::debug("Session saved in {}", session_path().c_str());
 }
 
 void AnnotationApp::ui_image_current()
 {
+    // full resolution decoded in the background
+    this->poll_image();
+
+    // levels of the texture built in the background, one of them kept as the thumbnail of the image
+    if (this->mipmaps.poll())
+    {
+        std::vector<unsigned char> pixels;
+        int width, height;
+        if (this->mipmaps.take_thumbnail(pixels, &width, &height))
+            this->thumbnails.put(this->images_folder + "/" + this->image_fname, width, height, pixels);
+    }
+
     if (this->current_image_texture != 0)
     {
         // ImGui::Text("pointer = %p", current_image_texture);
@@ -604,12 +1101,35 @@ void AnnotationApp::ui_image_current()
             this->scale = std::min(ImGui::GetWindowWidth() / current_image_width, ImGui::GetWindowHeight() / current_image_height);
             spdlog::debug("Resizing factor : {}", this->scale);
 
+            // the instances are resized or read again
+            this->minimap_dirty = true;
+            this->grid_boxes_dirty = true;
+
             // save view size
             this->img_view.x = view.x;
             this->img_view.y = view.y;
 
             // parse json once the scale is obtained
-            this->json_read(this->temp_annotation_fname);
+            // (with one file per image, or without a file to read, the instances in memory are resized)
+            if (!std::isfinite(this->scale) || (this->scale <= 0.0f))
+            {
+                // empty image : the instances keep their scale until a real one is known
+                spdlog::warn("Cannot fit an image of {} x {} pixels", current_image_width, current_image_height);
+            }
+            else if (this->sharded_flag || !this->annotations_file_exists)
+            {
+                float ratio = this->scale / this->annotations_scale;
+                for (auto &annotation : this->annotations)
+                {
+                    for (auto &instance : annotation.inst)
+                        instance.rescale(ratio);
+                }
+                this->annotations_scale = this->scale;
+            }
+            else
+            {
+                this->json_read(this->temp_annotation_fname);
+            }
         }
 
         if ((view.x != this->img_view.x) || (view.y != this->img_view.y))
@@ -617,14 +1137,43 @@ void AnnotationApp::ui_image_current()
             this->compute_scale_flag = true;
         }
 
-        // draw image
-        ImGui::Image(
-            (void *)(intptr_t)this->current_image_texture,                     // image texture
-            ImVec2(current_image_width * scale, current_image_height * scale), // x and y dimensions (scaled)
-            ImVec2(0.0f, 0.0f),                                                // (x,y) coordinates start in [0.0, 1.0]
-            ImVec2(1.0f, 1.0f)                                                 // (x,y) coordinates end in [0.0, 1.0]
+        this->update_view();
+        vec2f _m = ImGui::GetMousePos();
+        vec2f image_size = vec2f(current_image_width, current_image_height) * (this->scale * this->zoom);
+        vec2f image_end = this->view_origin + image_size;
+        bool image_hovered = ImGui::IsWindowHovered() && (_m.x >= this->view_origin.x) && (_m.y >= this->view_origin.y) && (_m.x < image_end.x) && (_m.y < image_end.y);
+
+        // draw image (arrays and video frames are converted by their own shader), clipped by the panel
+        ImDrawList *draw_list = ImGui::GetWindowDrawList();
+        if (this->array_flag || this->video_flag)
+            this->array_view.begin(draw_list);
+        draw_list->AddImage(
+            (void *)(intptr_t)this->current_image_texture, // image texture
+            this->view_origin,                             // top left corner on screen
+            image_end,                                     // bottom right corner on screen (scaled and zoomed)
+            ImVec2(0.0f, 0.0f),                            // (x,y) coordinates start in [0.0, 1.0]
+            ImVec2(1.0f, 1.0f)                             // (x,y) coordinates end in [0.0, 1.0]
         );
+        if (this->array_flag || this->video_flag)
+            this->array_view.end(draw_list);
 
+        // time to first pixel : the first frame with the thumbnail or the full image
+        if (this->first_pixel_flag && !this->placeholder_flag)
+        {
+            this->first_pixel_flag = false;
+            this->display_times.first_pixel = startup_elapsed() - this->open_time;
+            this->display_times.from_thumbnail = !this->loading_fname.empty();
+            this->display_times.first_pixel_sum += this->display_times.first_pixel;
+            this->display_times.count++;
+            spdlog::debug("{} : first pixel in {:.1f} ms", this->image_fname.c_str(), this->display_times.first_pixel);
+        }
+
+        // instances of the image : batched in one instanced draw, or added to the draw list one by one
+        bool batched = this->batched_overlay_flag && this->overlay.available();
+        this->overlay.clear(draw_list->GetClipRectMin(), draw_list->GetClipRectMax());
+        int vtx_start = draw_list->VtxBuffer.Size;
+        int idx_start = draw_list->IdxBuffer.Size;
+        long count = 0;
         for (long unsigned n = 0; n < this->annotations.size(); n++)
         {
             // draw all annotations instances on the image
@@ -635,77 +1184,366 @@ void AnnotationApp::ui_image_current()
                     // update and draw on screen
                     if (this->annotations[n].type == ANNOTATION_TYPE_AREA)
                     {
-                        this->annotations[n].inst[m].update_area();
-                        this->annotations[n].inst[m].draw_area();
+                        this->annotations[n].inst[m].update_area(this->view_origin, this->zoom);
+                        if (batched)
+                            this->annotations[n].inst[m].overlay_area(this->overlay);
+                        else
+                            this->annotations[n].inst[m].draw_area();
                     }
                     else
                     {
-                        this->annotations[n].inst[m].update_point();
-                        this->annotations[n].inst[m].draw_point();
+                        this->annotations[n].inst[m].update_point(this->view_origin, this->zoom);
+                        if (batched)
+                            this->annotations[n].inst[m].overlay_point(this->overlay);
+                        else
+                            this->annotations[n].inst[m].draw_point();
                     }
+                    count++;
                 }
             }
         }
+        if (batched)
+            this->overlay.draw(draw_list);
+
+        // traffic of the overlays, shown in the menu to compare both paths
+        this->overlay_stats.instances = count;
+        this->overlay_stats.vertices = draw_list->VtxBuffer.Size - vtx_start;
+        if (batched)
+            this->overlay_stats.bytes = (long)(this->overlay.size() * sizeof(overlay_instance_t));
+        else
+            this->overlay_stats.bytes = (long)(this->overlay_stats.vertices * sizeof(ImDrawVert) + (draw_list->IdxBuffer.Size - idx_start) * sizeof(ImDrawIdx));
+
+        if (this->zoom != 1.0f)
+        {
+            vec2f text_pos = ImGui::GetWindowPos();
+            text_pos += 8.0;
+            draw_list->AddText(text_pos, IM_COL32(255, 255, 255, 200), fmt::format("x{:.2f}", this->zoom).c_str());
+        }
+
+        // overview over the image, the clicks on it are not for the instances
+        bool minimap_used = this->minimap_flag && this->ui_minimap(draw_list, image_size);
 
         // fsm to handle drawing annotations
-        if (ImGui::IsItemHovered())
+        if (image_hovered && !minimap_used)
+        {
+            FrameTimer timer(PHASE_ANNOTATION_FSM);
             this->update_annotation_fsm();
+        }
+    }
+    else if (!this->image_error.empty())
+    {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), ICON_FA_EXCLAMATION_TRIANGLE " Cannot read %s", this->image_error.c_str());
     }
 }
 
-void AnnotationApp::update_annotation_fsm(void)
+void AnnotationApp::update_view(void)
 {
+    ImGuiIO &io = ImGui::GetIO();
     vec2f _w = ImGui::GetWindowPos();
     vec2f _m = ImGui::GetMousePos();
-    vec2f cursor_pos = _m - _w;
+    bool hovered = ImGui::IsWindowHovered();
 
-    bool create_new_instance_flag = true; // if true, will create a new instance of the active annotation
-    bool create_state_flag = false;       // if true, fsm is creating and rendering the annotation instance
-    int active_annotation = -1;           // track the id of the active annotation
-    int active_instance = -1;             // track the id of the active instance
-    bool need_json_write = false;
+    // wheel : zoom around the cursor, the point of the image under it stays in place
+    if (hovered && (io.MouseWheel != 0.0f))
+    {
+        float zoom = std::min(ZOOM_MAX, std::max(ZOOM_MIN, this->zoom * std::pow(ZOOM_STEP, io.MouseWheel)));
+        vec2f origin = _w + this->pan;
+        vec2f on_image = (_m - origin) * (zoom / this->zoom);
+        this->pan = _m - on_image;
+        this->pan -= _w;
+        this->zoom = zoom;
+    }
 
-    for (long unsigned n = 0; n < this->annotations.size(); n++)
+    // middle or right button dragged : pan, until the button is released even out of the panel
+    if (hovered && (ImGui::IsMouseClicked(ImGuiMouseButton_Middle) || ImGui::IsMouseClicked(ImGuiMouseButton_Right)))
+        this->panning_flag = true;
+    if (this->panning_flag)
     {
-        // parse all states and instances to define the next FSM action
-        for (long unsigned m = 0; m < this->annotations[n].inst.size(); m++)
-        {
-            if (this->annotations[n].inst[m].status_fsm.state() != StatusStates::IDLE)
-            {
-                create_new_instance_flag = false;
-                create_state_flag = false;
-            }
+        vec2f delta = io.MouseDelta;
+        this->pan += delta;
+        if (!ImGui::IsMouseDown(ImGuiMouseButton_Middle) && !ImGui::IsMouseDown(ImGuiMouseButton_Right))
+            this->panning_flag = false;
+    }
 
-            if (this->annotations[n].inst[m].status_fsm.state() == StatusStates::CREATE)
-            {
-                create_new_instance_flag = false;
-                create_state_flag = true;
-                active_annotation = n;
-                active_instance = m;
-                continue;
-            }
+    // home or middle double click : back to the image fitted to the panel
+    if (hovered && (ImGui::IsKeyPressed(ImGuiKey_Home) || ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Middle)))
+        this->reset_view();
 
-            // delete annotation instance on DELETE
-            if ((this->annotations[n].inst[m].selected == true) && ImGui::IsKeyPressed(ImGuiKey_Delete))
-            {
-                this->annotations[n].inst.erase(this->annotations[n].inst.begin() + m);
-                this->annotations[n].inst[m].request_json_write = true;
-            }
+    this->view_origin = _w + this->pan;
+}
 
-            // order a json write
-            if (this->annotations[n].inst[m].request_json_write == true)
+bool AnnotationApp::ui_minimap(ImDrawList *draw_list, vec2f image_size)
+{
+    // density counted again only when the instances of the image changed
+    if (this->minimap_dirty)
+    {
+        std::vector<ImVec2> points;
+        vec2f fitted = vec2f(current_image_width, current_image_height) * this->scale;
+        for (auto &annotation : this->annotations)
+        {
+            for (auto &instance : annotation.inst)
             {
-                need_json_write = true;
-                this->annotations[n].inst[m].request_json_write = false;
+                if (instance.img_fname != this->image_fname)
+                    continue;
+                vec2f c = instance.rect_on_image.get_center();
+                points.push_back(ImVec2(c.x / std::max(1.0f, fitted.x), c.y / std::max(1.0f, fitted.y)));
             }
         }
+        this->minimap.set_density(points);
+        this->minimap_dirty = false;
     }
 
-    // creating a new annotation instance
-    if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && (create_new_instance_flag == true))
+    // part of the image in view : nothing to show when the whole image is
+    ImVec2 clip_min = draw_list->GetClipRectMin();
+    ImVec2 clip_max = draw_list->GetClipRectMax();
+    ImVec2 view_min(std::max(0.0f, (clip_min.x - this->view_origin.x) / image_size.x), std::max(0.0f, (clip_min.y - this->view_origin.y) / image_size.y));
+    ImVec2 view_max(std::min(1.0f, (clip_max.x - this->view_origin.x) / image_size.x), std::min(1.0f, (clip_max.y - this->view_origin.y) / image_size.y));
+    if ((view_min.x <= 0.0f) && (view_min.y <= 0.0f) && (view_max.x >= 1.0f) && (view_max.y >= 1.0f))
+        return false;
+
+    // the texture of the image, sampled from its small levels
+    ImVec2 min, max;
+    Minimap::layout(clip_min, clip_max, current_image_width, current_image_height, &min, &max);
+    draw_list->AddRectFilled(min, max, IM_COL32(30, 30, 30, 220));
+    if (this->array_flag || this->video_flag)
+        this->array_view.begin(draw_list);
+    draw_list->AddImage((void *)(intptr_t)this->current_image_texture, min, max);
+    if (this->array_flag || this->video_flag)
+        this->array_view.end(draw_list);
+
+    // the point clicked goes to the center of the panel
+    bool clicked = false;
+    ImVec2 target;
+    bool used = this->minimap.draw(draw_list, min, max, view_min, view_max, &clicked, &target);
+    if (clicked)
     {
-        for (long unsigned n = 0; n < this->annotations.size(); n++)
-        {
+        vec2f size = ImGui::GetWindowSize();
+        this->pan = vec2f(size.x * 0.5f - target.x * image_size.x, size.y * 0.5f - target.y * image_size.y);
+        this->panning_flag = false;
+    }
+    return used;
+}
+
+void AnnotationApp::ui_thumbnail_grid(void)
+{
+    // thumbnails computed once the folder is listed, the ones of the visible cells first
+    if (!this->scanning_flag && !this->images_folder.empty() && !this->thumbnail_atlas.started(this->images_folder))
+        this->thumbnail_atlas.start(this->pool, this->images_folder, this->scanner.listing());
+    this->thumbnail_atlas.poll();
+    if (this->thumbnail_atlas.running())
+    {
+        long done, total;
+        this->thumbnail_atlas.progress(&done, &total);
+        ImGui::Text("Thumbnails : %ld / %ld", done, total);
+    }
+
+    // instances of every image, in pixels : gathered again only after an edit
+    if (this->grid_boxes_dirty && (this->annotations_scale > 0.0f))
+    {
+        this->grid_boxes_dirty = false;
+        this->grid_boxes.clear();
+        for (long unsigned n = 0; n < this->annotations.size(); n++)
+        {
+            for (auto &instance : this->annotations[n].inst)
+            {
+                vec2f _tl = instance.rect_on_image.get_topleft_vertex() / this->annotations_scale;
+                vec2f _br = instance.rect_on_image.get_bottomright_vertex() / this->annotations_scale;
+                if (this->annotations[n].type != ANNOTATION_TYPE_AREA)
+                {
+                    // points : a single position
+                    _tl = instance.rect_on_image.get_center() / this->annotations_scale;
+                    _br = _tl;
+                }
+                this->grid_boxes[instance.img_fname].push_back(image_box_t{(int)n, _tl.x, _tl.y, _br.x, _br.y});
+            }
+        }
+    }
+
+    ImGui::BeginChild("ThumbnailGrid", ImVec2(-1.f, -1.f), false);
+    ImDrawList *draw_list = ImGui::GetWindowDrawList();
+
+    bool custom_view = this->view_active();
+    size_t count = custom_view ? this->view_rows.size() : this->image_files.size();
+    float cell = (float)THUMBNAIL_CELL;
+    int columns = std::max(1, (int)((ImGui::GetContentRegionAvail().x + GRID_SPACING) / (cell + GRID_SPACING)));
+    int rows = (int)((count + columns - 1) / columns);
+
+    // thumbnails on the first channel drawn by one instanced call, the instances and the frame of the selection on top
+    bool textured = this->grid.available();
+    bool batched = this->batched_overlay_flag && this->overlay.available();
+    this->grid.begin();
+    this->overlay.clear(draw_list->GetClipRectMin(), draw_list->GetClipRectMax());
+    this->grid_pending = false;
+    draw_list->ChannelsSplit(2);
+
+    ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(GRID_SPACING, GRID_SPACING));
+    int last_row = -1;
+    ImGuiListClipper clipper;
+    clipper.Begin(rows);
+    while (clipper.Step())
+    {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+        {
+            last_row = std::max(row, last_row);
+            for (int column = 0; column < columns; column++)
+            {
+                size_t k = (size_t)row * columns + column;
+                if (k >= count)
+                    break;
+                const std::string &e = this->image_files[custom_view ? this->view_rows[k] : k];
+
+                // the id of a cell is the file name, as in the list
+                if (column > 0)
+                    ImGui::SameLine();
+                if (ImGui::InvisibleButton(e.c_str(), ImVec2(cell, cell)))
+                {
+                    this->open_image(e);
+                    this->grid_flag = false;
+                }
+                if (ImGui::IsItemHovered())
+                    ImGui::SetTooltip("%s", e.c_str());
+                ImVec2 min = ImGui::GetItemRectMin();
+                ImVec2 max = ImGui::GetItemRectMax();
+
+                // thumbnail centred in its cell, uploaded to a layer when it comes into view
+                const thumbnail_record_t *record = this->thumbnail_atlas.find(e);
+                if (record == nullptr)
+                    this->thumbnail_atlas.want(e);
+                bool shown = false;
+                ImVec2 t_min, t_max;
+                if (textured && (record != nullptr) && (record->width > 0))
+                {
+                    t_min = ImVec2(min.x + (cell - record->width) * 0.5f, min.y + (cell - record->height) * 0.5f);
+                    t_max = ImVec2(t_min.x + record->width, t_min.y + record->height);
+                    draw_list->ChannelsSetCurrent(0);
+                    shown = this->grid.add(record->cell, this->thumbnail_atlas.pixels(record), record->width, record->height, t_min, t_max);
+                    this->grid_pending |= !shown;
+                }
+                if (!shown)
+                {
+                    // name of the image until its thumbnail is there (or for ever if it cannot be decoded)
+                    draw_list->ChannelsSetCurrent(0);
+                    draw_list->AddRectFilled(min, max, IM_COL32(60, 60, 60, 255));
+                    draw_list->PushClipRect(min, max, true);
+                    draw_list->AddText(ImVec2(min.x + 2.0f, min.y + 2.0f), IM_COL32(200, 200, 200, 255), e.c_str());
+                    draw_list->PopClipRect();
+                }
+
+                // instances at the scale of the thumbnail
+                draw_list->ChannelsSetCurrent(1);
+                auto boxes = this->grid_boxes.find(e);
+                if (shown && (boxes != this->grid_boxes.end()) && (record->image_width > 0))
+                {
+                    float ratio = (float)record->width / record->image_width;
+                    for (auto &box : boxes->second)
+                    {
+                        if (box.label >= (int)this->annotations.size())
+                            continue;
+                        uint8_t color[4];
+                        for (int c = 0; c < 4; c++)
+                            color[c] = (uint8_t)(this->annotations[box.label].color[c] * 255.0f);
+                        float x0 = t_min.x + box.x_start * ratio, y0 = t_min.y + box.y_start * ratio;
+                        float x1 = t_min.x + box.x_end * ratio, y1 = t_min.y + box.y_end * ratio;
+                        bool point = (box.x_start == box.x_end) && (box.y_start == box.y_end);
+                        if (batched && point)
+                            this->overlay.add_circle(x0, y0, 2.0f, color, 1.0f, 1.0f);
+                        else if (batched)
+                            this->overlay.add_box(x0, y0, x1, y1, color, 1.0f, 0.0f);
+                        else if (point)
+                            draw_list->AddCircleFilled(ImVec2(x0, y0), 2.0f, IM_COL32(color[0], color[1], color[2], color[3]));
+                        else
+                            draw_list->AddRect(ImVec2(x0, y0), ImVec2(x1, y1), IM_COL32(color[0], color[1], color[2], color[3]));
+                    }
+                }
+                if (e == this->image_fname)
+                    draw_list->AddRect(min, max, IM_COL32(255, 255, 255, 255), 0.0f, 0, 2.0f);
+            }
+        }
+    }
+    ImGui::PopStyleVar();
+
+    draw_list->ChannelsSetCurrent(0);
+    this->grid.draw(draw_list);
+    draw_list->ChannelsSetCurrent(1);
+    if (batched)
+        this->overlay.draw(draw_list);
+    draw_list->ChannelsMerge();
+
+    // cells of the next rows read from the cache ahead of the scroll
+    for (size_t k = (size_t)(last_row + 1) * columns; (k < (size_t)(last_row + 1 + GRID_PREFETCH_ROWS) * columns) && (k < count); k++)
+    {
+        const thumbnail_record_t *record = this->thumbnail_atlas.find(this->image_files[custom_view ? this->view_rows[k] : k]);
+        if (record != nullptr)
+            this->thumbnail_atlas.prefetch(record);
+    }
+
+    ImGui::EndChild();
+}
+
+void AnnotationApp::reset_view(void)
+{
+    this->zoom = 1.0f;
+    this->pan = vec2f(0.0f, 0.0f);
+    this->panning_flag = false;
+}
+
+void AnnotationApp::update_annotation_fsm(void)
+{
+    // cursor in the coordinates of the image fitted to the panel (those of rect_on_image)
+    vec2f _m = ImGui::GetMousePos();
+    vec2f cursor_pos = (_m - this->view_origin) / this->zoom;
+
+    bool create_new_instance_flag = true; // if true, will create a new instance of the active annotation
+    bool create_state_flag = false;       // if true, fsm is creating and rendering the annotation instance
+    int active_annotation = -1;           // track the id of the active annotation
+    int active_instance = -1;             // track the id of the active instance
+    bool need_json_write = false;
+
+    for (long unsigned n = 0; n < this->annotations.size(); n++)
+    {
+        // parse all states and instances to define the next FSM action
+        for (long unsigned m = 0; m < this->annotations[n].inst.size(); m++)
+        {
+            if (this->annotations[n].inst[m].status_fsm.state() != StatusStates::IDLE)
+            {
+                create_new_instance_flag = false;
+                create_state_flag = false;
+            }
+
+            if (this->annotations[n].inst[m].status_fsm.state() == StatusStates::CREATE)
+            {
+                create_new_instance_flag = false;
+                create_state_flag = true;
+                active_annotation = n;
+                active_instance = m;
+                continue;
+            }
+
+            // delete annotation instance on DELETE
+            if ((this->annotations[n].inst[m].selected == true) && ImGui::IsKeyPressed(ImGuiKey_Delete))
+            {
+                this->mark_image_dirty(this->annotations[n].inst[m].img_fname);
+                this->index_instance(n, this->annotations[n].inst[m].img_fname, false);
+                this->annotations[n].inst.erase(this->annotations[n].inst.begin() + m);
+                need_json_write = true;
+                break;
+            }
+
+            // order a json write
+            if (this->annotations[n].inst[m].request_json_write == true)
+            {
+                need_json_write = true;
+                this->mark_image_dirty(this->annotations[n].inst[m].img_fname);
+                this->annotations[n].inst[m].request_json_write = false;
+            }
+        }
+    }
+
+    // creating a new annotation instance
+    if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && (create_new_instance_flag == true))
+    {
+        for (long unsigned n = 0; n < this->annotations.size(); n++)
+        {
             if (this->annotations[n].selected)
             {
                 AnnotationInstance _ann;
@@ -715,6 +1553,7 @@ void AnnotationApp::update_annotation_fsm(void)
                 _ann.set_color(this->annotations[n].color);
 
                 this->annotations[n].inst.push_back(_ann);
+                this->index_instance(n, this->image_fname, true);
 
                 spdlog::info("New Annotation Instance <{}, type {}> on file {}: at position ({},{})",
                              this->annotations[n].label,
@@ -733,6 +1572,7 @@ void AnnotationApp::update_annotation_fsm(void)
         if (ImGui::IsKeyPressed(526))
         {
             spdlog::debug("CANCEL : destroying instance");
+            this->index_instance(active_annotation, this->image_fname, false);
             this->annotations[active_annotation].inst.erase(this->annotations[active_annotation].inst.begin() + active_instance);
         }
 
@@ -743,9 +1583,10 @@ void AnnotationApp::update_annotation_fsm(void)
             this->annotations[active_annotation].inst[active_instance].rect_on_image.set_center(cursor_pos);
             this->annotations[active_annotation].inst[active_instance].rect_on_image.set_span(vec2f(10, 10));
             this->annotations[active_annotation].inst[active_instance].status_fsm.execute("from_create_to_idle");
-            this->annotations[active_annotation].inst[active_instance].update_point();
+            this->annotations[active_annotation].inst[active_instance].update_point(this->view_origin, this->zoom);
             this->annotations[active_annotation].inst[active_instance].update_bounding_box();
 
+            this->mark_image_dirty(this->image_fname);
             need_json_write = true;
         }
         else
@@ -760,10 +1601,11 @@ void AnnotationApp::update_annotation_fsm(void)
                 this->annotations[active_annotation].inst[active_instance].status_fsm.execute("from_create_to_idle");
 
                 // update state (bounding box)
-                this->annotations[active_annotation].inst[active_instance].update_area();
+                this->annotations[active_annotation].inst[active_instance].update_area(this->view_origin, this->zoom);
                 this->annotations[active_annotation].inst[active_instance].update_bounding_box();
 
                 // request json update
+                this->mark_image_dirty(this->image_fname);
                 need_json_write = true;
             }
         }
@@ -771,7 +1613,13 @@ void AnnotationApp::update_annotation_fsm(void)
 
     // update json
     if (need_json_write == true)
-        this->json_write(this->temp_annotation_fname);
+        this->save_annotations();
+}
+
+bool AnnotationApp::animating(void)
+{
+    // progress shown on screen, the rest is drawn on events only
+    return this->scanning_flag || this->duplicates.running() || (this->grid_flag && (this->thumbnail_atlas.running() || this->grid_pending)) || this->voc.running() || this->tfrecord.running() || (this->yolo_flag && this->yolo.busy()) || this->orders.busy(this->sort_order);
 }
 
 void AnnotationApp::check_annotations_file(void)
@@ -783,82 +1631,146 @@ void AnnotationApp::check_annotations_file(void)
 
 void AnnotationApp::parse_images_folder(std::string path)
 {
-    DIR *dir;
-    struct dirent *diread;
-
-    // empty the list and do the search from scratch
+    // empty the list and do the search from scratch, the files are merged in the list as they are found
+    this->watcher.stop();
+    this->duplicates.cancel();
+    this->decode_ahead.clear();
+    this->loading_fname.clear();
+    this->thumbnails.clear();
+    this->thumbnail_atlas.cancel();
+    this->grid.reset();
+    this->grid_boxes_dirty = true;
+    this->pending_session_flag = false;
     this->image_files.clear();
+    this->image_ids.clear();
+    this->image_index.clear();
+    this->unsupported_files.clear();
+    this->orders.set_folder(path);
+    this->filter_rebuild_flag = true;
+    this->view_dirty = true;
+    this->scanner.start(this->pool, path, this->ext_set, path + "/.yacvat-manifest");
+    this->scanning_flag = true;
+    this->last_merge_time = 0.0;
 
-    if ((dir = opendir(path.c_str())) != nullptr)
-    {
-        spdlog::info("Browsing folder : {}", path.c_str());
-        while ((diread = readdir(dir)) != nullptr)
-        {
-            spdlog::debug("testing : {}", diread->d_name);
-
-            // filter images
-            if (!strcmp(diread->d_name, "."))
-                continue;
-            if (!strcmp(diread->d_name, ".."))
-                continue;
-            if (diread->d_name[0] == '.')
-                continue;
+    // memorizing the folder for later use
+    this->images_folder = path;
 
-            // add file to the list if the extension is allowed
-            std::string fn = diread->d_name;
-            std::string extension = fn.substr(fn.find_last_of(".") + 1);
+    // create the local annotation filename
+    this->temp_annotation_fname = path + "/.yacvat-temp.json";
+    spdlog::debug("Expected annotation file : {}", this->temp_annotation_fname.c_str());
 
-            spdlog::debug("extension : {}", extension);
+    // nothing to save from the previous folder
+    this->dirty_images.clear();
+    this->dirty_labels = false;
+    this->yolo_dirty_images.clear();
 
-            if (this->ext_set.find(extension) != this->ext_set.end())
-            {
-                // add image to the set
-                this->image_files.push_back(fn);
+    // read and parse the annotations : one file per image if the folder uses this layout, else the json file if it exists
+    this->shards.set_folder(path);
+    this->sharded_flag = this->shards.exists();
+    this->check_annotations_file();
+    if (this->sharded_flag)
+    {
+        spdlog::info("Using one annotation file per image");
+        FrameTimer timer(PHASE_JSON);
+        this->annotations_scale = (this->scale > 0.0f) ? this->scale : 1.0f;
+        this->shards.read(this->annotations, this->ninstperimage, this->annotations_scale);
+    }
+    else
+    {
+        this->json_read(this->temp_annotation_fname);
+    }
 
-                // create entry in dictionary counting instances
-                if (this->ninstperimage.find(fn) == this->ninstperimage.end())
-                {
-                    this->ninstperimage[fn] = 0;
-                }
+    // the YOLO sync of a folder already synced is resumed once the scan is done
+    this->yolo.set_folder(path);
+    this->yolo_flag = this->yolo.exists();
+}
 
-                // -- log
-                spdlog::info("File added : {}", diread->d_name);
+void AnnotationApp::merge_scanned_files(void)
+{
+    // read running first : once it is false every file found is in the batch
+    bool running = this->scanner.running();
+    size_t available = this->scanner.available();
+
+    // a merge moves the whole list : while the scan goes on, wait for a batch in proportion to the list or a few frames
+    double now = ImGui::GetTime();
+    bool large = available >= std::max((size_t)256, this->image_files.size() / 8);
+    if ((available > 0) && (!running || large || (now - this->last_merge_time > 0.25)))
+    {
+        std::vector<std::string> added, removed;
+        this->scanner.take(added, removed);
+
+        // the list of a manifest comes already sorted
+        if (!std::is_sorted(added.begin(), added.end()))
+            std::sort(added.begin(), added.end());
+        std::sort(removed.begin(), removed.end());
+
+        // merge of the two sorted lists, the ids follow their names (only the new names are looked up)
+        std::vector<std::string> files;
+        std::vector<uint32_t> ids;
+        files.reserve(this->image_files.size() + added.size());
+        ids.reserve(this->image_files.size() + added.size());
+        size_t a = 0;
+        for (size_t n = 0; n <= this->image_files.size(); n++)
+        {
+            while ((a < added.size()) && ((n == this->image_files.size()) || (added[a] < this->image_files[n])))
+            {
+                ids.push_back(this->image_index.id(added[a]));
+                files.push_back(std::move(added[a++]));
+            }
+            // a name already listed is taken from the batch on the next step
+            if ((n < this->image_files.size()) && ((a == added.size()) || (added[a] != this->image_files[n])))
+            {
+                ids.push_back(this->image_ids[n]);
+                files.push_back(std::move(this->image_files[n]));
             }
         }
 
-        // sort filenames alphabetically
-        std::sort(this->image_files.begin(), this->image_files.end(),
-                  [](const std::string &a, const std::string &b) -> bool
-                  { return a < b; });
+        // files of the manifest which are gone
+        if (!removed.empty())
+        {
+            size_t kept = 0;
+            for (size_t n = 0; n < files.size(); n++)
+            {
+                if (std::binary_search(removed.begin(), removed.end(), files[n]))
+                    continue;
+                ids[kept] = ids[n];
+                files[kept++] = std::move(files[n]);
+            }
+            files.resize(kept);
+            ids.resize(kept);
+        }
 
-        closedir(dir);
+        this->image_files.swap(files);
+        this->image_ids.swap(ids);
+        this->last_merge_time = now;
+        this->view_dirty = true;
+        this->orders.invalidate();
     }
-    else
+
+    if (!running && (this->scanner.available() == 0))
     {
-        spdlog::error("Folder {} cannot be open", path.c_str());
-    }
+        this->scanning_flag = false;
+        spdlog::info("{} images listed", this->image_files.size());
+        this->report_unsupported_files();
 
-    // memorizing the folder for later use
-    this->images_folder = path;
+        // hashes of the images not hashed yet, saved in the manifest
+        this->duplicates.start(this->pool, this->images_folder, this->scanner.listing(), this->images_folder + "/.yacvat-manifest", manifest_extensions_hash(this->ext_set));
 
-    // create the local annotation filename
-    this->temp_annotation_fname = path + "/.yacvat-temp.json";
-    spdlog::debug("Expected annotation file : {}", this->temp_annotation_fname.c_str());
+        // from now on the list follows the changes of the folder
+        std::vector<std::pair<std::string, int64_t>> folders;
+        this->scanner.folders(folders);
+        this->watcher.start(this->images_folder, this->ext_set, folders);
 
-    // read and parse json file if it exists
-    this->check_annotations_file();
-    this->json_read(this->temp_annotation_fname);
+        // resume the YOLO sync : only what changed in between is written
+        if (this->yolo_flag)
+            this->sync_yolo(true);
+    }
 }
 
-// Simple helper function to load an image into a OpenGL texture with common settings
-bool AnnotationApp::read_image(const char *filename, GLuint *out_texture, int *out_width, int *out_height)
+// rgba texture with the settings of the images
+static GLuint upload_rgba(const unsigned char *pixels, int width, int height)
 {
-    // Load from file
-    int image_width = 0;
-    int image_height = 0;
-    unsigned char *image_data = stbi_load(filename, &image_width, &image_height, NULL, 4);
-    if (image_data == NULL)
-        return false;
+    FrameTimer timer(PHASE_UPLOAD);
 
     // Create a OpenGL texture identifier
     GLuint image_texture;
@@ -875,16 +1787,252 @@ bool AnnotationApp::read_image(const char *filename, GLuint *out_texture, int *o
 #if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
     glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 #endif
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image_width, image_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
-    stbi_image_free(image_data);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    return image_texture;
+}
+
+// Simple helper function to load an image into a OpenGL texture with common settings
+bool AnnotationApp::read_image(const char *filename, GLuint *out_texture, int *out_width, int *out_height)
+{
+    // the levels and the decode in progress belong to the image replaced
+    this->mipmaps.cancel();
+    if (!this->loading_fname.empty())
+    {
+        this->decode_ahead.forget(this->loading_fname);
+        this->loading_fname.clear();
+    }
+    this->placeholder_flag = false;
+    if (this->image_texture != 0)
+    {
+        glDeleteTextures(1, &this->image_texture);
+        this->image_texture = 0;
+    }
 
-    *out_texture = image_texture;
+    std::string video;
+    long frame;
+    if (video_frame_of(filename, &video, &frame))
+        return this->read_frame(video, frame, out_texture, out_width, out_height);
+    this->video_flag = false;
+    this->video_source.close();
+    if (ArraySource::handles(filename))
+        return this->read_array(filename, out_texture, out_width, out_height);
+    this->array_flag = false;
+    this->array_view.release();
+    this->array_source.close();
+
+    // Load from file : pixels decoded ahead and ready are shown at once
+    int image_width = 0;
+    int image_height = 0;
+    unsigned char *image_data = NULL;
+    if (this->decode_ahead.take(filename, &image_data, &image_width, &image_height, false) && (image_data != NULL))
+    {
+        this->show_decoded(image_data, image_width, image_height);
+        *out_texture = this->image_texture;
+        *out_width = image_width;
+        *out_height = image_height;
+        return true;
+    }
+
+    // else the image is decoded in the background : its size comes from the header, the thumbnail (or a blank texture) is shown meanwhile
+    {
+        FrameTimer timer(PHASE_DECODE);
+        if (!probe_image_size(filename, &image_width, &image_height))
+            return false;
+    }
+    if (this->decode_ahead.request(this->pool, filename))
+    {
+        // the thumbnail of an image opened in the session, else its cell in the cache of the folder
+        const thumbnail_t *thumbnail = this->thumbnails.get(filename);
+        const thumbnail_record_t *record = nullptr;
+        const unsigned char *cell = nullptr;
+        std::string prefix = this->images_folder + "/";
+        if ((thumbnail == nullptr) && (strncmp(filename, prefix.c_str(), prefix.size()) == 0))
+        {
+            record = this->thumbnail_atlas.find(filename + prefix.size());
+            cell = this->thumbnail_atlas.pixels(record);
+        }
+        static const unsigned char blank[4] = {40, 40, 40, 255};
+        if (thumbnail != nullptr)
+            this->image_texture = upload_rgba(thumbnail->pixels.data(), thumbnail->width, thumbnail->height);
+        else if (cell != nullptr)
+        {
+            // the thumbnail fills the top left corner of its cell
+            std::vector<unsigned char> pixels((size_t)record->width * record->height * 4);
+            for (int y = 0; y < record->height; y++)
+                memcpy(&pixels[(size_t)y * record->width * 4], cell + (size_t)y * THUMBNAIL_CELL * 4, (size_t)record->width * 4);
+            this->image_texture = upload_rgba(pixels.data(), record->width, record->height);
+        }
+        else
+            this->image_texture = upload_rgba(blank, 1, 1);
+        this->placeholder_flag = (thumbnail == nullptr) && (cell == nullptr);
+        this->loading_fname = filename;
+
+        *out_texture = this->image_texture;
+        *out_width = image_width;
+        *out_height = image_height;
+        return true;
+    }
+
+    // too many images decoded ahead : decoded here
+    {
+        FrameTimer timer(PHASE_DECODE);
+        image_data = stbi_load(filename, &image_width, &image_height, NULL, 4);
+    }
+    if (image_data == NULL)
+        return false;
+    this->show_decoded(image_data, image_width, image_height);
+    *out_texture = this->image_texture;
     *out_width = image_width;
     *out_height = image_height;
+    return true;
+}
+
+void AnnotationApp::show_decoded(unsigned char *pixels, int width, int height)
+{
+    // the image is shown at once, its smaller levels are computed in the background (the pixels are freed there)
+    GLuint texture = upload_rgba(pixels, width, height);
+    this->mipmaps.start(this->pool, texture, pixels, width, height, THUMBNAIL_SIZE);
+    if (this->image_texture != 0)
+        glDeleteTextures(1, &this->image_texture);
+    this->image_texture = texture;
+    this->placeholder_flag = false;
+}
+
+void AnnotationApp::poll_image(void)
+{
+    if (this->loading_fname.empty())
+        return;
+    int width = 0, height = 0;
+    unsigned char *pixels = NULL;
+    if (!this->decode_ahead.take(this->loading_fname, &pixels, &width, &height, false))
+        return;
+
+    std::string fname;
+    fname.swap(this->loading_fname);
+    if (pixels == NULL)
+    {
+        // the thumbnail shown meanwhile goes too
+        spdlog::error("Cannot decode {}", fname.c_str());
+        this->image_failed(this->image_fname);
+        return;
+    }
+
+    // the full resolution replaces the thumbnail, the instances were already placed from the size in the header
+    this->show_decoded(pixels, width, height);
+    this->current_image_texture = this->image_texture;
+    if ((width != this->current_image_width) || (height != this->current_image_height))
+    {
+        this->current_image_width = width;
+        this->current_image_height = height;
+        this->compute_scale_flag = true;
+    }
+    this->display_times.full = startup_elapsed() - this->open_time;
+    spdlog::debug("{} : full resolution in {:.1f} ms", fname.c_str(), this->display_times.full);
+}
+
+void AnnotationApp::image_failed(const std::string &fname)
+{
+    this->mipmaps.cancel();
+    if (this->image_texture != 0)
+    {
+        glDeleteTextures(1, &this->image_texture);
+        this->image_texture = 0;
+    }
+    this->array_flag = false;
+    this->video_flag = false;
+    this->array_view.release();
+    this->current_image_texture = 0;
+    this->current_image_width = 0;
+    this->current_image_height = 0;
+    this->placeholder_flag = false;
+    this->first_pixel_flag = false;
+    this->image_error = fname;
+    this->image_fname.clear();
+}
 
+bool AnnotationApp::read_array(const char *filename, GLuint *out_texture, int *out_width, int *out_height)
+{
+    // the mapping stays open while the image is shown : the channels can be changed without reading the file
+    this->array_flag = false;
+    FrameTimer timer(PHASE_UPLOAD);
+    if (!this->array_source.open(filename) || !this->array_view.upload(this->array_source))
+        return false;
+    this->array_flag = true;
+    this->mipmaps.start_gpu(this->array_view.planes(), 3);
+
+    *out_texture = this->array_view.texture();
+    *out_width = this->array_source.layout().width;
+    *out_height = this->array_source.layout().height;
+    return true;
+}
+
+bool AnnotationApp::read_frame(const std::string &video, long frame, GLuint *out_texture, int *out_width, int *out_height)
+{
+    // the video stays mapped while its frames are shown
+    this->array_flag = false;
+    this->video_flag = false;
+    this->array_source.close();
+    if ((this->video_source.name() != video) && !this->video_source.open(video))
+        return false;
+
+    video_frame_t planes;
+    FrameTimer timer(PHASE_UPLOAD);
+    if (!this->video_source.frame(frame, &planes) || !this->array_view.upload_yuv(planes))
+        return false;
+    this->video_flag = true;
+    this->mipmaps.start_gpu(this->array_view.planes(), 3);
+
+    // the next frames are read by the kernel while this one is annotated
+    this->video_source.prefetch(frame + 1, PREFETCH_FRAMES);
+
+    *out_texture = this->array_view.texture();
+    *out_width = this->video_source.format().width;
+    *out_height = this->video_source.format().height;
     return true;
 }
 
+void AnnotationApp::ui_array_panel(void)
+{
+    if (!this->array_flag)
+        return;
+
+    const array_layout_t &layout = this->array_source.layout();
+    array_display_t &display = this->array_view.display;
+    bool upload = false;
+
+    ImGui::Separator();
+    ImGui::Text(ICON_FA_SLIDERS " %d x %d, %d channel%s", layout.width, layout.height, layout.channels, (layout.channels > 1) ? "s" : "");
+    if ((layout.channels > 1) && ImGui::Checkbox("RGB", &display.rgb))
+        upload = true;
+
+    const char *names[3] = {"Red", "Green", "Blue"};
+    for (int k = 0; k < (display.rgb ? 3 : 1); k++)
+    {
+        ImGui::PushID(k);
+        if ((layout.channels > 1) && ImGui::SliderInt(display.rgb ? names[k] : "Channel", &display.channels[k], 0, layout.channels - 1))
+            upload = true;
+        float speed = std::max(1e-6f, (display.high[k] - display.low[k]) / 200.0f);
+        ImGui::DragFloatRange2("Range", &display.low[k], &display.high[k], speed, 0.0f, 0.0f, "%.4g", "%.4g");
+        ImGui::PopID();
+    }
+    ImGui::SliderFloat("Gamma", &display.gamma, 0.2f, 5.0f);
+    if (ImGui::Button("Auto range"))
+        this->array_view.auto_range(this->array_source);
+    ImGui::SameLine();
+    ImGui::Checkbox("On every image", &display.auto_range);
+
+    // only the channels shown are on the gpu
+    if (upload)
+    {
+        this->mipmaps.cancel();
+        if (this->array_view.upload(this->array_source))
+        {
+            this->current_image_texture = this->array_view.texture();
+            this->mipmaps.start_gpu(this->array_view.planes(), 3);
+        }
+    }
+}
+
 void AnnotationApp::activate_annotation(long unsigned int k)
 {
     for (long unsigned int n = 0; n < this->annotations.size(); n++)
@@ -903,8 +2051,18 @@ void AnnotationApp::activate_annotation(long unsigned int k)
 
 void AnnotationApp::clear_annotations(void)
 {
+    // every image with instances will have to be saved again
+    for (auto &annotation : this->annotations)
+    {
+        for (auto &instance : annotation.inst)
+            this->mark_image_dirty(instance.img_fname);
+    }
+    this->dirty_labels = true;
+
     this->annotations.clear();
     this->ninstperimage.clear();
+    this->filter_rebuild_flag = true;
+    this->view_dirty = true;
 }
 
 void AnnotationApp::import_annotations_from_prev(void)
@@ -933,11 +2091,551 @@ void AnnotationApp::import_annotations_from_prev(void)
                     AnnotationInstance _inst = AnnotationInstance(instance);
                     _inst.set_fname(this->image_fname);
                     annotation.inst.push_back(_inst);
+                    this->index_instance(&annotation - &this->annotations[0], this->image_fname, true);
                 }
             }
         }
 
         // dump new data to file
+        this->mark_image_dirty(this->image_fname);
+        this->save_annotations();
+    }
+}
+
+void AnnotationApp::import_coco(std::string fname)
+{
+    // nothing changes, in memory or on disk, unless the whole file is read
+    std::vector<std::string> previous;
+    for (auto &annotation : this->annotations)
+    {
+        for (auto &instance : annotation.inst)
+            previous.push_back(instance.img_fname);
+    }
+    if (!coco_import(fname, this->annotations, this->ninstperimage, this->annotations_scale))
+        return;
+
+    // every image that had instances before the import must be saved again
+    for (auto &img_fname : previous)
+        this->mark_image_dirty(img_fname);
+    this->filter_rebuild_flag = true;
+    this->view_dirty = true;
+
+    // the imported annotations replace the current ones and are saved right away
+    this->dirty_labels = true;
+    for (auto &annotation : this->annotations)
+    {
+        for (auto &instance : annotation.inst)
+            this->mark_image_dirty(instance.img_fname);
+    }
+    this->save_annotations();
+}
+
+void AnnotationApp::report_unsupported_files(void)
+{
+    // files with an image extension that the scan could not decode, kept in its listing
+    this->unsupported_files.clear();
+    std::shared_ptr<const DatasetManifest> listing = this->scanner.listing();
+    if (!listing)
+        return;
+
+    std::map<std::string, long> formats;
+    for (auto &dir : listing->dirs)
+    {
+        for (auto &f : dir.files)
+        {
+            if (f.supported)
+                continue;
+            std::string format = image_format_name((image_format_t)f.format);
+            this->unsupported_files.push_back(std::make_pair(manifest_join(dir.path, f.name), format));
+            formats[format]++;
+        }
+    }
+    if (this->unsupported_files.empty())
+        return;
+
+    std::sort(this->unsupported_files.begin(), this->unsupported_files.end());
+    std::string summary;
+    for (auto &f : formats)
+        summary += (summary.empty() ? "" : ", ") + std::to_string(f.second) + " " + f.first;
+    spdlog::warn("{} files cannot be read : {}", this->unsupported_files.size(), summary.c_str());
+}
+
+bool AnnotationApp::filter_active(void)
+{
+    return (this->filter.mode != FILTER_ALL) || !this->filter.text.empty();
+}
+
+bool AnnotationApp::view_active(void)
+{
+    return this->filter_active() || (this->sort_order != ORDER_NAME);
+}
+
+void AnnotationApp::ui_filter_bar(void)
+{
+    ImGui::SetNextItemWidth(-1);
+    if (ImGui::InputTextWithHint("##filtertext", ICON_FA_SEARCH " Search file names", this->filter_text, sizeof(this->filter_text)))
+    {
+        this->filter.text = this->filter_text;
+        this->view_dirty = true;
+    }
+
+    std::string preview = "All images";
+    if (this->filter.mode == FILTER_UNANNOTATED)
+        preview = "Without annotation";
+    else if (this->filter.mode == FILTER_ANNOTATED)
+        preview = "With annotations";
+    else if ((this->filter.mode == FILTER_LABEL) && (this->filter.label < (int)this->annotations.size()))
+        preview = "Label : " + this->annotations[this->filter.label].label;
+
+    ImGui::SetNextItemWidth(-1);
+    if (ImGui::BeginCombo("##filtermode", preview.c_str()))
+    {
+        const char *modes[] = {"All images", "Without annotation", "With annotations"};
+        for (int m = FILTER_ALL; m <= FILTER_ANNOTATED; m++)
+        {
+            if (ImGui::Selectable(modes[m], this->filter.mode == m))
+            {
+                this->filter.mode = (image_filter_mode_t)m;
+                this->view_dirty = true;
+            }
+        }
+        for (size_t n = 0; n < this->annotations.size(); n++)
+        {
+            std::string item = "Label : " + this->annotations[n].label + "##filterlabel" + std::to_string(n);
+            if (ImGui::Selectable(item.c_str(), (this->filter.mode == FILTER_LABEL) && (this->filter.label == (int)n)))
+            {
+                this->filter.mode = FILTER_LABEL;
+                this->filter.label = n;
+                this->view_dirty = true;
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    const char *sort_names[ORDER_MODES] = {"Sort by name", "Sort by name, numbers by value", "Sort by modification time", "Sort by file size", "Sort by number of instances", "Sort by capture time"};
+    ImGui::SetNextItemWidth(-1);
+    if (ImGui::BeginCombo("##sortorder", sort_names[this->sort_order]))
+    {
+        for (int o = ORDER_NAME; o < ORDER_MODES; o++)
+        {
+            if (ImGui::Selectable(sort_names[o], this->sort_order == o))
+            {
+                this->sort_order = (image_order_t)o;
+                this->view_dirty = true;
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    this->update_order();
+
+    if (this->view_active() && this->view_dirty)
+        this->update_view_rows();
+    if (this->filter_active())
+        ImGui::Text(ICON_FA_FILTER " %ld / %ld images", (long)this->view_rows.size(), (long)this->image_files.size());
+    if ((this->sort_order != ORDER_NAME) && this->orders.busy(this->sort_order))
+        ImGui::Text(ICON_FA_SORT " Sorting...");
+}
+
+void AnnotationApp::update_order(void)
+{
+    if (this->orders.poll())
+        this->view_dirty = true;
+
+    // the list is only sorted once complete, an outdated order is used until the new one is ready
+    if ((this->sort_order == ORDER_NAME) || this->scanning_flag || !this->orders.stale(this->sort_order) || this->orders.busy(this->sort_order))
+        return;
+    double now = ImGui::GetTime();
+    if ((this->orders.get(this->sort_order) != nullptr) && (now - this->last_order_time < 1.0))
+    {
+        // the ui may be asleep by then
+        ui_wakeup_after((Uint32)((1.0 - (now - this->last_order_time)) * 1000.0) + 1);
+        return;
+    }
+    this->last_order_time = now;
+
+    std::vector<std::pair<uint32_t, std::string>> images;
+    images.reserve(this->image_files.size());
+    for (size_t n = 0; n < this->image_files.size(); n++)
+        images.push_back(std::make_pair(this->image_ids[n], this->image_files[n]));
+
+    std::vector<uint32_t> counts;
+    if (this->sort_order == ORDER_COUNT)
+    {
+        this->refresh_index();
+        counts.resize(this->image_index.size());
+        for (size_t id = 0; id < counts.size(); id++)
+            counts[id] = this->image_index.count(id);
+    }
+
+    this->orders.compute(this->pool, this->sort_order, images, counts, this->scanner.listing());
+}
+
+void AnnotationApp::refresh_index(void)
+{
+    if (!this->filter_rebuild_flag)
+        return;
+    this->image_index.rebuild(this->annotations);
+    this->filter_rebuild_flag = false;
+    this->orders.invalidate(ORDER_COUNT);
+}
+
+void AnnotationApp::update_view_rows(void)
+{
+    this->refresh_index();
+
+    // one pass over the ids of the list, the images kept are the bits set by the index
+    bool filtered = this->filter_active();
+    std::vector<uint64_t> bits;
+    if (filtered)
+        this->image_index.match(this->filter, bits);
+
+    this->view_rows.clear();
+    const std::vector<uint32_t> *order = this->orders.get(this->sort_order);
+    if (order == nullptr)
+    {
+        for (size_t n = 0; n < this->image_ids.size(); n++)
+        {
+            if (!filtered || ImageIndex::test(bits, this->image_ids[n]))
+                this->view_rows.push_back(n);
+        }
+    }
+    else
+    {
+        // ids -> positions in the list, cleared once shown : the images added since the order was computed come last
+        std::vector<uint32_t> positions(this->image_index.size(), UINT32_MAX);
+        for (size_t n = 0; n < this->image_ids.size(); n++)
+            positions[this->image_ids[n]] = n;
+        for (uint32_t id : *order)
+        {
+            if ((id >= positions.size()) || (positions[id] == UINT32_MAX))
+                continue;
+            if (!filtered || ImageIndex::test(bits, id))
+                this->view_rows.push_back(positions[id]);
+            positions[id] = UINT32_MAX;
+        }
+        for (size_t n = 0; n < this->image_ids.size(); n++)
+        {
+            uint32_t id = this->image_ids[n];
+            if ((positions[id] != UINT32_MAX) && (!filtered || ImageIndex::test(bits, id)))
+                this->view_rows.push_back(n);
+        }
+    }
+    this->view_dirty = false;
+}
+
+void AnnotationApp::index_instance(int label, const std::string &fname, bool added)
+{
+    // counts rebuilt from scratch anyway
+    if (this->filter_rebuild_flag)
+        return;
+
+    if (added)
+        this->image_index.add_instance(label, fname);
+    else
+        this->image_index.remove_instance(label, fname);
+
+    // the image moves in the count order
+    uint32_t id = this->image_index.id(fname);
+    if (this->orders.update_count(id, this->image_index.count(id), this->image_index) && (this->sort_order == ORDER_COUNT))
+        this->view_dirty = true;
+
+    if (!this->filter_active() || this->view_dirty)
+        return;
+
+    // the rows of a sorted view are not in the order of the list
+    if (this->sort_order != ORDER_NAME)
+    {
+        this->view_dirty = true;
+        return;
+    }
+
+    // only the row of the image may enter or leave the filtered list
+    auto it = std::lower_bound(this->image_files.begin(), this->image_files.end(), fname);
+    if ((it == this->image_files.end()) || (*it != fname))
+        return;
+    uint32_t pos = it - this->image_files.begin();
+    bool match = this->image_index.match(this->filter, this->image_ids[pos]);
+    auto row = std::lower_bound(this->view_rows.begin(), this->view_rows.end(), pos);
+    bool shown = (row != this->view_rows.end()) && (*row == pos);
+    if (match && !shown)
+        this->view_rows.insert(row, pos);
+    else if (!match && shown)
+        this->view_rows.erase(row);
+}
+
+void AnnotationApp::insert_image_file(const std::string &fname)
+{
+    auto it = std::lower_bound(this->image_files.begin(), this->image_files.end(), fname);
+    if ((it != this->image_files.end()) && (*it == fname))
+        return;
+    this->image_ids.insert(this->image_ids.begin() + (it - this->image_files.begin()), this->image_index.id(fname));
+    this->image_files.insert(it, fname);
+    this->view_dirty = true;
+    this->orders.invalidate();
+
+    // create entry in dictionary counting instances
+    if (this->ninstperimage.find(fname) == this->ninstperimage.end())
+        this->ninstperimage[fname] = 0;
+}
+
+void AnnotationApp::remove_image_file(const std::string &fname)
+{
+    auto it = std::lower_bound(this->image_files.begin(), this->image_files.end(), fname);
+    if ((it != this->image_files.end()) && (*it == fname))
+    {
+        this->image_ids.erase(this->image_ids.begin() + (it - this->image_files.begin()));
+        this->image_files.erase(it);
+        this->view_dirty = true;
+        this->orders.invalidate();
+    }
+}
+
+void AnnotationApp::apply_watch_events(void)
+{
+    std::vector<watch_event_t> events;
+    this->watcher.take(events);
+
+    bool renamed = false;
+    for (auto &e : events)
+    {
+        switch (e.type)
+        {
+        case WATCH_ADDED:
+            spdlog::debug("File added : {}", e.path.c_str());
+            this->insert_image_file(e.path);
+            break;
+
+        case WATCH_REMOVED:
+            spdlog::debug("File removed : {}", e.path.c_str());
+            this->remove_image_file(e.path);
+            break;
+
+        case WATCH_RENAMED:
+        {
+            spdlog::debug("File renamed : {} -> {}", e.path.c_str(), e.new_path.c_str());
+            this->remove_image_file(e.path);
+            this->insert_image_file(e.new_path);
+
+            // the annotations follow the image
+            auto count = this->ninstperimage.find(e.path);
+            if ((count == this->ninstperimage.end()) || (count->second == 0))
+                break;
+            for (auto &annotation : this->annotations)
+            {
+                for (auto &instance : annotation.inst)
+                {
+                    if (instance.img_fname == e.path)
+                        instance.img_fname = e.new_path;
+                }
+            }
+            this->ninstperimage[e.new_path] = count->second;
+            this->ninstperimage.erase(e.path);
+            if (this->image_fname == e.path)
+                this->image_fname = e.new_path;
+            this->mark_image_dirty(e.path);
+            this->mark_image_dirty(e.new_path);
+            this->filter_rebuild_flag = true;
+            renamed = true;
+            break;
+        }
+
+        case WATCH_FOLDER_REMOVED:
+        {
+            // the paths of a folder are contiguous in the sorted list
+            spdlog::debug("Folder removed : {}", e.path.c_str());
+            std::string prefix = e.path + "/";
+            auto first = std::lower_bound(this->image_files.begin(), this->image_files.end(), prefix);
+            auto last = first;
+            while ((last != this->image_files.end()) && (last->compare(0, prefix.size(), prefix) == 0))
+                ++last;
+            this->image_ids.erase(this->image_ids.begin() + (first - this->image_files.begin()), this->image_ids.begin() + (last - this->image_files.begin()));
+            this->image_files.erase(first, last);
+            this->view_dirty = true;
+            this->orders.invalidate();
+            break;
+        }
+        }
+    }
+
+    if (renamed)
+        this->save_annotations();
+}
+
+void AnnotationApp::mark_image_dirty(std::string fname)
+{
+    this->dirty_images.insert(fname);
+    this->grid_boxes_dirty = true;
+    if (fname == this->image_fname)
+        this->minimap_dirty = true;
+    if (this->yolo_flag)
+        this->yolo_dirty_images.insert(fname);
+}
+
+void AnnotationApp::mark_label_dirty(long unsigned int n)
+{
+    // the shards refer to labels by their names, the yolo files by their indices and types
+    this->dirty_labels = true;
+    for (auto &instance : this->annotations[n].inst)
+    {
+        this->mark_image_dirty(instance.img_fname);
+    }
+}
+
+void AnnotationApp::count_instances(void)
+{
+    for (auto it = this->ninstperimage.begin(); it != this->ninstperimage.end(); ++it)
+    {
+        it->second = 0;
+    }
+
+    for (auto &annotation : this->annotations)
+    {
+        for (auto &instance : annotation.inst)
+            this->ninstperimage[instance.img_fname] = this->ninstperimage[instance.img_fname] + 1;
+    }
+}
+
+void AnnotationApp::save_annotations(void)
+{
+    if (this->sharded_flag)
+    {
+        // only the labels and the images that changed are written
+        FrameTimer timer(PHASE_JSON);
+        if (this->dirty_labels)
+            this->shards.write_labels(this->annotations);
+        this->shards.write_shards(this->dirty_images, this->annotations, this->annotations_scale);
+        this->count_instances();
+    }
+    else
+    {
+        this->json_write(this->temp_annotation_fname);
+    }
+
+    // the label files follow in the background
+    if (this->yolo_flag && (this->dirty_labels || !this->yolo_dirty_images.empty()))
+        this->sync_yolo(false);
+
+    this->dirty_images.clear();
+    this->dirty_labels = false;
+}
+
+void AnnotationApp::set_yolo(bool enable)
+{
+    if (this->images_folder.empty())
+    {
+        spdlog::warn("Open a folder before syncing YOLO labels");
+        return;
+    }
+
+    this->yolo_flag = enable;
+    this->yolo_dirty_images.clear();
+
+    // every image is compared to the last sync, only the differences are written
+    if (enable)
+        this->sync_yolo(true);
+}
+
+void AnnotationApp::sync_yolo(bool full)
+{
+    std::vector<image_boxes_t> images = this->snapshot_boxes(full ? nullptr : &this->yolo_dirty_images);
+
+    std::vector<std::string> classes;
+    for (auto &annotation : this->annotations)
+        classes.push_back(annotation.label);
+
+    this->yolo.request(images, classes);
+    this->yolo_dirty_images.clear();
+}
+
+std::vector<image_boxes_t> AnnotationApp::snapshot_boxes(const std::set<std::string> *fnames)
+{
+    std::vector<image_boxes_t> images;
+    std::unordered_map<std::string, size_t> index;
+
+    // images to export : the ones requested, or all the images of the folder
+    if (fnames == nullptr)
+    {
+        for (auto &e : this->image_files)
+        {
+            index[e] = images.size();
+            images.push_back(image_boxes_t{e, std::vector<image_box_t>()});
+        }
+    }
+    else
+    {
+        for (auto &e : *fnames)
+        {
+            index[e] = images.size();
+            images.push_back(image_boxes_t{e, std::vector<image_box_t>()});
+        }
+    }
+
+    // their boxes, in pixels (points are not exported as boxes)
+    for (long unsigned n = 0; n < this->annotations.size(); n++)
+    {
+        if (this->annotations[n].type != ANNOTATION_TYPE_AREA)
+            continue;
+
+        for (auto &instance : this->annotations[n].inst)
+        {
+            auto it = index.find(instance.img_fname);
+            if (it == index.end())
+            {
+                if (fnames != nullptr)
+                    continue;
+
+                // annotated image missing from the folder
+                it = index.insert(std::make_pair(instance.img_fname, images.size())).first;
+                images.push_back(image_boxes_t{instance.img_fname, std::vector<image_box_t>()});
+            }
+
+            vec2f _tl = instance.rect_on_image.get_topleft_vertex() / this->annotations_scale;
+            vec2f _br = instance.rect_on_image.get_bottomright_vertex() / this->annotations_scale;
+            images[it->second].boxes.push_back(image_box_t{(int)n, _tl.x, _tl.y, _br.x, _br.y});
+        }
+    }
+
+    return images;
+}
+
+void AnnotationApp::set_sharded(bool enable)
+{
+    if (this->images_folder.empty())
+    {
+        spdlog::warn("Open a folder before changing the annotation files layout");
+        return;
+    }
+
+    if (enable == this->sharded_flag)
+        return;
+
+    if (enable)
+    {
+        spdlog::info("Switching to one annotation file per image");
+
+        // every image gets its shard written (or a stale one removed)
+        this->sharded_flag = true;
+        this->dirty_labels = true;
+        for (auto &e : this->image_files)
+            this->mark_image_dirty(e);
+        for (auto &annotation : this->annotations)
+        {
+            for (auto &instance : annotation.inst)
+                this->mark_image_dirty(instance.img_fname);
+        }
+        this->save_annotations();
+    }
+    else
+    {
+        spdlog::info("Switching to a single annotation file");
+
+        // the shards are left untouched but the folder is not detected as sharded anymore
+        this->sharded_flag = false;
         this->json_write(this->temp_annotation_fname);
+        this->annotations_file_exists = true;
+        this->shards.remove_labels();
+        this->dirty_images.clear();
+        this->dirty_labels = false;
     }
 }
\ No newline at end of file
@@ -0,0 +1,403 @@
+#include "yacvat/array_source.h"
+#include "yacvat/files.h"
+#include "spdlog/spdlog.h"
+#include "nlohmann/json.hpp"
+
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <stdint.h>
+#include <sys/stat.h>
+
+static const size_t SAMPLE_SIZE = 65536; // values read to estimate a range
+
+static bool host_big_endian(void)
+{
+    uint16_t v = 1;
+    unsigned char b;
+    memcpy(&b, &v, 1);
+    return b == 0;
+}
+
+// "uint16", "<u2", ">f4", "|u1", ...
+static bool parse_dtype(const std::string &s, array_dtype_t *dtype, bool *swap)
+{
+    static const struct
+    {
+        const char *name;
+        const char *code;
+        array_dtype_t dtype;
+    } types[] = {
+        {"uint8", "u1", ARRAY_UINT8},
+        {"int8", "i1", ARRAY_INT8},
+        {"uint16", "u2", ARRAY_UINT16},
+        {"int16", "i2", ARRAY_INT16},
+        {"uint32", "u4", ARRAY_UINT32},
+        {"int32", "i4", ARRAY_INT32},
+        {"float32", "f4", ARRAY_FLOAT32},
+        {"float64", "f8", ARRAY_FLOAT64},
+        {"bool", "b1", ARRAY_UINT8},
+    };
+
+    std::string code = s;
+    bool big = host_big_endian();
+    if (!code.empty() && ((code[0] == '<') || (code[0] == '>') || (code[0] == '|') || (code[0] == '=')))
+    {
+        if (code[0] == '<')
+            big = false;
+        else if (code[0] == '>')
+            big = true;
+        code = code.substr(1);
+    }
+
+    for (auto &t : types)
+    {
+        if ((code == t.name) || (code == t.code))
+        {
+            *dtype = t.dtype;
+            *swap = (ArraySource::element_size(t.dtype) > 1) && (big != host_big_endian());
+            return true;
+        }
+    }
+    return false;
+}
+
+// value of a key of the python dict of a .npy header, as written by numpy
+static std::string header_value(const std::string &header, const std::string &key)
+{
+    size_t pos = header.find("'" + key + "'");
+    if (pos == std::string::npos)
+        return "";
+    pos = header.find(':', pos);
+    if (pos == std::string::npos)
+        return "";
+    pos = header.find_first_not_of(' ', pos + 1);
+    if (pos == std::string::npos)
+        return "";
+
+    size_t end;
+    if (header[pos] == '(')
+        end = header.find(')', pos) + 1;
+    else if (header[pos] == '\'')
+        end = header.find('\'', pos + 1) + 1;
+    else
+        end = header.find_first_of(",}", pos);
+    if ((end == std::string::npos) || (end == 0))
+        return "";
+    return header.substr(pos, end - pos);
+}
+
+// "layout" of the json next to an array, empty if none
+static std::string sidecar_layout(const std::string &fname)
+{
+    std::ifstream f((fname + ".json").c_str());
+    if (!f.good())
+        return "";
+    try
+    {
+        return nlohmann::json::parse(f).value("layout", std::string(""));
+    }
+    catch (const std::exception &e)
+    {
+        spdlog::warn("{}.json : {}", fname.c_str(), e.what());
+        return "";
+    }
+}
+
+static bool probe_npy(const std::string &fname, array_layout_t *layout)
+{
+    FILE *f = fopen(fname.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+
+    unsigned char magic[12];
+    size_t n = fread(magic, 1, sizeof(magic), f);
+    if ((n < 10) || (memcmp(magic, "\x93NUMPY", 6) != 0))
+    {
+        fclose(f);
+        return false;
+    }
+
+    // version 1 : 16 bits header length, 2 and 3 : 32 bits
+    size_t start = (magic[6] == 1) ? 10 : 12;
+    size_t length = (magic[6] == 1) ? (magic[8] | (magic[9] << 8)) : (magic[8] | (magic[9] << 8) | (magic[10] << 16) | ((size_t)magic[11] << 24));
+    if ((n < start) || (length > (1 << 20)))
+    {
+        fclose(f);
+        return false;
+    }
+    std::string header(length, '\0');
+    fseek(f, start, SEEK_SET);
+    bool ok = (fread(&header[0], 1, length, f) == length);
+    fclose(f);
+    if (!ok)
+        return false;
+
+    std::string descr = header_value(header, "descr");
+    if ((descr.size() < 2) || !parse_dtype(descr.substr(1, descr.size() - 2), &layout->dtype, &layout->swap))
+    {
+        spdlog::warn("{} : unsupported dtype {}", fname.c_str(), descr.c_str());
+        return false;
+    }
+    if (header_value(header, "fortran_order") == "True")
+    {
+        spdlog::warn("{} : arrays in fortran order are not supported", fname.c_str());
+        return false;
+    }
+
+    std::vector<long> dims;
+    std::string shape = header_value(header, "shape");
+    for (size_t pos = 1; pos < shape.size();)
+    {
+        char *end;
+        long d = strtol(shape.c_str() + pos, &end, 10);
+        if (end == shape.c_str() + pos)
+            break;
+        dims.push_back(d);
+        pos = shape.find_first_of("0123456789", end - shape.c_str());
+    }
+
+    layout->offset = start + length;
+    layout->planar = false;
+    layout->channels = 1;
+    if (dims.size() == 2)
+    {
+        layout->height = dims[0];
+        layout->width = dims[1];
+    }
+    else if (dims.size() == 3)
+    {
+        // the channels are the smallest dimension, first (chw) or last (hwc) : the sidecar decides when it is neither
+        std::string side = sidecar_layout(fname);
+        bool planar = (dims[0] < std::min(dims[1], dims[2]));
+        bool interleaved = (dims[2] < std::min(dims[0], dims[1]));
+        if (!side.empty())
+            layout->planar = (side == "planar");
+        else if (planar == interleaved)
+            spdlog::warn("{} : ambiguous shape {}, read as (height, width, channels) (a {}.json with a layout decides)", fname.c_str(), shape.c_str(), fname.c_str());
+        else
+            layout->planar = planar;
+
+        layout->height = layout->planar ? dims[1] : dims[0];
+        layout->width = layout->planar ? dims[2] : dims[1];
+        layout->channels = layout->planar ? dims[0] : dims[2];
+    }
+    else
+    {
+        spdlog::warn("{} : unsupported shape {}", fname.c_str(), shape.c_str());
+        return false;
+    }
+    return (layout->width > 0) && (layout->height > 0) && (layout->channels > 0);
+}
+
+static bool probe_raw(const std::string &fname, array_layout_t *layout)
+{
+    std::ifstream f((fname + ".json").c_str());
+    if (!f.good())
+        return false;
+
+    try
+    {
+        nlohmann::json desc = nlohmann::json::parse(f);
+        layout->width = desc.at("width").get<int>();
+        layout->height = desc.at("height").get<int>();
+        layout->channels = desc.value("channels", 1);
+        layout->planar = (desc.value("layout", std::string("planar")) != "interleaved");
+        layout->offset = desc.value("offset", (size_t)0);
+        std::string dtype = desc.value("dtype", std::string("uint8"));
+        if (!parse_dtype(dtype, &layout->dtype, &layout->swap))
+        {
+            spdlog::warn("{} : unsupported dtype {}", fname.c_str(), dtype.c_str());
+            return false;
+        }
+        if (desc.value("byte_order", std::string("")) == "big")
+            layout->swap = (ArraySource::element_size(layout->dtype) > 1) && !host_big_endian();
+    }
+    catch (const std::exception &e)
+    {
+        spdlog::warn("{}.json : {}", fname.c_str(), e.what());
+        return false;
+    }
+    return (layout->width > 0) && (layout->height > 0) && (layout->channels > 0);
+}
+
+// bytes of the file covered by the array
+static size_t array_bytes(const array_layout_t &layout)
+{
+    return layout.offset + (size_t)layout.width * layout.height * layout.channels * ArraySource::element_size(layout.dtype);
+}
+
+ArraySource::ArraySource(void)
+{
+    memset(&this->shape, 0, sizeof(this->shape));
+}
+
+bool ArraySource::handles(const std::string &fname)
+{
+    std::string ext = file_extension(fname);
+    return (ext == "npy") || (ext == "raw");
+}
+
+bool ArraySource::probe(const std::string &fname, array_layout_t *layout)
+{
+    bool ok = (file_extension(fname) == "npy") ? probe_npy(fname, layout) : probe_raw(fname, layout);
+    if (!ok)
+        return false;
+
+    // a truncated file is not listed : it would fail once opened
+    struct stat st;
+    if (stat(fname.c_str(), &st) != 0)
+        return false;
+    if ((size_t)st.st_size < array_bytes(*layout))
+    {
+        spdlog::warn("{} : {} bytes expected, {} found", fname.c_str(), array_bytes(*layout), (size_t)st.st_size);
+        return false;
+    }
+    return true;
+}
+
+size_t ArraySource::element_size(array_dtype_t dtype)
+{
+    switch (dtype)
+    {
+    case ARRAY_UINT8:
+    case ARRAY_INT8:
+        return 1;
+    case ARRAY_UINT16:
+    case ARRAY_INT16:
+        return 2;
+    case ARRAY_FLOAT64:
+        return 8;
+    default:
+        return 4;
+    }
+}
+
+bool ArraySource::open(const std::string &fname)
+{
+    this->close();
+    if (!ArraySource::probe(fname, &this->shape))
+        return false;
+
+    size_t needed = array_bytes(this->shape);
+    if (!this->file.open(fname))
+        return false;
+    if (this->file.size() < needed)
+    {
+        spdlog::error("{} : {} bytes expected, {} found", fname.c_str(), needed, this->file.size());
+        this->file.close();
+        return false;
+    }
+
+    spdlog::debug("Array {} : {} x {} x {}, {} bytes per value, {}", fname.c_str(), this->shape.width, this->shape.height, this->shape.channels, ArraySource::element_size(this->shape.dtype), this->shape.planar ? "planar" : "interleaved");
+    return true;
+}
+
+void ArraySource::close(void)
+{
+    this->file.close();
+}
+
+const unsigned char *ArraySource::plane(int channel)
+{
+    const unsigned char *data = this->file.data() + this->shape.offset;
+    if (!this->shape.planar)
+        return data;
+    return data + (size_t)channel * this->shape.width * this->shape.height * ArraySource::element_size(this->shape.dtype);
+}
+
+size_t ArraySource::pixel_stride(void)
+{
+    size_t size = ArraySource::element_size(this->shape.dtype);
+    return this->shape.planar ? size : size * this->shape.channels;
+}
+
+double ArraySource::value(const unsigned char *p)
+{
+    unsigned char b[8];
+    size_t size = ArraySource::element_size(this->shape.dtype);
+    for (size_t k = 0; k < size; k++)
+        b[k] = this->shape.swap ? p[size - 1 - k] : p[k];
+
+    switch (this->shape.dtype)
+    {
+    case ARRAY_UINT8:
+        return b[0];
+    case ARRAY_INT8:
+        return (int8_t)b[0];
+    case ARRAY_UINT16:
+    {
+        uint16_t v;
+        memcpy(&v, b, 2);
+        return v;
+    }
+    case ARRAY_INT16:
+    {
+        int16_t v;
+        memcpy(&v, b, 2);
+        return v;
+    }
+    case ARRAY_UINT32:
+    {
+        uint32_t v;
+        memcpy(&v, b, 4);
+        return v;
+    }
+    case ARRAY_INT32:
+    {
+        int32_t v;
+        memcpy(&v, b, 4);
+        return v;
+    }
+    case ARRAY_FLOAT32:
+    {
+        float v;
+        memcpy(&v, b, 4);
+        return v;
+    }
+    default:
+    {
+        double v;
+        memcpy(&v, b, 8);
+        return v;
+    }
+    }
+}
+
+void ArraySource::sample_range(int channel, float low, float high, float *vmin, float *vmax)
+{
+    *vmin = 0.0f;
+    *vmax = 1.0f;
+    if (!this->is_open())
+        return;
+
+    // evenly spaced values of the channel, whatever the size of the image
+    size_t npixels = (size_t)this->shape.width * this->shape.height;
+    size_t step = std::max((size_t)1, npixels / SAMPLE_SIZE);
+    size_t stride = this->pixel_stride();
+    const unsigned char *start = this->plane(channel) + (this->shape.planar ? 0 : channel * ArraySource::element_size(this->shape.dtype));
+
+    std::vector<double> values;
+    values.reserve(npixels / step + 1);
+    for (size_t n = 0; n < npixels; n += step)
+    {
+        double v = this->value(start + n * stride);
+        if (std::isfinite(v))
+            values.push_back(v);
+    }
+    if (values.empty())
+        return;
+
+    size_t lo = std::min(values.size() - 1, (size_t)(low * (values.size() - 1)));
+    size_t hi = std::min(values.size() - 1, (size_t)(high * (values.size() - 1)));
+    std::nth_element(values.begin(), values.begin() + lo, values.end());
+    *vmin = values[lo];
+    std::nth_element(values.begin(), values.begin() + hi, values.end());
+    *vmax = values[hi];
+    if (*vmax <= *vmin)
+        *vmax = *vmin + 1.0f;
+}
@@ -0,0 +1,363 @@
+#include "yacvat/array_view.h"
+#include "yacvat/gl_functions.h"
+#include "spdlog/spdlog.h"
+
+#include <vector>
+#include <algorithm>
+
+// program shared by every view, linked on its first use with the attribute locations of the ImGui program
+static struct
+{
+    GLuint id;
+    bool failed;
+    GLint proj;
+    GLint components;
+    GLint low;
+    GLint high;
+    GLint gamma;
+    GLint gray;
+    GLint yuv;
+    GLint yuv_scale;
+    GLint yuv_coefs;
+} program;
+
+static const char *VERTEX_SHADER =
+    "uniform mat4 ProjMtx;\n"
+    "in vec2 Position;\n"
+    "in vec2 UV;\n"
+    "out vec2 Frag_UV;\n"
+    "void main()\n"
+    "{\n"
+    "    Frag_UV = UV;\n"
+    "    gl_Position = ProjMtx * vec4(Position.xy, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *FRAGMENT_SHADER =
+    "uniform sampler2D Tex0;\n"
+    "uniform sampler2D Tex1;\n"
+    "uniform sampler2D Tex2;\n"
+    "uniform ivec3 Components;\n"
+    "uniform vec3 Low;\n"
+    "uniform vec3 High;\n"
+    "uniform float Gamma;\n"
+    "uniform int Gray;\n"
+    "uniform int Yuv;\n"
+    "uniform float YuvScale;\n"
+    "uniform vec4 YuvCoefs;\n"
+    "in vec2 Frag_UV;\n"
+    "out vec4 Out_Color;\n"
+    "float pick(vec4 t, int c)\n"
+    "{\n"
+    "    return (c == 0) ? t.r : (c == 1) ? t.g : (c == 2) ? t.b : t.a;\n"
+    "}\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 v = vec3(pick(texture(Tex0, Frag_UV), Components.x), pick(texture(Tex1, Frag_UV), Components.y), pick(texture(Tex2, Frag_UV), Components.z));\n"
+    "    if (Yuv != 0)\n"
+    "    {\n"
+    "        vec3 c = (v * YuvScale - vec3(16.0, 128.0, 128.0)) / vec3(219.0, 224.0, 224.0);\n"
+    "        v = vec3(c.x + YuvCoefs.x * c.z, c.x - YuvCoefs.y * c.y - YuvCoefs.z * c.z, c.x + YuvCoefs.w * c.y);\n"
+    "    }\n"
+    "    vec3 n = pow(clamp((v - Low) / max(High - Low, vec3(1e-30)), 0.0, 1.0), vec3(1.0 / Gamma));\n"
+    "    Out_Color = vec4((Gray != 0) ? n.xxx : n, 1.0);\n"
+    "}\n";
+
+static bool build_program(GLuint imgui_program)
+{
+    if ((program.id != 0) || program.failed)
+        return program.id != 0;
+    program.failed = true;
+    gl_load();
+    if (!gl.shaders || !gl.textures)
+    {
+        spdlog::error("OpenGL shaders are not available : arrays are shown without normalisation");
+        return false;
+    }
+
+    // the vertex buffers are set up by ImGui : its attribute locations are kept
+    static const char *attributes[] = {"Position", "UV"};
+    GLint locations[2];
+    for (int k = 0; k < 2; k++)
+        locations[k] = gl.GetAttribLocation(imgui_program, attributes[k]);
+    GLuint id = gl_build_program("array", VERTEX_SHADER, FRAGMENT_SHADER, attributes, locations, 2);
+    if (id == 0)
+        return false;
+
+    program.id = id;
+    program.failed = false;
+    program.proj = gl.GetUniformLocation(id, "ProjMtx");
+    program.components = gl.GetUniformLocation(id, "Components");
+    program.low = gl.GetUniformLocation(id, "Low");
+    program.high = gl.GetUniformLocation(id, "High");
+    program.gamma = gl.GetUniformLocation(id, "Gamma");
+    program.gray = gl.GetUniformLocation(id, "Gray");
+    program.yuv = gl.GetUniformLocation(id, "Yuv");
+    program.yuv_scale = gl.GetUniformLocation(id, "YuvScale");
+    program.yuv_coefs = gl.GetUniformLocation(id, "YuvCoefs");
+
+    gl.UseProgram(id);
+    gl.Uniform1i(gl.GetUniformLocation(id, "Tex0"), 0);
+    gl.Uniform1i(gl.GetUniformLocation(id, "Tex1"), 1);
+    gl.Uniform1i(gl.GetUniformLocation(id, "Tex2"), 2);
+    gl.UseProgram(imgui_program);
+    return true;
+}
+
+// texture from values of the array (or from a converted copy), nc components per pixel
+static GLuint create_texture(int width, int height, int nc, GLenum internal_format, GLenum type, const void *data)
+{
+    static const GLenum formats[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, formats[nc - 1], type, data);
+    return texture;
+}
+
+ArrayView::ArrayView(void)
+{
+    for (int k = 0; k < 3; k++)
+    {
+        this->textures[k] = 0;
+        this->components[k] = 0;
+        this->display.channels[k] = k;
+        this->display.low[k] = 0.0f;
+        this->display.high[k] = 1.0f;
+    }
+    this->display.rgb = false;
+    this->display.gamma = 1.0f;
+    this->display.auto_range = true;
+    this->value_scale = 1.0f;
+    this->yuv = YUV_NONE;
+    this->yuv_scale = 255.0f;
+}
+
+ArrayView::~ArrayView(void)
+{
+    this->release();
+}
+
+void ArrayView::release(void)
+{
+    // the outputs may share a texture : each one is deleted once
+    for (int k = 0; k < 3; k++)
+    {
+        bool shared = false;
+        for (int j = 0; j < k; j++)
+            shared = shared || (this->textures[j] == this->textures[k]);
+        if ((this->textures[k] != 0) && !shared)
+            glDeleteTextures(1, &this->textures[k]);
+    }
+    for (int k = 0; k < 3; k++)
+        this->textures[k] = 0;
+}
+
+bool ArrayView::upload(ArraySource &source)
+{
+    this->release();
+    if (!source.is_open())
+        return false;
+
+    this->yuv = YUV_NONE;
+    const array_layout_t &layout = source.layout();
+    int outputs = this->display.rgb ? 3 : 1;
+    for (int k = 0; k < 3; k++)
+        this->display.channels[k] = std::max(0, std::min(layout.channels - 1, this->display.channels[k]));
+
+    // integers are normalised by the driver : 8 and 16 bits keep their size, the others become floats
+    static const struct
+    {
+        GLenum type;
+        GLenum internal_formats[4];
+        float scale;
+    } formats[] = {
+        {GL_UNSIGNED_BYTE, {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8}, 255.0f},
+        {GL_BYTE, {GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F}, 127.0f},
+        {GL_UNSIGNED_SHORT, {GL_R16, GL_RG16, GL_RGB16, GL_RGBA16}, 65535.0f},
+        {GL_SHORT, {GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F}, 32767.0f},
+        {GL_UNSIGNED_INT, {GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F}, 4294967295.0f},
+        {GL_INT, {GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F}, 2147483647.0f},
+        {GL_FLOAT, {GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F}, 1.0f},
+    };
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+#if defined(GL_UNPACK_ROW_LENGTH)
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+
+    if ((layout.dtype == ARRAY_FLOAT64) || (!layout.planar && (layout.channels > 4)))
+    {
+        // no matching pixel type or too many components : the channels shown are copied as floats
+        size_t npixels = (size_t)layout.width * layout.height;
+        size_t stride = source.pixel_stride();
+        std::vector<float> copy(npixels);
+        for (int k = 0; k < outputs; k++)
+        {
+            const unsigned char *start = source.plane(this->display.channels[k]) + (layout.planar ? 0 : this->display.channels[k] * ArraySource::element_size(layout.dtype));
+            for (size_t n = 0; n < npixels; n++)
+                copy[n] = source.value(start + n * stride);
+            this->textures[k] = create_texture(layout.width, layout.height, 1, GL_R32F, GL_FLOAT, copy.data());
+            this->components[k] = 0;
+        }
+        this->value_scale = 1.0f;
+    }
+    else
+    {
+        glPixelStorei(GL_UNPACK_SWAP_BYTES, layout.swap ? GL_TRUE : GL_FALSE);
+        const auto &format = formats[layout.dtype];
+        if (layout.planar)
+        {
+            // one texture per plane shown, straight from the mapping
+            for (int k = 0; k < outputs; k++)
+            {
+                int c = this->display.channels[k];
+                for (int j = 0; (j < k) && (this->textures[k] == 0); j++)
+                {
+                    if (this->display.channels[j] == c)
+                        this->textures[k] = this->textures[j];
+                }
+                if (this->textures[k] == 0)
+                    this->textures[k] = create_texture(layout.width, layout.height, 1, format.internal_formats[0], format.type, source.plane(c));
+                this->components[k] = 0;
+            }
+        }
+        else
+        {
+            // interleaved : a single texture with every channel
+            GLuint texture = create_texture(layout.width, layout.height, layout.channels, format.internal_formats[layout.channels - 1], format.type, source.plane(0));
+            for (int k = 0; k < outputs; k++)
+            {
+                this->textures[k] = texture;
+                this->components[k] = this->display.channels[k];
+            }
+        }
+        glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_FALSE);
+        this->value_scale = format.scale;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // gray : the three outputs read the same channel
+    for (int k = outputs; k < 3; k++)
+    {
+        this->textures[k] = this->textures[0];
+        this->components[k] = this->components[0];
+    }
+
+    if (this->display.auto_range)
+        this->auto_range(source);
+    return true;
+}
+
+bool ArrayView::upload_yuv(const video_frame_t &frame)
+{
+    this->release();
+    if (frame.planes[0] == nullptr)
+        return false;
+
+    // samples above 8 bits are 16 bits little endian values
+    uint16_t one = 1;
+    bool wide = (frame.depth > 8);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+#if defined(GL_UNPACK_ROW_LENGTH)
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+    glPixelStorei(GL_UNPACK_SWAP_BYTES, (wide && (*(unsigned char *)&one == 0)) ? GL_TRUE : GL_FALSE);
+    for (int k = 0; k < 3; k++)
+    {
+        if (frame.planes[k] == nullptr)
+            this->textures[k] = this->textures[0];
+        else
+            this->textures[k] = create_texture(frame.width[k], frame.height[k], 1, wide ? GL_R16 : GL_R8, wide ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE, frame.planes[k]);
+        this->components[k] = 0;
+    }
+    glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_FALSE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // y4m does not tell the matrix : the one of the usual standard for the resolution
+    if (frame.planes[1] == nullptr)
+        this->yuv = YUV_GRAY;
+    else
+        this->yuv = (frame.height[0] >= 720) ? YUV_BT709 : YUV_BT601;
+    this->yuv_scale = wide ? 65535.0f / (float)(1 << (frame.depth - 8)) : 255.0f;
+    return true;
+}
+
+void ArrayView::auto_range(ArraySource &source)
+{
+    for (int k = 0; k < (this->display.rgb ? 3 : 1); k++)
+        source.sample_range(this->display.channels[k], 0.01f, 0.99f, &this->display.low[k], &this->display.high[k]);
+}
+
+void ArrayView::begin(ImDrawList *draw_list)
+{
+    draw_list->AddCallback(ArrayView::render, this);
+}
+
+void ArrayView::end(ImDrawList *draw_list)
+{
+    draw_list->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+}
+
+void ArrayView::render(const ImDrawList *draw_list, const ImDrawCmd *cmd)
+{
+    (void)draw_list;
+    ArrayView *view = (ArrayView *)cmd->UserCallbackData;
+
+    // the ImGui program is current : the attribute locations of the vertices it set up are kept
+    GLint imgui_program = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &imgui_program);
+    if (!build_program(imgui_program))
+        return;
+    float proj[16];
+    gl_callback_setup(cmd, proj);
+
+    gl.UseProgram(program.id);
+    gl.UniformMatrix4fv(program.proj, 1, GL_FALSE, proj);
+    gl.Uniform3i(program.components, view->components[0], view->components[1], view->components[2]);
+
+    if (view->yuv != YUV_NONE)
+    {
+        // video range : black at 16 and white at 235 in 8 bits samples
+        static const float coefs[2][4] = {{1.402f, 0.344136f, 0.714136f, 1.772f}, {1.5748f, 0.187324f, 0.468124f, 1.8556f}};
+        const float *c = coefs[(view->yuv == YUV_BT709) ? 1 : 0];
+        bool gray = (view->yuv == YUV_GRAY);
+        float low = gray ? 16.0f / view->yuv_scale : 0.0f;
+        float high = gray ? 235.0f / view->yuv_scale : 1.0f;
+        gl.Uniform1i(program.yuv, gray ? 0 : 1);
+        gl.Uniform1f(program.yuv_scale, view->yuv_scale);
+        gl.Uniform4f(program.yuv_coefs, c[0], c[1], c[2], c[3]);
+        gl.Uniform3f(program.low, low, low, low);
+        gl.Uniform3f(program.high, high, high, high);
+        gl.Uniform1f(program.gamma, 1.0f);
+        gl.Uniform1i(program.gray, gray ? 1 : 0);
+    }
+    else
+    {
+        gl.Uniform1i(program.yuv, 0);
+
+        // range in the unit of the textures
+        int gray = view->display.rgb ? 0 : 1;
+        float low[3], high[3];
+        for (int k = 0; k < 3; k++)
+        {
+            low[k] = view->display.low[gray ? 0 : k] / view->value_scale;
+            high[k] = view->display.high[gray ? 0 : k] / view->value_scale;
+        }
+        gl.Uniform3f(program.low, low[0], low[1], low[2]);
+        gl.Uniform3f(program.high, high[0], high[1], high[2]);
+        gl.Uniform1f(program.gamma, std::max(0.01f, view->display.gamma));
+        gl.Uniform1i(program.gray, gray);
+    }
+
+    // unit 0 is bound again by ImGui to the texture of the image
+    for (int k = 2; k >= 0; k--)
+    {
+        gl.ActiveTexture(GL_TEXTURE0 + k);
+        glBindTexture(GL_TEXTURE_2D, view->textures[k]);
+    }
+}
@@ -0,0 +1,434 @@
+#include "yacvat/coco.h"
+#include "yacvat/image_info.h"
+#include "yacvat/version.h"
+#include "spdlog/spdlog.h"
+#include "nlohmann/json.hpp"
+
+#include <fstream>
+#include <unordered_map>
+#include <cstdio>
+
+// -- EXPORT
+
+static void write_string(std::ostream &os, const std::string &s)
+{
+    os.put('"');
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"':
+            os << "\\\"";
+            break;
+        case '\\':
+            os << "\\\\";
+            break;
+        case '\n':
+            os << "\\n";
+            break;
+        case '\r':
+            os << "\\r";
+            break;
+        case '\t':
+            os << "\\t";
+            break;
+        default:
+            if ((unsigned char)c < 0x20)
+            {
+                char _esc[8];
+                snprintf(_esc, sizeof(_esc), "\\u%04x", c);
+                os << _esc;
+            }
+            else
+            {
+                os.put(c);
+            }
+        }
+    }
+    os.put('"');
+}
+
+static void write_number(std::ostream &os, float v)
+{
+    char _num[32];
+    snprintf(_num, sizeof(_num), "%.2f", v);
+    os << _num;
+}
+
+bool coco_export(const std::string &fname, const std::string &images_folder, const std::vector<std::string> &image_files, std::vector<Annotation> &annotations, float scale)
+{
+    spdlog::info("Exporting COCO file : {}", fname.c_str());
+
+    // large buffer : the file is written in one pass
+    std::vector<char> buffer(1 << 20);
+    std::ofstream f;
+    f.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    f.open(fname.c_str(), std::ios::out | std::ios::trunc);
+    if (!f.good())
+    {
+        spdlog::error("Cannot open file for writing : {}", fname.c_str());
+        return false;
+    }
+
+    // ids of the images : files of the folder first, then files only known from their annotations
+    std::vector<std::string> images(image_files);
+    std::unordered_map<std::string, long> image_ids;
+    for (long unsigned n = 0; n < images.size(); n++)
+        image_ids[images[n]] = n + 1;
+
+    for (auto &annotation : annotations)
+    {
+        for (auto &instance : annotation.inst)
+        {
+            if (image_ids.find(instance.img_fname) == image_ids.end())
+            {
+                images.push_back(instance.img_fname);
+                image_ids[instance.img_fname] = images.size();
+            }
+        }
+    }
+
+    f << "{\n\"info\": {\"description\": \"YACVAT export\", \"version\": \"" << YACVAT_VER_MAJOR << "." << YACVAT_VER_MINOR << "." << YACVAT_VER_PATCH << "\"},\n";
+
+    // images
+    f << "\"images\": [";
+    for (long unsigned n = 0; n < images.size(); n++)
+    {
+        int width, height;
+        probe_image_size(images_folder + "/" + images[n], &width, &height);
+
+        f << (n ? ",\n" : "\n") << "{\"id\": " << n + 1 << ", \"file_name\": ";
+        write_string(f, images[n]);
+        f << ", \"width\": " << width << ", \"height\": " << height << "}";
+    }
+    f << "\n],\n";
+
+    // categories
+    f << "\"categories\": [";
+    for (long unsigned n = 0; n < annotations.size(); n++)
+    {
+        f << (n ? ",\n" : "\n") << "{\"id\": " << n + 1 << ", \"name\": ";
+        write_string(f, annotations[n].label);
+        f << ", \"supercategory\": \"\"";
+        if (annotations[n].type == ANNOTATION_TYPE_POINT)
+            f << ", \"keypoints\": [\"point\"], \"skeleton\": []";
+        f << "}";
+    }
+    f << "\n],\n";
+
+    // annotations
+    long id = 0;
+    f << "\"annotations\": [";
+    for (long unsigned n = 0; n < annotations.size(); n++)
+    {
+        for (auto &instance : annotations[n].inst)
+        {
+            f << (id ? ",\n" : "\n") << "{\"id\": " << id + 1 << ", \"image_id\": " << image_ids[instance.img_fname] << ", \"category_id\": " << n + 1;
+
+            if (annotations[n].type == ANNOTATION_TYPE_POINT)
+            {
+                vec2f _c = instance.rect_on_image.get_center() / scale;
+                f << ", \"bbox\": [";
+                write_number(f, _c.x);
+                f << ", ";
+                write_number(f, _c.y);
+                f << ", 0, 0], \"area\": 0, \"keypoints\": [";
+                write_number(f, _c.x);
+                f << ", ";
+                write_number(f, _c.y);
+                f << ", 2], \"num_keypoints\": 1";
+            }
+            else
+            {
+                vec2f _tl = instance.rect_on_image.get_topleft_vertex() / scale;
+                vec2f _br = instance.rect_on_image.get_bottomright_vertex() / scale;
+                f << ", \"bbox\": [";
+                write_number(f, _tl.x);
+                f << ", ";
+                write_number(f, _tl.y);
+                f << ", ";
+                write_number(f, _br.x - _tl.x);
+                f << ", ";
+                write_number(f, _br.y - _tl.y);
+                f << "], \"area\": ";
+                write_number(f, (_br.x - _tl.x) * (_br.y - _tl.y));
+            }
+            f << ", \"iscrowd\": 0}";
+            id++;
+        }
+    }
+    f << "\n]\n}\n";
+
+    f.close();
+    if (f.fail())
+    {
+        spdlog::error("Cannot write file : {}", fname.c_str());
+        return false;
+    }
+
+    spdlog::info("COCO export : {} images, {} categories, {} annotations", images.size(), annotations.size(), id);
+    return true;
+}
+
+// -- IMPORT
+
+typedef struct
+{
+    long long image_id;    // id of the image in the coco file
+    long long category_id; // id of the category in the coco file
+    float box[4];          // x_start, y_start, x_end, y_end (pixels)
+} coco_pending_t;
+
+/*
+SAX handler : the document is a top level object (depth 1) with sections "images", "categories" and
+"annotations" which are arrays (depth 2) of objects (depth 3). Only the fields of interest of the
+current element are kept, and the element is processed as soon as its object ends.
+*/
+class CocoSaxHandler : public nlohmann::json_sax<nlohmann::json>
+{
+public:
+    CocoSaxHandler(std::vector<Annotation> &annotations, std::map<std::string, int> &ninstperimage, float scale)
+        : annotations(annotations), ninstperimage(ninstperimage), scale(scale), depth(0), count(0)
+    {
+        this->reset_element();
+    }
+
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t val) override { return this->number((double)val); }
+    bool number_unsigned(number_unsigned_t val) override { return this->number((double)val); }
+    bool number_float(number_float_t val, const string_t &) override { return this->number((double)val); }
+    bool binary(binary_t &) override { return true; }
+
+    bool string(string_t &val) override
+    {
+        if (this->depth == 3)
+        {
+            if ((this->field == "file_name") || (this->field == "name"))
+                this->name = val;
+        }
+        else if ((this->depth == 4) && (this->field == "keypoints"))
+        {
+            // list of keypoint names of a category
+            this->has_keypoints = true;
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) override
+    {
+        this->depth++;
+        if (this->depth == 3)
+            this->reset_element();
+        return true;
+    }
+
+    bool end_object() override
+    {
+        if (this->depth == 3)
+            this->process_element();
+        this->depth--;
+        return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+        this->depth++;
+        return true;
+    }
+
+    bool end_array() override
+    {
+        this->depth--;
+        return true;
+    }
+
+    bool key(string_t &val) override
+    {
+        if (this->depth == 1)
+            this->section = val;
+        else if (this->depth == 3)
+            this->field = val;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string &, const nlohmann::detail::exception &ex) override
+    {
+        spdlog::error("COCO parse error at byte {} : {}", position, ex.what());
+        return false;
+    }
+
+    void finalize(void)
+    {
+        // annotations found before their image or category
+        for (auto &p : this->pending)
+        {
+            if (!this->add_instance(p.image_id, p.category_id, p.box))
+                spdlog::warn("COCO annotation with unknown image {} or category {}", p.image_id, p.category_id);
+        }
+        this->pending.clear();
+
+        spdlog::info("COCO import : {} images, {} categories, {} annotations", this->image_names.size(), this->category_index.size(), this->count);
+    }
+
+private:
+    std::vector<Annotation> &annotations;
+    std::map<std::string, int> &ninstperimage;
+    float scale;
+
+    int depth;                                              // nesting level of the current value
+    std::string section;                                    // top level key being parsed
+    std::string field;                                      // key of the current element
+    std::unordered_map<long long, std::string> image_names; // coco id -> file name
+    std::unordered_map<long long, size_t> category_index;   // coco id -> index in the annotations
+    std::vector<coco_pending_t> pending;                    // annotations waiting for their image or category
+    long count;                                             // number of instances imported
+
+    // current element
+    long long id, image_id, category_id;
+    std::string name;
+    float bbox[4];
+    int nbbox;
+    float keypoint[2];
+    int nkeypoint;
+    bool has_keypoints;
+
+    void reset_element(void)
+    {
+        this->field.clear();
+        this->name.clear();
+        this->id = this->image_id = this->category_id = -1;
+        this->nbbox = 0;
+        this->nkeypoint = 0;
+        this->has_keypoints = false;
+    }
+
+    bool number(double val)
+    {
+        if (this->depth == 3)
+        {
+            if (this->field == "id")
+                this->id = (long long)val;
+            else if (this->field == "image_id")
+                this->image_id = (long long)val;
+            else if (this->field == "category_id")
+                this->category_id = (long long)val;
+        }
+        else if (this->depth == 4)
+        {
+            if ((this->field == "bbox") && (this->nbbox < 4))
+                this->bbox[this->nbbox++] = val;
+            else if ((this->field == "keypoints") && (this->nkeypoint < 2))
+                this->keypoint[this->nkeypoint++] = val;
+        }
+        return true;
+    }
+
+    void process_element(void)
+    {
+        if (this->section == "images")
+        {
+            this->image_names[this->id] = this->name;
+        }
+        else if (this->section == "categories")
+        {
+            Annotation _ann = Annotation(this->name);
+            _ann.type = this->has_keypoints ? ANNOTATION_TYPE_POINT : ANNOTATION_TYPE_AREA;
+            _ann.selected = false;
+            this->category_index[this->id] = this->annotations.size();
+            this->annotations.push_back(_ann);
+        }
+        else if (this->section == "annotations")
+        {
+            float box[4];
+            if (this->nkeypoint == 2)
+            {
+                box[0] = box[2] = this->keypoint[0];
+                box[1] = box[3] = this->keypoint[1];
+            }
+            else if (this->nbbox == 4)
+            {
+                box[0] = this->bbox[0];
+                box[1] = this->bbox[1];
+                box[2] = this->bbox[0] + this->bbox[2];
+                box[3] = this->bbox[1] + this->bbox[3];
+            }
+            else
+            {
+                return;
+            }
+
+            if (!this->add_instance(this->image_id, this->category_id, box))
+            {
+                coco_pending_t _p;
+                _p.image_id = this->image_id;
+                _p.category_id = this->category_id;
+                for (int k = 0; k < 4; k++)
+                    _p.box[k] = box[k];
+                this->pending.push_back(_p);
+            }
+        }
+    }
+
+    bool add_instance(long long img_id, long long cat_id, const float box[4])
+    {
+        auto img = this->image_names.find(img_id);
+        auto cat = this->category_index.find(cat_id);
+        if ((img == this->image_names.end()) || (cat == this->category_index.end()))
+            return false;
+
+        Annotation &ann = this->annotations[cat->second];
+
+        AnnotationInstance _inst;
+        _inst.img_fname = img->second;
+        this->ninstperimage[_inst.img_fname] = this->ninstperimage[_inst.img_fname] + 1;
+
+        if (ann.type == ANNOTATION_TYPE_POINT)
+        {
+            // same footprint on screen as a point created with the mouse
+            _inst.rect_on_image.set_center(vec2f(box[0] * this->scale, box[1] * this->scale));
+            _inst.rect_on_image.set_span(vec2f(10, 10));
+        }
+        else
+        {
+            _inst.rect_on_image.set_bottomright_vertex(vec2f(box[2] * this->scale, box[3] * this->scale));
+            _inst.rect_on_image.set_topleft_vertex(vec2f(box[0] * this->scale, box[1] * this->scale));
+        }
+
+        _inst.set_color(ann.color);
+        _inst.status_fsm.execute("from_create_to_idle");
+        _inst.hover_fsm.execute("from_hover_to_outside");
+        _inst.selected = false;
+
+        ann.inst.push_back(_inst);
+        this->count++;
+        return true;
+    }
+};
+
+bool coco_import(const std::string &fname, std::vector<Annotation> &annotations, std::map<std::string, int> &ninstperimage, float scale)
+{
+    spdlog::info("Importing COCO file : {}", fname.c_str());
+
+    std::ifstream f(fname.c_str(), std::ios::in | std::ios::binary);
+    if (!f.good())
+    {
+        spdlog::error("Cannot open file : {}", fname.c_str());
+        return false;
+    }
+
+    // parsed aside : the current annotations are replaced only by a complete document
+    std::vector<Annotation> parsed;
+    std::map<std::string, int> counts;
+    CocoSaxHandler handler(parsed, counts, scale);
+    if (!nlohmann::json::sax_parse(f, &handler))
+    {
+        spdlog::error("COCO file {} is not complete : the annotations are left unchanged", fname.c_str());
+        return false;
+    }
+    handler.finalize();
+
+    annotations.swap(parsed);
+    ninstperimage.swap(counts);
+    return true;
+}
@@ -0,0 +1,127 @@
+#include "yacvat/crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_HAS_SSE42_PATH
+#endif
+
+static const uint32_t CRC32C_POLY = 0x82f63b78; // reversed Castagnoli polynomial
+
+// slicing-by-8 : table[k][b] is the crc of byte b followed by k zero bytes
+static uint32_t crc_table[8][256];
+
+static bool init_tables(void)
+{
+    for (uint32_t b = 0; b < 256; b++)
+    {
+        uint32_t crc = b;
+        for (int k = 0; k < 8; k++)
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        crc_table[0][b] = crc;
+    }
+
+    for (uint32_t b = 0; b < 256; b++)
+    {
+        for (int k = 1; k < 8; k++)
+            crc_table[k][b] = (crc_table[k - 1][b] >> 8) ^ crc_table[0][crc_table[k - 1][b] & 0xff];
+    }
+
+    return true;
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t n)
+{
+    static const bool tables_ready = init_tables();
+    (void)tables_ready;
+
+    // align on 8 bytes
+    while ((n > 0) && ((uintptr_t)p & 7))
+    {
+        crc = crc_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        n--;
+    }
+
+    // 8 bytes per step (little endian)
+    while (n >= 8)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        v ^= crc;
+        crc = crc_table[7][v & 0xff] ^ crc_table[6][(v >> 8) & 0xff] ^
+              crc_table[5][(v >> 16) & 0xff] ^ crc_table[4][(v >> 24) & 0xff] ^
+              crc_table[3][(v >> 32) & 0xff] ^ crc_table[2][(v >> 40) & 0xff] ^
+              crc_table[1][(v >> 48) & 0xff] ^ crc_table[0][v >> 56];
+        p += 8;
+        n -= 8;
+    }
+
+    while (n > 0)
+    {
+        crc = crc_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        n--;
+    }
+
+    return crc;
+}
+
+#ifdef CRC32C_HAS_SSE42_PATH
+__attribute__((target("sse4.2"))) static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t n)
+{
+    while ((n > 0) && ((uintptr_t)p & 7))
+    {
+        crc = _mm_crc32_u8(crc, *p++);
+        n--;
+    }
+
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (n >= 8)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc64 = _mm_crc32_u64(crc64, v);
+        p += 8;
+        n -= 8;
+    }
+    crc = (uint32_t)crc64;
+#endif
+
+    while (n > 0)
+    {
+        crc = _mm_crc32_u8(crc, *p++);
+        n--;
+    }
+
+    return crc;
+}
+
+static bool has_sse42(void)
+{
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+}
+#endif
+
+uint32_t crc32c_extend(uint32_t crc, const void *data, size_t length)
+{
+    const unsigned char *p = (const unsigned char *)data;
+
+#ifdef CRC32C_HAS_SSE42_PATH
+    if (has_sse42())
+        return ~crc32c_hw(~crc, p, length);
+#endif
+
+    return ~crc32c_sw(~crc, p, length);
+}
+
+uint32_t crc32c(const void *data, size_t length)
+{
+    return crc32c_extend(0, data, length);
+}
+
+uint32_t crc32c_mask(uint32_t crc)
+{
+    return ((crc >> 15) | (crc << 17)) + 0xa282ead8u;
+}
@@ -0,0 +1,104 @@
+#include "yacvat/decode_ahead.h"
+#include "spdlog/spdlog.h"
+#include "stb_image.h"
+
+static const size_t MAX_IMAGES = 4; // images held at a time (decoded or in progress)
+
+DecodeAhead::state_s::~state_s(void)
+{
+    for (auto &image : this->images)
+    {
+        if (image.second.pixels != nullptr)
+            stbi_image_free(image.second.pixels);
+    }
+}
+
+DecodeAhead::DecodeAhead(void)
+{
+    this->state = std::make_shared<state_t>();
+}
+
+DecodeAhead::~DecodeAhead(void)
+{
+    this->clear();
+}
+
+bool DecodeAhead::request(ThreadPool &pool, const std::string &fname)
+{
+    std::shared_ptr<state_t> state = this->state;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->images.count(fname) > 0)
+            return true;
+        if (state->images.size() >= MAX_IMAGES)
+            return false;
+        entry_t &entry = state->images[fname];
+        entry.done = false;
+        entry.pixels = nullptr;
+        entry.width = 0;
+        entry.height = 0;
+    }
+
+    pool.submit([state, fname]()
+                {
+        int width = 0, height = 0;
+        unsigned char *pixels = stbi_load(fname.c_str(), &width, &height, NULL, 4);
+        if (pixels == nullptr)
+            spdlog::debug("Cannot decode ahead : {}", fname.c_str());
+
+        // after a clear() the state is only held by the tasks : the last one frees the pixels
+        std::lock_guard<std::mutex> lock(state->mutex);
+        auto i = state->images.find(fname);
+        if ((i == state->images.end()) || i->second.done)
+        {
+            // forgotten in the meantime (or requested again and decoded by another task)
+            if (pixels != nullptr)
+                stbi_image_free(pixels);
+            return;
+        }
+        i->second.done = true;
+        i->second.pixels = pixels;
+        i->second.width = width;
+        i->second.height = height;
+        state->decoded.notify_all(); });
+    return true;
+}
+
+bool DecodeAhead::take(const std::string &fname, unsigned char **pixels, int *width, int *height, bool wait)
+{
+    std::shared_ptr<state_t> state = this->state;
+    std::unique_lock<std::mutex> lock(state->mutex);
+    auto i = state->images.find(fname);
+    if ((i == state->images.end()) || (!wait && !i->second.done))
+        return false;
+
+    // the decode in progress is sooner done than a new one
+    while (!i->second.done)
+    {
+        state->decoded.wait(lock);
+        i = state->images.find(fname);
+    }
+
+    *pixels = i->second.pixels;
+    *width = i->second.width;
+    *height = i->second.height;
+    state->images.erase(i);
+    return true;
+}
+
+void DecodeAhead::forget(const std::string &fname)
+{
+    std::lock_guard<std::mutex> lock(this->state->mutex);
+    auto i = this->state->images.find(fname);
+    if (i == this->state->images.end())
+        return;
+    if (i->second.pixels != nullptr)
+        stbi_image_free(i->second.pixels);
+    this->state->images.erase(i);
+}
+
+void DecodeAhead::clear(void)
+{
+    // the tasks in progress keep the previous state alive until they are done
+    this->state = std::make_shared<state_t>();
+}
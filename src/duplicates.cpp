@@ -0,0 +1,420 @@
+#include "yacvat/duplicates.h"
+#include "yacvat/video_source.h"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+static const size_t IMAGES_PER_CHUNK = 16;   // images hashed by a task
+static const uint32_t FRAMES_PER_CHUNK = 64; // frames of a video hashed by a task
+static const int64_t SAVE_INTERVAL = 10000;  // ms between two saves of the hashes
+static const int NEAR_DISTANCE = 6;          // largest sum of the distances of the perceptual hashes of similar images
+static const size_t BUCKET_MAX = 64;         // larger buckets of a band are split by a second band before their pairs are compared
+static_assert(NEAR_DISTANCE <= 6, "similar hashes must share 2 of the 8 bands for the search to find every pair");
+
+static int64_t now_ms(void)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// union find over the entries
+static uint32_t find_root(std::vector<uint32_t> &parent, uint32_t n)
+{
+    while (parent[n] != n)
+    {
+        parent[n] = parent[parent[n]];
+        n = parent[n];
+    }
+    return n;
+}
+
+static void unite(std::vector<uint32_t> &parent, uint32_t a, uint32_t b)
+{
+    a = find_root(parent, a);
+    b = find_root(parent, b);
+    if (a != b)
+        parent[std::max(a, b)] = std::min(a, b);
+}
+
+DuplicateFinder::DuplicateFinder(void)
+{
+}
+
+DuplicateFinder::~DuplicateFinder(void)
+{
+    this->cancel();
+}
+
+void DuplicateFinder::start(ThreadPool &pool, std::string folder, std::shared_ptr<const DatasetManifest> listing, std::string manifest_fname, uint64_t extensions_hash)
+{
+    this->cancel();
+    this->entries.clear();
+    this->infos.clear();
+    if (!listing)
+        return;
+
+    this->job = std::make_shared<job_t>();
+    this->job->folder = folder;
+    this->job->manifest_fname = manifest_fname;
+    this->job->extensions_hash = extensions_hash;
+    this->job->saving = false;
+    this->job->last_save = now_ms();
+    this->job->pending = 0;
+    this->job->done = 0;
+    this->job->total = 0;
+    this->job->cancel_flag = false;
+    this->job->done_flag = false;
+
+    std::shared_ptr<job_t> _job = this->job;
+    ThreadPool *_pool = &pool;
+    pool.submit([_job, _pool, listing]()
+                { DuplicateFinder::plan(_job, _pool, listing); });
+}
+
+void DuplicateFinder::cancel(void)
+{
+    if (this->job)
+        this->job->cancel_flag = true;
+    this->job.reset();
+}
+
+bool DuplicateFinder::running(void)
+{
+    return this->job && !this->job->done_flag;
+}
+
+void DuplicateFinder::progress(long *done, long *total)
+{
+    *done = this->job ? this->job->done.load() : 0;
+    *total = this->job ? this->job->total.load() : 0;
+}
+
+bool DuplicateFinder::poll(void)
+{
+    if (!this->job || !this->job->done_flag)
+        return false;
+
+    this->entries.swap(this->job->entries);
+    this->infos.swap(this->job->infos);
+    this->job.reset();
+    return true;
+}
+
+int DuplicateFinder::cluster(const std::string &entry, duplicate_cluster_t *info)
+{
+    auto it = this->entries.find(entry);
+    if (it == this->entries.end())
+        return 0;
+    if (info != nullptr)
+        *info = this->infos[it->second - 1];
+    return it->second;
+}
+
+void DuplicateFinder::plan(std::shared_ptr<job_t> job, ThreadPool *pool, std::shared_ptr<const DatasetManifest> listing)
+{
+    // a copy : the tasks of the scan and the ui keep reading the listing
+    job->manifest = *listing;
+
+    std::vector<std::shared_ptr<chunk_t>> chunks;
+    std::shared_ptr<chunk_t> images = std::make_shared<chunk_t>();
+    long total = 0;
+    for (uint32_t d = 0; d < job->manifest.dirs.size(); d++)
+    {
+        std::vector<manifest_file_t> &files = job->manifest.dirs[d].files;
+        for (uint32_t n = 0; n < files.size(); n++)
+        {
+            manifest_file_t &f = files[n];
+            if (!f.supported)
+                continue;
+
+            // one hash per entry of the list, the missing ones are zeroed
+            size_t count = std::max((uint32_t)1, f.frames);
+            if (f.hashes.size() != count)
+                f.hashes.assign(count, image_hash_t());
+
+            if (f.frames == 0)
+            {
+                if (f.hashes[0].flags != 0)
+                    continue;
+                images->items.push_back({d, n, 0, 1});
+                total++;
+                if (images->items.size() >= IMAGES_PER_CHUNK)
+                {
+                    chunks.push_back(images);
+                    images = std::make_shared<chunk_t>();
+                }
+                continue;
+            }
+
+            // runs of frames without hashes, split so that a long video is spread over every thread
+            for (uint32_t first = 0; first < f.frames;)
+            {
+                if (f.hashes[first].flags != 0)
+                {
+                    first++;
+                    continue;
+                }
+                uint32_t last = first;
+                while ((last < f.frames) && (last - first < FRAMES_PER_CHUNK) && (f.hashes[last].flags == 0))
+                    last++;
+                std::shared_ptr<chunk_t> frames = std::make_shared<chunk_t>();
+                frames->items.push_back({d, n, first, last - first});
+                chunks.push_back(frames);
+                total += last - first;
+                first = last;
+            }
+        }
+    }
+    if (!images->items.empty())
+        chunks.push_back(images);
+
+    spdlog::info("Duplicates : {} images to hash", total);
+    job->total = total;
+    if (chunks.empty())
+    {
+        if (!job->cancel_flag)
+            DuplicateFinder::find_clusters(job);
+        job->done_flag = true;
+        return;
+    }
+
+    // counted before any of them can end
+    job->pending = chunks.size();
+    for (auto &chunk : chunks)
+    {
+        pool->submit([job, chunk]()
+                     { DuplicateFinder::hash_chunk(job, chunk); });
+    }
+}
+
+void DuplicateFinder::hash_chunk(std::shared_ptr<job_t> job, std::shared_ptr<chunk_t> chunk)
+{
+    for (auto &item : chunk->items)
+    {
+        if (job->cancel_flag)
+            break;
+
+        // names only are read : the hashes of the manifest are written by the task which saves
+        const manifest_dir_t &dir = job->manifest.dirs[item.dir];
+        std::string fname = job->folder + "/" + manifest_join(dir.path, dir.files[item.file].name);
+        image_hash_t hash;
+        if (dir.files[item.file].frames == 0)
+        {
+            if (!hash_image_file(fname, &hash))
+                hash.flags = 0;
+            chunk->hashes.push_back(hash);
+        }
+        else
+        {
+            VideoSource video;
+            bool ok = video.open(fname);
+            for (uint32_t k = item.first; k < item.first + item.count; k++)
+            {
+                video_frame_t frame;
+                if (ok && video.frame(k, &frame))
+                    hash_video_frame(frame, &hash);
+                else
+                    hash.flags = 0;
+                chunk->hashes.push_back(hash);
+            }
+        }
+        job->done += item.count;
+    }
+
+    // a chunk cut by a cancellation is dropped, it is hashed again next time
+    if (!job->cancel_flag)
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->finished.push_back(std::move(*chunk));
+    }
+    DuplicateFinder::finish_chunk(job);
+}
+
+void DuplicateFinder::finish_chunk(std::shared_ptr<job_t> &job)
+{
+    if (--job->pending == 0)
+    {
+        // the last chunk : after the save in progress if any
+        while (job->saving.exchange(true))
+            std::this_thread::yield();
+        DuplicateFinder::save(job);
+        if (!job->cancel_flag)
+        {
+            DuplicateFinder::find_clusters(job);
+            job->done_flag = true;
+        }
+        job->saving = false;
+        return;
+    }
+
+    if ((now_ms() - job->last_save >= SAVE_INTERVAL) && !job->saving.exchange(true))
+    {
+        DuplicateFinder::save(job);
+        job->saving = false;
+    }
+}
+
+void DuplicateFinder::save(std::shared_ptr<job_t> &job)
+{
+    // a cancelled job holds the listing of an older scan : the manifest is left to the scan that replaced it
+    if (job->cancel_flag)
+        return;
+
+    std::vector<chunk_t> finished;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        finished.swap(job->finished);
+    }
+    job->last_save = now_ms();
+    if (finished.empty())
+        return;
+
+    long saved = 0;
+    for (auto &chunk : finished)
+    {
+        size_t h = 0;
+        for (auto &item : chunk.items)
+        {
+            std::vector<image_hash_t> &hashes = job->manifest.dirs[item.dir].files[item.file].hashes;
+            for (uint32_t k = 0; (k < item.count) && (h < chunk.hashes.size()); k++)
+                hashes[item.first + k] = chunk.hashes[h++];
+            saved += item.count;
+        }
+    }
+
+    spdlog::debug("Duplicates : saving the hashes of {} images", saved);
+    job->manifest.write(job->manifest_fname, job->extensions_hash);
+}
+
+void DuplicateFinder::find_clusters(std::shared_ptr<job_t> &job)
+{
+    // every entry of the list with its hashes
+    std::vector<std::string> names;
+    std::vector<const image_hash_t *> hashes;
+    for (auto &dir : job->manifest.dirs)
+    {
+        for (auto &f : dir.files)
+        {
+            if (!f.supported)
+                continue;
+            std::vector<std::string> entries;
+            manifest_entries(manifest_join(dir.path, f.name), f, entries);
+            for (size_t k = 0; (k < entries.size()) && (k < f.hashes.size()); k++)
+            {
+                if ((f.hashes[k].flags & HASH_CONTENT) == 0)
+                    continue;
+                names.push_back(std::move(entries[k]));
+                hashes.push_back(&f.hashes[k]);
+            }
+        }
+    }
+
+    std::vector<uint32_t> parent(names.size());
+    std::vector<uint32_t> order(names.size());
+    for (uint32_t n = 0; n < parent.size(); n++)
+        parent[n] = n;
+
+    // identical : runs of the same content hash
+    for (uint32_t n = 0; n < order.size(); n++)
+        order[n] = n;
+    std::sort(order.begin(), order.end(), [&hashes](uint32_t a, uint32_t b)
+              { return hashes[a]->content < hashes[b]->content; });
+    for (size_t n = 1; n < order.size(); n++)
+    {
+        if (hashes[order[n]]->content == hashes[order[n - 1]]->content)
+            unite(parent, order[n], order[n - 1]);
+    }
+
+    // similar : the entries with the same perceptual hashes are united first, one of them stands for the others
+    order.clear();
+    for (uint32_t n = 0; n < names.size(); n++)
+    {
+        if (hashes[n]->flags & HASH_PERCEPTUAL)
+            order.push_back(n);
+    }
+    std::sort(order.begin(), order.end(), [&hashes](uint32_t a, uint32_t b)
+              { return (hashes[a]->ahash < hashes[b]->ahash) || ((hashes[a]->ahash == hashes[b]->ahash) && (hashes[a]->dhash < hashes[b]->dhash)); });
+    size_t unique = 0;
+    for (size_t n = 0; n < order.size(); n++)
+    {
+        if ((unique > 0) && (hashes[order[n]]->ahash == hashes[order[unique - 1]]->ahash) && (hashes[order[n]]->dhash == hashes[order[unique - 1]]->dhash))
+            unite(parent, order[n], order[unique - 1]);
+        else
+            order[unique++] = order[n];
+    }
+    order.resize(unique);
+
+    // two hashes NEAR_DISTANCE (< 8) bits apart share at least 2 of the 8 bands of 16 bits : the pairs of every bucket
+    // of a band are compared, a large bucket is split by each of the other bands first, so no pair under the threshold is missed
+    auto similar = [&hashes](uint32_t a, uint32_t b)
+    { return hash_distance(hashes[a]->ahash, hashes[b]->ahash) + hash_distance(hashes[a]->dhash, hashes[b]->dhash) <= NEAR_DISTANCE; };
+    auto band_key = [&hashes](uint32_t n, int band)
+    { return ((band < 4 ? hashes[n]->ahash : hashes[n]->dhash) >> (16 * (band % 4))) & 0xffff; };
+    auto compare_buckets = [&parent, &similar, &band_key](std::vector<uint32_t> &entries, int band, size_t bucket_max, std::vector<std::pair<size_t, size_t>> &large)
+    {
+        std::sort(entries.begin(), entries.end(), [&band_key, band](uint32_t a, uint32_t b)
+                  { return band_key(a, band) < band_key(b, band); });
+        for (size_t start = 0; start < entries.size();)
+        {
+            size_t end = start + 1;
+            while ((end < entries.size()) && (band_key(entries[end], band) == band_key(entries[start], band)))
+                end++;
+            if (end - start > bucket_max)
+            {
+                large.push_back(std::make_pair(start, end));
+            }
+            else
+            {
+                for (size_t i = start; i < end; i++)
+                {
+                    for (size_t j = i + 1; j < end; j++)
+                    {
+                        if ((find_root(parent, entries[i]) != find_root(parent, entries[j])) && similar(entries[i], entries[j]))
+                            unite(parent, entries[i], entries[j]);
+                    }
+                }
+            }
+            start = end;
+        }
+    };
+    for (int band = 0; band < 8; band++)
+    {
+        std::vector<std::pair<size_t, size_t>> large, unused;
+        compare_buckets(order, band, BUCKET_MAX, large);
+        for (auto &bucket : large)
+        {
+            for (int second = 0; second < 8; second++)
+            {
+                if (second == band)
+                    continue;
+                std::vector<uint32_t> entries(order.begin() + bucket.first, order.begin() + bucket.second);
+                compare_buckets(entries, second, SIZE_MAX, unused);
+            }
+        }
+    }
+
+    // clusters of at least 2 entries, numbered in the order of the listing
+    std::vector<uint32_t> sizes(names.size(), 0);
+    for (uint32_t n = 0; n < names.size(); n++)
+        sizes[find_root(parent, n)]++;
+    std::vector<uint32_t> number(names.size(), 0);
+    job->entries.clear();
+    job->infos.clear();
+    for (uint32_t n = 0; n < names.size(); n++)
+    {
+        uint32_t root = find_root(parent, n);
+        if (sizes[root] < 2)
+            continue;
+        if (number[root] == 0)
+        {
+            job->infos.push_back({sizes[root], true});
+            number[root] = job->infos.size();
+        }
+        duplicate_cluster_t &info = job->infos[number[root] - 1];
+        info.exact = info.exact && (hashes[n]->content == hashes[root]->content);
+        job->entries[names[n]] = number[root];
+    }
+
+    spdlog::info("Duplicates : {} clusters over {} images", job->infos.size(), job->entries.size());
+}
@@ -0,0 +1,106 @@
+#include "yacvat/files.h"
+#include "spdlog/spdlog.h"
+
+#include <fstream>
+#include <atomic>
+#include <cstdio>
+#include <cerrno>
+#include <cctype>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+bool file_exists(const std::string &fname)
+{
+    struct stat st;
+    return stat(fname.c_str(), &st) == 0;
+}
+
+bool make_directories(const std::string &path)
+{
+    if (path.empty())
+        return true;
+
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0)
+        return S_ISDIR(st.st_mode);
+
+    // create parents first
+    if (!make_directories(parent_directory(path)))
+        return false;
+
+    // another process may have created it in the meantime
+    if ((mkdir(path.c_str(), 0755) != 0) && (errno != EEXIST))
+    {
+        spdlog::error("Cannot create directory : {}", path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+std::string parent_directory(const std::string &fname)
+{
+    size_t pos = fname.find_last_of('/');
+    if ((pos == std::string::npos) || (pos == 0))
+        return "";
+    return fname.substr(0, pos);
+}
+
+std::string file_extension(const std::string &fname)
+{
+    size_t slash = fname.find_last_of('/');
+    size_t dot = fname.find_last_of('.');
+    if ((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash)))
+        return "";
+    std::string ext = fname.substr(dot + 1);
+    for (auto &c : ext)
+        c = ::tolower((unsigned char)c);
+    return ext;
+}
+
+bool write_file_atomic(const std::string &fname, const std::string &content)
+{
+    // the temp file is unique to this process and to this call : neither several instances of the tool nor
+    // several threads writing the same file (a background job and a new scan) ever write in the same temp file
+    static std::atomic<unsigned long> calls(0);
+    std::string tmp_fname = fname + ".tmp" + std::to_string(getpid()) + "-" + std::to_string(calls++);
+
+    {
+        std::ofstream f(tmp_fname.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!f.good())
+        {
+            spdlog::error("Cannot open file for writing : {}", tmp_fname.c_str());
+            return false;
+        }
+        f << content;
+        f.close();
+        if (f.fail())
+        {
+            spdlog::error("Cannot write file : {}", tmp_fname.c_str());
+            std::remove(tmp_fname.c_str());
+            return false;
+        }
+    }
+
+    // rename is atomic : readers see either the old or the new file, never a partial one
+    if (std::rename(tmp_fname.c_str(), fname.c_str()) != 0)
+    {
+        spdlog::error("Cannot rename {} to {}", tmp_fname.c_str(), fname.c_str());
+        std::remove(tmp_fname.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void prefetch_file(const std::string &fname)
+{
+    // the reads go on in the background once the call returns, the descriptor can be closed
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    ::close(fd);
+}
@@ -0,0 +1,174 @@
+#include "yacvat/font_atlas.h"
+#include "yacvat/IconsFontAwesome4.h"
+#include "yacvat/notofont.h"
+#include "yacvat/fontawesome.h"
+#include "spdlog/spdlog.h"
+
+#include <cstring>
+#include <stdint.h>
+
+static const char MAGIC[8] = {'Y', 'C', 'V', 'T', 'F', 'N', 'T', '2'};
+
+typedef struct
+{
+    char magic[8];
+    uint32_t imgui_version; // IMGUI_VERSION_NUM of the bake
+    uint32_t glyph_size;    // sizeof(ImFontGlyph) of the bake
+    uint32_t lines;         // entries of TexUvLines
+    uint32_t fonts;
+    int32_t width;          // of the texture
+    int32_t height;
+    float white[2];         // uv of the white pixel
+} atlas_header_t;
+
+typedef struct
+{
+    float size;
+    float ascent;
+    float descent;
+    uint32_t fallback_char;
+    uint32_t ellipsis_char;
+    uint32_t dot_char;       // drawn three times when the font has no ellipsis (ImGui 1.89.0 and before)
+    int32_t ellipsis_count;  // dots of the ellipsis, its width and the step between the dots (later versions)
+    float ellipsis_width;
+    float ellipsis_step;
+    uint32_t glyphs;
+} font_header_t;
+
+void font_atlas_add_fonts(ImFontAtlas *atlas)
+{
+    // basic font
+    atlas->AddFontFromMemoryCompressedTTF(NotoFont_compressed_data, NotoFont_compressed_size, 18.0f);
+
+    // merge in icons from Font Awesome
+    static const ImWchar icons_ranges[] = {ICON_MIN_FA, ICON_MAX_16_FA, 0};
+    ImFontConfig icons_config;
+    icons_config.MergeMode = true;
+    icons_config.PixelSnapH = true;
+    atlas->AddFontFromMemoryCompressedTTF(fontawesome_webfont_compressed_data, fontawesome_webfont_compressed_size, 16.0f, &icons_config, icons_ranges);
+}
+
+static void append(std::vector<unsigned char> &blob, const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    blob.insert(blob.end(), p, p + size);
+}
+
+bool font_atlas_bake(ImFontAtlas *atlas, std::vector<unsigned char> &blob)
+{
+    unsigned char *pixels = nullptr;
+    int width = 0, height = 0;
+    atlas->GetTexDataAsAlpha8(&pixels, &width, &height);
+    if (pixels == nullptr)
+        return false;
+
+    atlas_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.imgui_version = IMGUI_VERSION_NUM;
+    header.glyph_size = sizeof(ImFontGlyph);
+    header.lines = IM_ARRAYSIZE(atlas->TexUvLines);
+    header.fonts = atlas->Fonts.Size;
+    header.width = width;
+    header.height = height;
+    header.white[0] = atlas->TexUvWhitePixel.x;
+    header.white[1] = atlas->TexUvWhitePixel.y;
+
+    blob.clear();
+    append(blob, &header, sizeof(header));
+    append(blob, atlas->TexUvLines, sizeof(atlas->TexUvLines));
+    for (int n = 0; n < atlas->Fonts.Size; n++)
+    {
+        const ImFont *font = atlas->Fonts[n];
+        font_header_t f;
+        memset(&f, 0, sizeof(f));
+        f.size = font->FontSize;
+        f.ascent = font->Ascent;
+        f.descent = font->Descent;
+        f.fallback_char = font->FallbackChar;
+        f.ellipsis_char = font->EllipsisChar;
+#if IMGUI_VERSION_NUM >= 18910
+        f.ellipsis_count = font->EllipsisCharCount;
+        f.ellipsis_width = font->EllipsisWidth;
+        f.ellipsis_step = font->EllipsisCharStep;
+#else
+        f.dot_char = font->DotChar;
+#endif
+        f.glyphs = font->Glyphs.Size;
+        append(blob, &f, sizeof(f));
+        append(blob, font->Glyphs.Data, font->Glyphs.Size * sizeof(ImFontGlyph));
+    }
+    append(blob, pixels, (size_t)width * height);
+    return true;
+}
+
+bool font_atlas_restore(ImFontAtlas *atlas, const unsigned char *blob, size_t size)
+{
+    atlas_header_t header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, blob, sizeof(header));
+    if ((memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) || (header.imgui_version != IMGUI_VERSION_NUM) ||
+        (header.glyph_size != sizeof(ImFontGlyph)) || (header.lines != (uint32_t)IM_ARRAYSIZE(atlas->TexUvLines)))
+    {
+        spdlog::warn("The font atlas was baked for another version of ImGui : the fonts are rasterised");
+        return false;
+    }
+
+    // the sizes are checked before anything is installed
+    size_t offset = sizeof(header) + sizeof(atlas->TexUvLines);
+    size_t pixels = (size_t)header.width * header.height;
+    std::vector<size_t> font_offsets;
+    for (uint32_t n = 0; n < header.fonts; n++)
+    {
+        font_header_t f;
+        if (offset + sizeof(f) > size)
+            return false;
+        memcpy(&f, blob + offset, sizeof(f));
+        font_offsets.push_back(offset);
+        offset += sizeof(f) + (size_t)f.glyphs * sizeof(ImFontGlyph);
+    }
+    if (offset + pixels != size)
+    {
+        spdlog::warn("The font atlas is truncated : the fonts are rasterised");
+        return false;
+    }
+
+    atlas->Clear();
+    memcpy(atlas->TexUvLines, blob + sizeof(header), sizeof(atlas->TexUvLines));
+    for (auto font_offset : font_offsets)
+    {
+        font_header_t f;
+        memcpy(&f, blob + font_offset, sizeof(f));
+        ImFont *font = IM_NEW(ImFont);
+        font->ContainerAtlas = atlas;
+        font->FontSize = f.size;
+        font->Ascent = f.ascent;
+        font->Descent = f.descent;
+        font->FallbackChar = (ImWchar)f.fallback_char;
+        font->EllipsisChar = (ImWchar)f.ellipsis_char;
+#if IMGUI_VERSION_NUM >= 18910
+        font->EllipsisCharCount = (short)f.ellipsis_count;
+        font->EllipsisWidth = f.ellipsis_width;
+        font->EllipsisCharStep = f.ellipsis_step;
+#else
+        font->DotChar = (ImWchar)f.dot_char;
+#endif
+        font->Glyphs.resize(f.glyphs);
+        memcpy(font->Glyphs.Data, blob + font_offset + sizeof(f), (size_t)f.glyphs * sizeof(ImFontGlyph));
+        font->BuildLookupTable();
+        atlas->Fonts.push_back(font);
+    }
+
+    // the texture is read by the backend as if the atlas had been built
+    atlas->TexWidth = header.width;
+    atlas->TexHeight = header.height;
+    atlas->TexUvScale = ImVec2(1.0f / header.width, 1.0f / header.height);
+    atlas->TexUvWhitePixel = ImVec2(header.white[0], header.white[1]);
+    atlas->TexPixelsAlpha8 = (unsigned char *)IM_ALLOC(pixels);
+    memcpy(atlas->TexPixelsAlpha8, blob + offset, pixels);
+#if IMGUI_VERSION_NUM >= 18700
+    atlas->TexReady = true;
+#endif
+    return true;
+}
@@ -0,0 +1,120 @@
+#include "yacvat/frame_profile.h"
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const int FRAME_HISTORY = 300; // frames kept, 5 s at 60 frames per second
+
+static const char *PHASE_NAMES[PHASE_COUNT] = {"events", "images folder", "annotations panel", "current image", "annotation fsm", "json", "decode", "upload", "render", "swap"};
+
+bool frame_profile_flag = false;
+
+static std::chrono::steady_clock::time_point frame_start; // of the frame in progress
+static bool frame_started = false;                        // the frame in progress began while the profile was on
+static float current[PHASE_COUNT];                        // times of the frame in progress (ms)
+static float frames[FRAME_HISTORY];                       // times of the last frames (ms), a ring
+static float phases[PHASE_COUNT][FRAME_HISTORY];          // times of the phases of the last frames
+static int next_frame = 0;                                // next slot of the rings
+static int frame_count = 0;                               // frames in the rings
+
+void frame_profile_enable(bool enable)
+{
+    frame_profile_flag = enable;
+    frame_started = false;
+    next_frame = 0;
+    frame_count = 0;
+}
+
+void frame_profile_begin(void)
+{
+    frame_started = frame_profile_flag;
+    if (!frame_started)
+        return;
+    frame_start = std::chrono::steady_clock::now();
+    memset(current, 0, sizeof(current));
+}
+
+void frame_profile_add(frame_phase_t phase, double ms)
+{
+    if (frame_started)
+        current[phase] += (float)ms;
+}
+
+void frame_profile_end(void)
+{
+    if (!frame_started || !frame_profile_flag)
+        return;
+    frame_started = false;
+    frames[next_frame] = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+    for (int p = 0; p < PHASE_COUNT; p++)
+        phases[p][next_frame] = current[p];
+    next_frame = (next_frame + 1) % FRAME_HISTORY;
+    frame_count = std::min(frame_count + 1, FRAME_HISTORY);
+}
+
+// p50 and p99 of the frames in a ring
+static void percentiles(const float *ring, float *p50, float *p99)
+{
+    static float sorted[FRAME_HISTORY];
+    memcpy(sorted, ring, frame_count * sizeof(float));
+    std::nth_element(sorted, sorted + frame_count / 2, sorted + frame_count);
+    *p50 = sorted[frame_count / 2];
+    int k = std::min(frame_count - 1, (frame_count * 99) / 100);
+    std::nth_element(sorted, sorted + k, sorted + frame_count);
+    *p99 = sorted[k];
+}
+
+void frame_profile_window(void)
+{
+    // top right corner of the main window, above the panels
+    const ImGuiViewport *viewport = ImGui::GetMainViewport();
+    ImVec2 pos(viewport->WorkPos.x + viewport->WorkSize.x - 8.0f, viewport->WorkPos.y + 8.0f);
+    ImGui::SetNextWindowPos(pos, ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
+    if (ImGui::Begin("Frame profile", nullptr, flags))
+    {
+        if (frame_count == 0)
+        {
+            ImGui::TextDisabled("Waiting for the first frame");
+        }
+        else
+        {
+            float p50, p99;
+            percentiles(frames, &p50, &p99);
+            ImGui::Text("Frame : p50 %.2f ms, p99 %.2f ms over %d frames", p50, p99, frame_count);
+
+            // the oldest frame on the left, scaled to the slowest one
+            float slowest = *std::max_element(frames, frames + frame_count);
+            int offset = (frame_count == FRAME_HISTORY) ? next_frame : 0;
+            ImGui::PlotHistogram("##frames", frames, frame_count, offset, nullptr, 0.0f, std::max(slowest, 1.0f), ImVec2(320.0f, 60.0f));
+
+            if (ImGui::BeginTable("phases", 4, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("Phase");
+                ImGui::TableSetupColumn("Last");
+                ImGui::TableSetupColumn("p50");
+                ImGui::TableSetupColumn("p99");
+                ImGui::TableHeadersRow();
+                int last = (next_frame + FRAME_HISTORY - 1) % FRAME_HISTORY;
+                for (int p = 0; p < PHASE_COUNT; p++)
+                {
+                    percentiles(phases[p], &p50, &p99);
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(PHASE_NAMES[p]);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", phases[p][last]);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", p50);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", p99);
+                }
+                ImGui::EndTable();
+            }
+        }
+        ImGui::TextDisabled("Ctrl+P to hide");
+    }
+    ImGui::End();
+}
@@ -0,0 +1,155 @@
+#include "yacvat/gl_functions.h"
+#include "spdlog/spdlog.h"
+
+#include <SDL.h>
+#include <cstdio>
+#include <cstring>
+
+gl_functions_t gl;
+
+// an entry point missing clears the flag of its group
+template <typename T>
+static void load(T *f, const char *name, bool *group)
+{
+    *f = (T)SDL_GL_GetProcAddress(name);
+    if (*f == nullptr)
+    {
+        spdlog::debug("OpenGL entry point {} is missing", name);
+        *group = false;
+    }
+}
+
+void gl_load(void)
+{
+    static bool tried = false;
+    if (tried)
+        return;
+    tried = true;
+
+    gl.shaders = true;
+    load(&gl.CreateShader, "glCreateShader", &gl.shaders);
+    load(&gl.ShaderSource, "glShaderSource", &gl.shaders);
+    load(&gl.CompileShader, "glCompileShader", &gl.shaders);
+    load(&gl.GetShaderiv, "glGetShaderiv", &gl.shaders);
+    load(&gl.GetShaderInfoLog, "glGetShaderInfoLog", &gl.shaders);
+    load(&gl.DeleteShader, "glDeleteShader", &gl.shaders);
+    load(&gl.CreateProgram, "glCreateProgram", &gl.shaders);
+    load(&gl.DeleteProgram, "glDeleteProgram", &gl.shaders);
+    load(&gl.AttachShader, "glAttachShader", &gl.shaders);
+    load(&gl.BindAttribLocation, "glBindAttribLocation", &gl.shaders);
+    load(&gl.LinkProgram, "glLinkProgram", &gl.shaders);
+    load(&gl.GetProgramiv, "glGetProgramiv", &gl.shaders);
+    load(&gl.GetProgramInfoLog, "glGetProgramInfoLog", &gl.shaders);
+    load(&gl.UseProgram, "glUseProgram", &gl.shaders);
+    load(&gl.GetAttribLocation, "glGetAttribLocation", &gl.shaders);
+    load(&gl.GetUniformLocation, "glGetUniformLocation", &gl.shaders);
+    load(&gl.Uniform1i, "glUniform1i", &gl.shaders);
+    load(&gl.Uniform1f, "glUniform1f", &gl.shaders);
+    load(&gl.Uniform3i, "glUniform3i", &gl.shaders);
+    load(&gl.Uniform3f, "glUniform3f", &gl.shaders);
+    load(&gl.Uniform4f, "glUniform4f", &gl.shaders);
+    load(&gl.UniformMatrix4fv, "glUniformMatrix4fv", &gl.shaders);
+
+    gl.textures = true;
+    load(&gl.ActiveTexture, "glActiveTexture", &gl.textures);
+    load(&gl.TexImage3D, "glTexImage3D", &gl.textures);
+    load(&gl.TexSubImage3D, "glTexSubImage3D", &gl.textures);
+    load(&gl.GenerateMipmap, "glGenerateMipmap", &gl.textures);
+
+    gl.instanced = true;
+    load(&gl.GenVertexArrays, "glGenVertexArrays", &gl.instanced);
+    load(&gl.DeleteVertexArrays, "glDeleteVertexArrays", &gl.instanced);
+    load(&gl.BindVertexArray, "glBindVertexArray", &gl.instanced);
+    load(&gl.GenBuffers, "glGenBuffers", &gl.instanced);
+    load(&gl.DeleteBuffers, "glDeleteBuffers", &gl.instanced);
+    load(&gl.BindBuffer, "glBindBuffer", &gl.instanced);
+    load(&gl.BufferData, "glBufferData", &gl.instanced);
+    load(&gl.BufferSubData, "glBufferSubData", &gl.instanced);
+    load(&gl.EnableVertexAttribArray, "glEnableVertexAttribArray", &gl.instanced);
+    load(&gl.VertexAttribPointer, "glVertexAttribPointer", &gl.instanced);
+    load(&gl.VertexAttribDivisor, "glVertexAttribDivisor", &gl.instanced);
+    load(&gl.DrawArraysInstanced, "glDrawArraysInstanced", &gl.instanced);
+}
+
+static GLuint compile(const char *name, GLenum type, const char *version, const char *source)
+{
+    const char *sources[2] = {version, source};
+    GLuint shader = gl.CreateShader(type);
+    gl.ShaderSource(shader, 2, sources, nullptr);
+    gl.CompileShader(shader);
+
+    GLint status = 0;
+    gl.GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[1024];
+        gl.GetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        spdlog::error("Cannot compile the {} shader : {}", name, log);
+    }
+    return shader;
+}
+
+GLuint gl_build_program(const char *name, const char *vertex_shader, const char *fragment_shader, const char *const *attributes, const GLint *locations, int count)
+{
+    gl_load();
+    if (!gl.shaders)
+        return 0;
+
+    // same language as the context : 1.50 on core profiles (macOS), 1.30 otherwise
+    int major = 1, minor = 30;
+    const char *glsl = (const char *)glGetString(GL_SHADING_LANGUAGE_VERSION);
+    if (glsl != nullptr)
+        sscanf(glsl, "%d.%d", &major, &minor);
+    const char *version = (major * 100 + minor >= 150) ? "#version 150\n" : "#version 130\n";
+
+    GLuint vs = compile(name, GL_VERTEX_SHADER, version, vertex_shader);
+    GLuint fs = compile(name, GL_FRAGMENT_SHADER, version, fragment_shader);
+    GLuint id = gl.CreateProgram();
+    gl.AttachShader(id, vs);
+    gl.AttachShader(id, fs);
+    for (int k = 0; k < count; k++)
+    {
+        if (locations[k] >= 0)
+            gl.BindAttribLocation(id, locations[k], attributes[k]);
+    }
+    gl.LinkProgram(id);
+    gl.DeleteShader(vs);
+    gl.DeleteShader(fs);
+
+    GLint status = 0;
+    gl.GetProgramiv(id, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[1024];
+        gl.GetProgramInfoLog(id, sizeof(log), nullptr, log);
+        spdlog::error("Cannot link the {} shader : {}", name, log);
+        gl.DeleteProgram(id);
+        return 0;
+    }
+    return id;
+}
+
+bool gl_callback_setup(const ImDrawCmd *cmd, float proj[16])
+{
+    // the pixels of the display to the clip space, top left corner first
+    ImDrawData *draw_data = ImGui::GetDrawData();
+    float l = draw_data->DisplayPos.x, r = draw_data->DisplayPos.x + draw_data->DisplaySize.x;
+    float t = draw_data->DisplayPos.y, b = draw_data->DisplayPos.y + draw_data->DisplaySize.y;
+    const float ortho[16] = {
+        2.0f / (r - l), 0.0f, 0.0f, 0.0f,
+        0.0f, 2.0f / (t - b), 0.0f, 0.0f,
+        0.0f, 0.0f, -1.0f, 0.0f,
+        (r + l) / (l - r), (t + b) / (b - t), 0.0f, 1.0f};
+    memcpy(proj, ortho, sizeof(ortho));
+
+    // the callback is not clipped by ImGui
+    ImVec2 off = draw_data->DisplayPos;
+    ImVec2 fb_scale = draw_data->FramebufferScale;
+    float fb_height = draw_data->DisplaySize.y * fb_scale.y;
+    float x0 = (cmd->ClipRect.x - off.x) * fb_scale.x, y0 = (cmd->ClipRect.y - off.y) * fb_scale.y;
+    float x1 = (cmd->ClipRect.z - off.x) * fb_scale.x, y1 = (cmd->ClipRect.w - off.y) * fb_scale.y;
+    if ((x1 <= x0) || (y1 <= y0))
+        return false;
+    glScissor((int)x0, (int)(fb_height - y1), (int)(x1 - x0), (int)(y1 - y0));
+    return true;
+}
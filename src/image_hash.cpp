@@ -0,0 +1,253 @@
+#include "yacvat/image_hash.h"
+#include "yacvat/array_source.h"
+#include "yacvat/mapped_file.h"
+#include "spdlog/spdlog.h"
+
+#include "stb_image.h"
+
+#include <vector>
+#include <cstring>
+
+static const int FINE_W = 72; // fine grid, split in 9 or 8 columns and in 8 rows
+static const int FINE_H = 64;
+
+static const uint64_t P1 = 11400714785074694791ULL;
+static const uint64_t P2 = 14029467366897019727ULL;
+static const uint64_t P3 = 1609587929392839161ULL;
+static const uint64_t P4 = 9650029242287828579ULL;
+static const uint64_t P5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input)
+{
+    acc += input * P2;
+    acc = rotl(acc, 31);
+    return acc * P1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t v)
+{
+    acc ^= xxh_round(0, v);
+    return acc * P1 + P4;
+}
+
+uint64_t xxh64(const void *data, size_t length, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + length;
+    uint64_t h;
+
+    if (length >= 32)
+    {
+        // four independent lanes over 32 bytes stripes
+        uint64_t v1 = seed + P1 + P2;
+        uint64_t v2 = seed + P2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - P1;
+        const unsigned char *limit = end - 32;
+        do
+        {
+            v1 = xxh_round(v1, read64(p));
+            v2 = xxh_round(v2, read64(p + 8));
+            v3 = xxh_round(v3, read64(p + 16));
+            v4 = xxh_round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = xxh_merge(h, v1);
+        h = xxh_merge(h, v2);
+        h = xxh_merge(h, v3);
+        h = xxh_merge(h, v4);
+    }
+    else
+    {
+        h = seed + P5;
+    }
+
+    h += (uint64_t)length;
+    for (; p + 8 <= end; p += 8)
+        h = rotl(h ^ xxh_round(0, read64(p)), 27) * P1 + P4;
+    if (p + 4 <= end)
+    {
+        h = rotl(h ^ ((uint64_t)read32(p) * P1), 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; p++)
+        h = rotl(h ^ (*p * P5), 11) * P1;
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+int hash_distance(uint64_t a, uint64_t b)
+{
+    return __builtin_popcountll(a ^ b);
+}
+
+// average and difference hashes of a plane of values (row_stride in values)
+template <typename T>
+static void perceptual_hashes(const T *values, int width, int height, size_t row_stride, image_hash_t *hash)
+{
+    if ((width <= 0) || (height <= 0))
+        return;
+
+    std::vector<int> cell_of(width);
+    for (int x = 0; x < width; x++)
+        cell_of[x] = (int)((int64_t)x * FINE_W / width);
+
+    // rows summed into a line, the line split into cells at the end of each band of rows
+    std::vector<float> line(width, 0.0f);
+    std::vector<double> sums(FINE_W * FINE_H, 0.0);
+    std::vector<double> counts(FINE_W * FINE_H, 0.0);
+    int band = 0, rows = 0;
+    for (int y = 0; y <= height; y++)
+    {
+        int b = (y < height) ? (int)((int64_t)y * FINE_H / height) : FINE_H;
+        if ((b != band) && (rows > 0))
+        {
+            for (int x = 0; x < width; x++)
+            {
+                sums[band * FINE_W + cell_of[x]] += line[x];
+                counts[band * FINE_W + cell_of[x]] += rows;
+                line[x] = 0.0f;
+            }
+            rows = 0;
+        }
+        if (y == height)
+            break;
+
+        band = b;
+        const T *row = values + (size_t)y * row_stride;
+        float *l = line.data();
+        for (int x = 0; x < width; x++)
+            l[x] += (float)row[x];
+        rows++;
+    }
+
+    // mean of the fine cells covered by a coarse cell, the empty ones (tiny images) left out
+    auto coarse = [&sums, &counts](int x0, int x1, int y0, int y1)
+    {
+        double s = 0.0, c = 0.0;
+        for (int y = y0; y < y1; y++)
+        {
+            for (int x = x0; x < x1; x++)
+            {
+                s += sums[y * FINE_W + x];
+                c += counts[y * FINE_W + x];
+            }
+        }
+        return (c > 0.0) ? s / c : 0.0;
+    };
+
+    double a[64], d[8][9], mean = 0.0;
+    for (int cy = 0; cy < 8; cy++)
+    {
+        for (int cx = 0; cx < 8; cx++)
+        {
+            a[cy * 8 + cx] = coarse(cx * 9, cx * 9 + 9, cy * 8, cy * 8 + 8);
+            mean += a[cy * 8 + cx] / 64.0;
+        }
+        for (int cx = 0; cx < 9; cx++)
+            d[cy][cx] = coarse(cx * 8, cx * 8 + 8, cy * 8, cy * 8 + 8);
+    }
+
+    hash->ahash = 0;
+    hash->dhash = 0;
+    for (int k = 0; k < 64; k++)
+    {
+        if (a[k] > mean)
+            hash->ahash |= (1ULL << k);
+        if (d[k / 8][k % 8] > d[k / 8][k % 8 + 1])
+            hash->dhash |= (1ULL << k);
+    }
+    hash->flags |= HASH_PERCEPTUAL;
+}
+
+bool hash_image_file(const std::string &fname, image_hash_t *hash)
+{
+    memset(hash, 0, sizeof(*hash));
+    MappedFile file;
+    if (!file.open(fname))
+        return false;
+    hash->content = xxh64(file.data(), file.size());
+    hash->flags = HASH_CONTENT;
+
+    if (ArraySource::handles(fname))
+    {
+        // first channel of an array, in its own unit
+        ArraySource source;
+        if (!source.open(fname))
+            return true;
+        const array_layout_t &layout = source.layout();
+        size_t npixels = (size_t)layout.width * layout.height;
+        size_t stride = source.pixel_stride();
+        std::vector<float> values(npixels);
+        const unsigned char *start = source.plane(0);
+        for (size_t n = 0; n < npixels; n++)
+            values[n] = source.value(start + n * stride);
+        perceptual_hashes(values.data(), layout.width, layout.height, layout.width, hash);
+        return true;
+    }
+
+    // decoded from the mapping, in gray
+    if (file.size() > 0x7fffffff)
+        return true;
+    int width, height, comp;
+    unsigned char *pixels = stbi_load_from_memory(file.data(), (int)file.size(), &width, &height, &comp, 1);
+    if (pixels == nullptr)
+    {
+        spdlog::debug("Cannot decode {} to hash it : {}", fname.c_str(), stbi_failure_reason());
+        return true;
+    }
+    perceptual_hashes(pixels, width, height, width, hash);
+    stbi_image_free(pixels);
+    return true;
+}
+
+void hash_video_frame(const video_frame_t &frame, image_hash_t *hash)
+{
+    // the planes of a frame follow each other in the mapping
+    memset(hash, 0, sizeof(*hash));
+    size_t bytes = (frame.depth > 8) ? 2 : 1;
+    size_t length = 0;
+    for (int k = 0; k < 3; k++)
+        length += (size_t)frame.width[k] * frame.height[k] * bytes;
+    hash->content = xxh64(frame.planes[0], length);
+    hash->flags = HASH_CONTENT;
+
+    if (bytes == 1)
+    {
+        perceptual_hashes(frame.planes[0], frame.width[0], frame.height[0], frame.width[0], hash);
+    }
+    else
+    {
+        // little endian samples, aligned only by chance in the mapping
+        std::vector<uint16_t> y((size_t)frame.width[0] * frame.height[0]);
+        for (size_t n = 0; n < y.size(); n++)
+            y[n] = frame.planes[0][2 * n] | (frame.planes[0][2 * n + 1] << 8);
+        perceptual_hashes(y.data(), frame.width[0], frame.height[0], frame.width[0], hash);
+    }
+}
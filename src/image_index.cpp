@@ -0,0 +1,262 @@
+#include "yacvat/image_index.h"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cctype>
+
+static void set_bit(std::vector<uint64_t> &bits, uint32_t id, bool value)
+{
+    if ((id >> 6) >= bits.size())
+        bits.resize((id >> 6) + 1, 0);
+    if (value)
+        bits[id >> 6] |= (1ULL << (id & 63));
+    else
+        bits[id >> 6] &= ~(1ULL << (id & 63));
+}
+
+static std::string lower(const std::string &s)
+{
+    std::string l(s);
+    std::transform(l.begin(), l.end(), l.begin(), ::tolower);
+    return l;
+}
+
+// case insensitive search of a lower case text
+static bool contains(const std::string &s, const std::string &lower_text)
+{
+    return std::search(s.begin(), s.end(), lower_text.begin(), lower_text.end(), [](char a, char b)
+                       { return ::tolower((unsigned char)a) == b; }) != s.end();
+}
+
+// the 3 lower case bytes of a trigram
+static uint32_t trigram_key(const std::string &s, size_t pos)
+{
+    return ((uint32_t)(unsigned char)s[pos] << 16) | ((uint32_t)(unsigned char)s[pos + 1] << 8) | (uint32_t)(unsigned char)s[pos + 2];
+}
+
+static void trigram_keys(const std::string &s, std::vector<uint32_t> &keys)
+{
+    keys.clear();
+    for (size_t pos = 0; pos + 3 <= s.size(); pos++)
+        keys.push_back(trigram_key(s, pos));
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+ImageIndex::ImageIndex(void)
+{
+    this->trigrams_ready = false;
+}
+
+void ImageIndex::clear(void)
+{
+    this->names.clear();
+    this->ids.clear();
+    this->totals.clear();
+    this->annotated.clear();
+    this->counts.clear();
+    this->labels.clear();
+    this->trigrams.clear();
+    this->trigrams_ready = false;
+}
+
+uint32_t ImageIndex::id(const std::string &fname)
+{
+    auto it = this->ids.find(fname);
+    if (it != this->ids.end())
+        return it->second;
+
+    uint32_t id = this->names.size();
+    this->names.push_back(fname);
+    this->ids[fname] = id;
+    this->totals.push_back(0);
+    if (this->trigrams_ready)
+        this->add_trigrams(id);
+    return id;
+}
+
+void ImageIndex::add_trigrams(uint32_t id)
+{
+    // ids are created in increasing order : the lists stay sorted
+    std::vector<uint32_t> keys;
+    trigram_keys(lower(this->names[id]), keys);
+    for (uint32_t key : keys)
+        this->trigrams[key].push_back(id);
+}
+
+void ImageIndex::update_bits(int label, uint32_t id)
+{
+    auto c = this->counts[label].find(id);
+    set_bit(this->labels[label], id, (c != this->counts[label].end()) && (c->second > 0));
+    set_bit(this->annotated, id, this->totals[id] > 0);
+}
+
+void ImageIndex::rebuild(std::vector<Annotation> &annotations)
+{
+    std::fill(this->totals.begin(), this->totals.end(), 0);
+    this->annotated.assign((this->names.size() + 63) / 64, 0);
+    this->counts.assign(annotations.size(), std::unordered_map<uint32_t, uint32_t>());
+    this->labels.assign(annotations.size(), std::vector<uint64_t>((this->names.size() + 63) / 64, 0));
+
+    for (size_t n = 0; n < annotations.size(); n++)
+    {
+        for (auto &instance : annotations[n].inst)
+        {
+            uint32_t id = this->id(instance.img_fname);
+            this->counts[n][id]++;
+            this->totals[id]++;
+            set_bit(this->labels[n], id, true);
+            set_bit(this->annotated, id, true);
+        }
+    }
+}
+
+void ImageIndex::add_instance(int label, const std::string &fname)
+{
+    if (label < 0)
+        return;
+    if ((size_t)label >= this->counts.size())
+    {
+        this->counts.resize(label + 1);
+        this->labels.resize(label + 1);
+    }
+
+    uint32_t id = this->id(fname);
+    this->counts[label][id]++;
+    this->totals[id]++;
+    this->update_bits(label, id);
+}
+
+void ImageIndex::remove_instance(int label, const std::string &fname)
+{
+    auto it = this->ids.find(fname);
+    if ((label < 0) || ((size_t)label >= this->counts.size()) || (it == this->ids.end()))
+        return;
+
+    uint32_t id = it->second;
+    auto c = this->counts[label].find(id);
+    if ((c == this->counts[label].end()) || (c->second == 0))
+        return;
+    if (--c->second == 0)
+        this->counts[label].erase(c);
+    this->totals[id]--;
+    this->update_bits(label, id);
+}
+
+void ImageIndex::search(const std::string &text, std::vector<uint32_t> &found)
+{
+    found.clear();
+    std::string t = lower(text);
+
+    // too short for a trigram : every name is checked
+    if (t.size() < 3)
+    {
+        for (uint32_t id = 0; id < this->names.size(); id++)
+        {
+            if (contains(this->names[id], t))
+                found.push_back(id);
+        }
+        return;
+    }
+
+    if (!this->trigrams_ready)
+    {
+        for (uint32_t id = 0; id < this->names.size(); id++)
+            this->add_trigrams(id);
+        this->trigrams_ready = true;
+        spdlog::debug("Trigram index : {} names, {} trigrams", this->names.size(), this->trigrams.size());
+    }
+
+    // lists of ids of the trigrams, the shortest first
+    std::vector<uint32_t> keys;
+    trigram_keys(t, keys);
+    std::vector<const std::vector<uint32_t> *> lists;
+    for (uint32_t key : keys)
+    {
+        auto it = this->trigrams.find(key);
+        if (it == this->trigrams.end())
+            return;
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b)
+              { return a->size() < b->size(); });
+
+    // intersection : each candidate of the shortest list is searched in the others
+    for (uint32_t id : *lists[0])
+    {
+        bool in_all = true;
+        for (size_t k = 1; (k < lists.size()) && in_all; k++)
+            in_all = std::binary_search(lists[k]->begin(), lists[k]->end(), id);
+
+        // the trigrams may be in another order in the name
+        if (in_all && contains(this->names[id], t))
+            found.push_back(id);
+    }
+}
+
+size_t ImageIndex::match(const image_filter_t &filter, std::vector<uint64_t> &bits)
+{
+    size_t nwords = (this->names.size() + 63) / 64;
+    const std::vector<uint64_t> *set = nullptr;
+    if (filter.mode == FILTER_LABEL)
+        set = ((filter.label >= 0) && ((size_t)filter.label < this->labels.size())) ? &this->labels[filter.label] : nullptr;
+    else if (filter.mode != FILTER_ALL)
+        set = &this->annotated;
+
+    // bits of the annotation filter alone
+    bits.assign(nwords, 0);
+    for (size_t w = 0; w < nwords; w++)
+    {
+        uint64_t v = ((set != nullptr) && (w < set->size())) ? (*set)[w] : 0;
+        if (filter.mode == FILTER_ALL)
+            v = ~0ULL;
+        else if (filter.mode == FILTER_UNANNOTATED)
+            v = ~v;
+        bits[w] = v;
+    }
+    if ((nwords > 0) && (this->names.size() & 63))
+        bits[nwords - 1] &= (1ULL << (this->names.size() & 63)) - 1;
+
+    // restricted to the names found
+    if (!filter.text.empty())
+    {
+        std::vector<uint32_t> found;
+        this->search(filter.text, found);
+        std::vector<uint64_t> text_bits(nwords, 0);
+        for (uint32_t id : found)
+            text_bits[id >> 6] |= (1ULL << (id & 63));
+        for (size_t w = 0; w < nwords; w++)
+            bits[w] &= text_bits[w];
+    }
+
+    size_t count = 0;
+    for (uint64_t v : bits)
+        count += __builtin_popcountll(v);
+    return count;
+}
+
+bool ImageIndex::match(const image_filter_t &filter, uint32_t id)
+{
+    if (id >= this->names.size())
+        return false;
+
+    switch (filter.mode)
+    {
+    case FILTER_UNANNOTATED:
+        if (this->totals[id] > 0)
+            return false;
+        break;
+    case FILTER_ANNOTATED:
+        if (this->totals[id] == 0)
+            return false;
+        break;
+    case FILTER_LABEL:
+        if ((filter.label < 0) || ((size_t)filter.label >= this->labels.size()) || !ImageIndex::test(this->labels[filter.label], id))
+            return false;
+        break;
+    default:
+        break;
+    }
+
+    return filter.text.empty() || contains(this->names[id], lower(filter.text));
+}
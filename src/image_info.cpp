@@ -0,0 +1,322 @@
+#include "yacvat/image_info.h"
+#include "yacvat/files.h"
+#include "yacvat/array_source.h"
+#include "yacvat/video_source.h"
+#include "spdlog/spdlog.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+
+bool probe_image_size(const std::string &fname, int *width, int *height, int *channels)
+{
+    // a frame of a video
+    std::string video;
+    long frame;
+    video_format_t format;
+    if (video_frame_of(fname, &video, &frame))
+    {
+        bool ok = VideoSource::probe(video, &format);
+        *width = ok ? format.width : 0;
+        *height = ok ? format.height : 0;
+        if (channels != nullptr)
+            *channels = ok ? 3 : 0;
+        return ok;
+    }
+
+    array_layout_t layout;
+    if (ArraySource::handles(fname))
+    {
+        bool ok = ArraySource::probe(fname, &layout);
+        *width = ok ? layout.width : 0;
+        *height = ok ? layout.height : 0;
+        if (channels != nullptr)
+            *channels = ok ? layout.channels : 0;
+        return ok;
+    }
+
+    // stbi_info only parses the header of the file
+    int comp = 0;
+    if (!stbi_info(fname.c_str(), width, height, &comp))
+    {
+        spdlog::warn("Cannot read the dimensions of {} : {}", fname.c_str(), stbi_failure_reason());
+        *width = 0;
+        *height = 0;
+        return false;
+    }
+
+    if (channels != nullptr)
+        *channels = comp;
+
+    return true;
+}
+
+bool probe_image_buffer(const unsigned char *data, size_t length, int *width, int *height, int *channels)
+{
+    int comp = 0;
+    if (!stbi_info_from_memory(data, (int)std::min(length, (size_t)0x7fffffff), width, height, &comp))
+    {
+        *width = 0;
+        *height = 0;
+        return false;
+    }
+
+    if (channels != nullptr)
+        *channels = comp;
+
+    return true;
+}
+
+static const size_t HEAD_SIZE = 32; // bytes read to recognise a format
+
+image_format_t detect_image_format(const unsigned char *head, size_t length, const std::string &fname)
+{
+    static const unsigned char PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    if ((length >= 3) && (head[0] == 0xff) && (head[1] == 0xd8) && (head[2] == 0xff))
+        return IMAGE_FORMAT_JPEG;
+    if ((length >= 8) && (memcmp(head, PNG_SIGNATURE, 8) == 0))
+        return IMAGE_FORMAT_PNG;
+    if ((length >= 6) && ((memcmp(head, "GIF87a", 6) == 0) || (memcmp(head, "GIF89a", 6) == 0)))
+        return IMAGE_FORMAT_GIF;
+    if ((length >= 4) && (memcmp(head, "8BPS", 4) == 0))
+        return IMAGE_FORMAT_PSD;
+    if (((length >= 10) && (memcmp(head, "#?RADIANCE", 10) == 0)) || ((length >= 6) && (memcmp(head, "#?RGBE", 6) == 0)))
+        return IMAGE_FORMAT_HDR;
+    if ((length >= 4) && ((memcmp(head, "II*\0", 4) == 0) || (memcmp(head, "MM\0*", 4) == 0)))
+        return IMAGE_FORMAT_TIFF;
+    if ((length >= 12) && (memcmp(head, "RIFF", 4) == 0) && (memcmp(head + 8, "WEBP", 4) == 0))
+        return IMAGE_FORMAT_WEBP;
+    if ((length >= 14) && (head[0] == 'B') && (head[1] == 'M'))
+        return IMAGE_FORMAT_BMP;
+    if ((length >= 3) && (head[0] == 'P') && (head[1] >= '1') && (head[1] <= '6') && isspace(head[2]))
+        return IMAGE_FORMAT_PNM;
+    if ((length >= 6) && (memcmp(head, "\x93NUMPY", 6) == 0))
+        return IMAGE_FORMAT_NPY;
+    if ((length >= 10) && (memcmp(head, "YUV4MPEG2 ", 10) == 0))
+        return IMAGE_FORMAT_Y4M;
+    if (file_extension(fname) == "raw")
+        return IMAGE_FORMAT_RAW;
+    if (file_extension(fname) == "yuv")
+        return IMAGE_FORMAT_YUV;
+
+    // no signature : trust the extension if the header is plausible (colour map 0 or 1, known image type)
+    if ((length >= 18) && (file_extension(fname) == "tga") && (head[1] <= 1))
+    {
+        unsigned char type = head[2];
+        if (((type >= 1) && (type <= 3)) || ((type >= 9) && (type <= 11)))
+            return IMAGE_FORMAT_TGA;
+    }
+
+    return IMAGE_FORMAT_UNKNOWN;
+}
+
+const char *image_format_name(image_format_t format)
+{
+    switch (format)
+    {
+    case IMAGE_FORMAT_JPEG:
+        return "JPEG";
+    case IMAGE_FORMAT_PNG:
+        return "PNG";
+    case IMAGE_FORMAT_BMP:
+        return "BMP";
+    case IMAGE_FORMAT_GIF:
+        return "GIF";
+    case IMAGE_FORMAT_TGA:
+        return "TGA";
+    case IMAGE_FORMAT_PNM:
+        return "PNM";
+    case IMAGE_FORMAT_PSD:
+        return "PSD";
+    case IMAGE_FORMAT_HDR:
+        return "HDR";
+    case IMAGE_FORMAT_TIFF:
+        return "TIFF";
+    case IMAGE_FORMAT_WEBP:
+        return "WebP";
+    case IMAGE_FORMAT_NPY:
+        return "NumPy";
+    case IMAGE_FORMAT_RAW:
+        return "raw";
+    case IMAGE_FORMAT_Y4M:
+        return "Y4M";
+    case IMAGE_FORMAT_YUV:
+        return "YUV";
+    default:
+        return "unknown format";
+    }
+}
+
+bool probe_image_file(const std::string &fname, image_format_t *format, int *width, int *height)
+{
+    *format = IMAGE_FORMAT_UNKNOWN;
+    *width = 0;
+    *height = 0;
+
+    unsigned char head[HEAD_SIZE];
+    FILE *f = fopen(fname.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+    size_t length = fread(head, 1, sizeof(head), f);
+    fclose(f);
+
+    *format = detect_image_format(head, length, fname);
+    if ((*format == IMAGE_FORMAT_UNKNOWN) || (*format == IMAGE_FORMAT_TIFF) || (*format == IMAGE_FORMAT_WEBP))
+        return false;
+
+    // arrays : the shape in the header (or the description of a raw file)
+    if ((*format == IMAGE_FORMAT_NPY) || (*format == IMAGE_FORMAT_RAW))
+    {
+        array_layout_t layout;
+        if (!ArraySource::probe(fname, &layout))
+            return false;
+        *width = layout.width;
+        *height = layout.height;
+        return true;
+    }
+
+    // videos : the dimensions of the frames
+    if ((*format == IMAGE_FORMAT_Y4M) || (*format == IMAGE_FORMAT_YUV))
+    {
+        video_format_t video;
+        if (!VideoSource::probe(fname, &video))
+            return false;
+        *width = video.width;
+        *height = video.height;
+        return true;
+    }
+
+    // variants stb does not decode (ascii PNM, 12 bit JPEG, ...) fail here
+    int comp = 0;
+    if (!stbi_info(fname.c_str(), width, height, &comp))
+    {
+        *width = 0;
+        *height = 0;
+        return false;
+    }
+    return true;
+}
+
+// reader of the values of a TIFF block (the content of the EXIF segment), in its own byte order
+class TiffReader
+{
+public:
+    TiffReader(const unsigned char *data, size_t length) : data(data), length(length), big_endian(length >= 2 && data[0] == 'M') {}
+
+    bool u16(size_t pos, uint32_t *v)
+    {
+        if (pos + 2 > this->length)
+            return false;
+        const unsigned char *p = this->data + pos;
+        *v = this->big_endian ? ((p[0] << 8) | p[1]) : ((p[1] << 8) | p[0]);
+        return true;
+    }
+
+    bool u32(size_t pos, uint32_t *v)
+    {
+        if (pos + 4 > this->length)
+            return false;
+        const unsigned char *p = this->data + pos;
+        *v = this->big_endian ? (((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]) : (((uint32_t)p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0]);
+        return true;
+    }
+
+    // offset of the value of a tag in an IFD, 0 if missing (values of 4 bytes or less are stored in the entry)
+    size_t find(size_t ifd, uint32_t tag)
+    {
+        uint32_t n, t, type, count, offset;
+        if (!this->u16(ifd, &n))
+            return 0;
+        for (uint32_t k = 0; k < n; k++)
+        {
+            size_t entry = ifd + 2 + 12 * k;
+            if (!this->u16(entry, &t) || !this->u16(entry + 2, &type) || !this->u32(entry + 4, &count))
+                return 0;
+            if (t != tag)
+                continue;
+            if ((type == 2) && (count > 4)) // ascii
+                return this->u32(entry + 8, &offset) ? offset : 0;
+            return entry + 8;
+        }
+        return 0;
+    }
+
+    // "YYYY:MM:DD HH:MM:SS" -> YYYYMMDDhhmmss
+    bool date(size_t pos, int64_t *time)
+    {
+        if ((pos == 0) || (pos + 19 > this->length))
+            return false;
+        int64_t t = 0;
+        for (int k = 0; k < 19; k++)
+        {
+            unsigned char c = this->data[pos + k];
+            if ((k == 4) || (k == 7) || (k == 10) || (k == 13) || (k == 16))
+                continue;
+            if ((c < '0') || (c > '9'))
+                return false;
+            t = 10 * t + (c - '0');
+        }
+        *time = t;
+        return t > 0;
+    }
+
+private:
+    const unsigned char *data;
+    size_t length;
+    bool big_endian;
+};
+
+bool probe_capture_time(const std::string &fname, int64_t *time)
+{
+    // the EXIF segment is one of the first of the file and cannot be larger than 64 kB
+    std::vector<unsigned char> buffer(128 * 1024);
+    FILE *f = fopen(fname.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+    size_t length = fread(buffer.data(), 1, buffer.size(), f);
+    fclose(f);
+
+    const unsigned char *p = buffer.data();
+    if ((length < 4) || (p[0] != 0xff) || (p[1] != 0xd8))
+        return false;
+
+    size_t pos = 2;
+    while (pos + 4 <= length)
+    {
+        if (p[pos] != 0xff)
+            return false;
+        unsigned char marker = p[pos + 1];
+        if (marker == 0xff)
+        {
+            // padding
+            pos++;
+            continue;
+        }
+        // start of the image data : no EXIF segment
+        if ((marker == 0xda) || (marker == 0xd9))
+            return false;
+
+        size_t segment = (p[pos + 2] << 8) | p[pos + 3];
+        if ((marker == 0xe1) && (segment >= 16) && (pos + 10 <= length) && (memcmp(p + pos + 4, "Exif\0\0", 6) == 0))
+        {
+            TiffReader tiff(p + pos + 10, std::min(segment - 8, length - pos - 10));
+            uint32_t ifd0 = 0, exif_ifd = 0;
+            if (!tiff.u32(4, &ifd0))
+                return false;
+
+            // DateTimeOriginal of the EXIF IFD, DateTime of the main IFD when missing
+            size_t pointer = tiff.find(ifd0, 0x8769);
+            if ((pointer != 0) && tiff.u32(pointer, &exif_ifd) && (exif_ifd != 0) && tiff.date(tiff.find(exif_ifd, 0x9003), time))
+                return true;
+            return tiff.date(tiff.find(ifd0, 0x0132), time);
+        }
+        pos += 2 + segment;
+    }
+
+    return false;
+}
@@ -0,0 +1,306 @@
+#include "yacvat/image_orders.h"
+#include "yacvat/image_info.h"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <sys/stat.h>
+
+static const size_t CHUNK_SIZE = 256;                 // files read per capture time task
+static const int64_t KEY_UNKNOWN = INT64_MIN;         // key not read yet
+static const int64_t KEY_MISSING = INT64_MAX;         // no key for this file : last of the order
+
+static bool is_digit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+ImageOrders::ImageOrders(void)
+{
+    for (int o = 0; o < ORDER_MODES; o++)
+    {
+        this->ready[o] = false;
+        this->stale_flags[o] = true;
+        this->generation[o] = 0;
+    }
+}
+
+void ImageOrders::set_folder(std::string folder)
+{
+    // the tasks in progress keep their job alive, their results are dropped
+    this->folder = folder;
+    this->jobs.clear();
+    for (int o = 0; o < ORDER_MODES; o++)
+    {
+        this->orders[o].clear();
+        this->keys[o].clear();
+        this->ready[o] = false;
+        this->stale_flags[o] = true;
+        this->generation[o]++;
+    }
+}
+
+void ImageOrders::invalidate(void)
+{
+    for (int o = 0; o < ORDER_MODES; o++)
+        this->invalidate((image_order_t)o);
+}
+
+void ImageOrders::invalidate(image_order_t order)
+{
+    this->stale_flags[order] = true;
+    this->generation[order]++;
+}
+
+bool ImageOrders::stale(image_order_t order)
+{
+    return this->stale_flags[order];
+}
+
+bool ImageOrders::busy(image_order_t order)
+{
+    for (auto &job : this->jobs)
+    {
+        if (job->order == order)
+            return true;
+    }
+    return false;
+}
+
+const std::vector<uint32_t> *ImageOrders::get(image_order_t order)
+{
+    return this->ready[order] ? &this->orders[order] : nullptr;
+}
+
+bool ImageOrders::poll(void)
+{
+    bool installed = false;
+    for (size_t n = 0; n < this->jobs.size();)
+    {
+        std::shared_ptr<job_t> job = this->jobs[n];
+        if (!job->done_flag)
+        {
+            n++;
+            continue;
+        }
+
+        // a result older than the last change is still better than none, but is computed again
+        image_order_t o = job->order;
+        this->orders[o].swap(job->result);
+        this->keys[o].swap(job->keys);
+        this->ready[o] = true;
+        this->stale_flags[o] = (job->generation != this->generation[o]);
+        this->jobs.erase(this->jobs.begin() + n);
+        installed = true;
+    }
+    return installed;
+}
+
+void ImageOrders::compute(ThreadPool &pool, image_order_t order, std::vector<std::pair<uint32_t, std::string>> &images, std::vector<uint32_t> &counts, std::shared_ptr<const DatasetManifest> listing)
+{
+    if ((order == ORDER_NAME) || this->busy(order))
+        return;
+
+    std::shared_ptr<job_t> job = std::make_shared<job_t>();
+    job->order = order;
+    job->folder = this->folder;
+    job->images.swap(images);
+    job->listing = listing;
+    job->generation = this->generation[order];
+    job->pending = 0;
+    job->done_flag = false;
+    this->stale_flags[order] = false;
+    this->jobs.push_back(job);
+
+    // keys of the previous computations are kept, only the new ids are read
+    uint32_t nids = 0;
+    for (auto &img : job->images)
+        nids = std::max(nids, img.first + 1);
+    if (order == ORDER_COUNT)
+    {
+        job->keys.assign(counts.begin(), counts.end());
+        job->keys.resize(nids, 0);
+    }
+    else if (order != ORDER_NATURAL)
+    {
+        job->keys = this->keys[order];
+        job->keys.resize(std::max((size_t)nids, job->keys.size()), KEY_UNKNOWN);
+        for (size_t n = 0; n < job->images.size(); n++)
+        {
+            if (job->keys[job->images[n].first] == KEY_UNKNOWN)
+                job->missing.push_back(n);
+        }
+    }
+
+    spdlog::debug("Sorting {} images in order {}, {} keys to read", job->images.size(), (int)order, job->missing.size());
+
+    if ((order == ORDER_CAPTURE) && !job->missing.empty())
+    {
+        // one read per file : small tasks spread over every thread
+        job->pending = (job->missing.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        for (size_t start = 0; start < job->missing.size(); start += CHUNK_SIZE)
+        {
+            size_t end = std::min(start + CHUNK_SIZE, job->missing.size());
+            pool.submit([job, start, end]()
+                        { ImageOrders::read_captures(job, start, end); });
+        }
+    }
+    else
+    {
+        pool.submit([job]()
+                    { ImageOrders::read_stats(job); });
+    }
+}
+
+void ImageOrders::read_stats(std::shared_ptr<job_t> job)
+{
+    if (!job->missing.empty())
+    {
+        // sizes and times of the scan, by relative path
+        std::unordered_map<std::string, const manifest_file_t *> files;
+        if (job->listing)
+        {
+            for (auto &dir : job->listing->dirs)
+            {
+                for (auto &f : dir.files)
+                    files[manifest_join(dir.path, f.name)] = &f;
+            }
+        }
+
+        for (size_t n : job->missing)
+        {
+            const std::string &name = job->images[n].second;
+            int64_t &key = job->keys[job->images[n].first];
+            auto it = files.find(name);
+            if (it != files.end())
+            {
+                key = (job->order == ORDER_SIZE) ? (int64_t)it->second->size : it->second->mtime;
+                continue;
+            }
+
+            // added after the scan
+            struct stat st;
+            if (stat((job->folder + "/" + name).c_str(), &st) != 0)
+                key = KEY_MISSING;
+            else
+                key = (job->order == ORDER_SIZE) ? (int64_t)st.st_size : manifest_mtime(st);
+        }
+    }
+
+    ImageOrders::sort(job);
+}
+
+void ImageOrders::read_captures(std::shared_ptr<job_t> job, size_t start, size_t end)
+{
+    // each task writes the keys of its own ids
+    for (size_t k = start; k < end; k++)
+    {
+        size_t n = job->missing[k];
+        int64_t time;
+        if (!probe_capture_time(job->folder + "/" + job->images[n].second, &time))
+            time = KEY_MISSING;
+        job->keys[job->images[n].first] = time;
+    }
+
+    if (--job->pending == 0)
+        ImageOrders::sort(job);
+}
+
+void ImageOrders::sort(std::shared_ptr<job_t> job)
+{
+    // positions in the snapshot, which is in lexical order : ties are broken by comparing the positions
+    std::vector<uint32_t> rows(job->images.size());
+    for (size_t n = 0; n < rows.size(); n++)
+        rows[n] = n;
+
+    if (job->order == ORDER_NATURAL)
+    {
+        std::sort(rows.begin(), rows.end(), [&job](uint32_t a, uint32_t b)
+                  { return ImageOrders::natural_less(job->images[a].second, job->images[b].second); });
+    }
+    else
+    {
+        std::vector<int64_t> row_keys(rows.size());
+        for (size_t n = 0; n < rows.size(); n++)
+            row_keys[n] = job->keys[job->images[n].first];
+        std::sort(rows.begin(), rows.end(), [&row_keys](uint32_t a, uint32_t b)
+                  { return (row_keys[a] < row_keys[b]) || ((row_keys[a] == row_keys[b]) && (a < b)); });
+    }
+
+    job->result.resize(rows.size());
+    for (size_t n = 0; n < rows.size(); n++)
+        job->result[n] = job->images[rows[n]].first;
+
+    spdlog::debug("Order {} of {} images computed", (int)job->order, rows.size());
+    job->done_flag = true;
+}
+
+bool ImageOrders::update_count(uint32_t id, uint32_t count, ImageIndex &index)
+{
+    std::vector<int64_t> &keys = this->keys[ORDER_COUNT];
+    if (id >= keys.size())
+        keys.resize(id + 1, 0);
+    int64_t old_key = keys[id];
+    if (old_key == (int64_t)count)
+        return false;
+
+    // a computation started before this edit is outdated
+    if (this->busy(ORDER_COUNT))
+        this->generation[ORDER_COUNT]++;
+
+    std::vector<uint32_t> &order = this->orders[ORDER_COUNT];
+    auto less = [&keys, &index](uint32_t a, uint32_t b)
+    { return (keys[a] < keys[b]) || ((keys[a] == keys[b]) && (index.name(a) < index.name(b))); };
+
+    // the image is found with its old key, then inserted with the new one
+    auto it = std::lower_bound(order.begin(), order.end(), id, less);
+    if ((it == order.end()) || (*it != id))
+        it = std::find(order.begin(), order.end(), id);
+    if (!this->ready[ORDER_COUNT] || (it == order.end()))
+    {
+        keys[id] = count;
+        return false;
+    }
+    order.erase(it);
+    keys[id] = count;
+    order.insert(std::lower_bound(order.begin(), order.end(), id, less), id);
+    return true;
+}
+
+bool ImageOrders::natural_less(const std::string &a, const std::string &b)
+{
+    size_t i = 0, j = 0;
+    while ((i < a.size()) && (j < b.size()))
+    {
+        if (is_digit(a[i]) && is_digit(b[j]))
+        {
+            // leading zeros skipped, then the longest number is the largest
+            while ((i < a.size()) && (a[i] == '0'))
+                i++;
+            while ((j < b.size()) && (b[j] == '0'))
+                j++;
+            size_t si = i, sj = j;
+            while ((i < a.size()) && is_digit(a[i]))
+                i++;
+            while ((j < b.size()) && is_digit(b[j]))
+                j++;
+            if (i - si != j - sj)
+                return (i - si) < (j - sj);
+            int c = a.compare(si, i - si, b, sj, j - sj);
+            if (c != 0)
+                return c < 0;
+        }
+        else
+        {
+            if (a[i] != b[j])
+                return (unsigned char)a[i] < (unsigned char)b[j];
+            i++;
+            j++;
+        }
+    }
+
+    // a name which is the start of the other comes first, equal numbers ("01" and "1") in lexical order
+    if ((i == a.size()) != (j == b.size()))
+        return i == a.size();
+    return a < b;
+}
@@ -0,0 +1,280 @@
+#include "yacvat/manifest.h"
+#include "yacvat/mapped_file.h"
+#include "yacvat/files.h"
+#include "yacvat/video_source.h"
+#include "spdlog/spdlog.h"
+
+#include <sys/stat.h>
+#include <cstring>
+#include <algorithm>
+
+static const char MANIFEST_MAGIC[8] = {'Y', 'C', 'V', 'T', 'M', 'A', 'N', '4'};
+
+// bounds checked reader over the mapped file
+class ManifestReader
+{
+public:
+    ManifestReader(const unsigned char *data, size_t size) : data(data), size(size), pos(0), ok(true) {}
+
+    template <typename T>
+    T get(void)
+    {
+        T v = 0;
+        if (this->pos + sizeof(T) > this->size)
+        {
+            this->ok = false;
+            return v;
+        }
+        memcpy(&v, this->data + this->pos, sizeof(T));
+        this->pos += sizeof(T);
+        return v;
+    }
+
+    std::string get_string(void)
+    {
+        uint32_t length = this->get<uint32_t>();
+        if (!this->ok || (this->pos + length > this->size))
+        {
+            this->ok = false;
+            return std::string();
+        }
+        std::string s((const char *)this->data + this->pos, length);
+        this->pos += length;
+        return s;
+    }
+
+    bool good(void) { return this->ok; }
+
+private:
+    const unsigned char *data;
+    size_t size;
+    size_t pos;
+    bool ok;
+};
+
+template <typename T>
+static void put(std::string &s, T v)
+{
+    s.append((const char *)&v, sizeof(T));
+}
+
+static void put_string(std::string &s, const std::string &v)
+{
+    put<uint32_t>(s, v.size());
+    s += v;
+}
+
+std::string manifest_join(const std::string &dir, const std::string &name)
+{
+    return dir.empty() ? name : dir + "/" + name;
+}
+
+void manifest_entries(const std::string &path, const manifest_file_t &f, std::vector<std::string> &entries, uint32_t first)
+{
+    if (f.frames == 0)
+    {
+        if (first == 0)
+            entries.push_back(path);
+        return;
+    }
+    for (uint32_t n = first; n < f.frames; n++)
+        entries.push_back(video_frame_name(path, n));
+}
+
+// FNV-1a of the accepted extensions
+uint64_t manifest_extensions_hash(const std::set<std::string> &extensions)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (auto &ext : extensions)
+    {
+        for (char c : ext + ";")
+        {
+            h ^= (unsigned char)c;
+            h *= 0x100000001b3ULL;
+        }
+    }
+    return h;
+}
+
+int64_t manifest_mtime(const struct stat &st)
+{
+    return (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+DatasetManifest::DatasetManifest(void)
+{
+}
+
+void DatasetManifest::clear(void)
+{
+    this->dirs.clear();
+    this->index.clear();
+}
+
+const manifest_dir_t *DatasetManifest::find(const std::string &path)
+{
+    auto it = this->index.find(path);
+    return (it == this->index.end()) ? nullptr : &this->dirs[it->second];
+}
+
+void DatasetManifest::build_index(void)
+{
+    this->index.clear();
+    for (size_t n = 0; n < this->dirs.size(); n++)
+    {
+        this->dirs[n].subdirs.clear();
+        this->index[this->dirs[n].path] = n;
+    }
+
+    for (auto &dir : this->dirs)
+    {
+        if (dir.path.empty())
+            continue;
+        size_t slash = dir.path.find_last_of('/');
+        auto parent = this->index.find((slash == std::string::npos) ? std::string("") : dir.path.substr(0, slash));
+        if (parent != this->index.end())
+            this->dirs[parent->second].subdirs.push_back(dir.path);
+    }
+}
+
+bool DatasetManifest::read(const std::string &fname, uint64_t extensions_hash, std::vector<std::string> *paths)
+{
+    this->clear();
+
+    MappedFile file;
+    if (!file_exists(fname) || !file.open(fname))
+        return false;
+
+    ManifestReader r(file.data(), file.size());
+    if ((file.size() < sizeof(MANIFEST_MAGIC)) || (memcmp(file.data(), MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) != 0))
+    {
+        spdlog::warn("Ignoring manifest {} : unknown format", fname.c_str());
+        return false;
+    }
+    r.get<uint64_t>(); // magic
+
+    // listed with other extensions : everything must be read again
+    if (r.get<uint64_t>() != extensions_hash)
+        return false;
+
+    uint32_t ndirs = r.get<uint32_t>();
+    uint64_t nfiles = r.get<uint64_t>();
+    if (!r.good() || (ndirs > file.size()) || (nfiles > file.size()))
+        return false;
+
+    this->dirs.resize(ndirs);
+    for (auto &dir : this->dirs)
+    {
+        dir.mtime = r.get<int64_t>();
+        dir.path = r.get_string();
+    }
+
+    // files in the order of their sorted relative paths : also sorted by name inside each folder
+    if (paths != nullptr)
+    {
+        paths->clear();
+        paths->reserve(nfiles);
+    }
+    uint64_t nread = 0;
+    for (; (nread < nfiles) && r.good(); nread++)
+    {
+        manifest_file_t f;
+        uint32_t dir = r.get<uint32_t>();
+        f.size = r.get<uint64_t>();
+        f.mtime = r.get<int64_t>();
+        f.width = r.get<int32_t>();
+        f.height = r.get<int32_t>();
+        f.format = r.get<uint8_t>();
+        f.supported = (r.get<uint8_t>() != 0);
+        f.frames = r.get<uint32_t>();
+        uint32_t nhashes = r.get<uint32_t>();
+        if (!r.good() || (nhashes > file.size()))
+            break;
+        f.hashes.resize(nhashes);
+        for (auto &h : f.hashes)
+        {
+            h.content = r.get<uint64_t>();
+            h.ahash = r.get<uint64_t>();
+            h.dhash = r.get<uint64_t>();
+            h.flags = r.get<uint8_t>();
+        }
+        f.name = r.get_string();
+        if (dir >= ndirs)
+            break;
+
+        if ((paths != nullptr) && f.supported)
+            manifest_entries(manifest_join(this->dirs[dir].path, f.name), f, *paths);
+        this->dirs[dir].files.push_back(std::move(f));
+    }
+
+    if (!r.good() || (nread != nfiles))
+    {
+        spdlog::warn("Ignoring manifest {} : truncated", fname.c_str());
+        this->clear();
+        if (paths != nullptr)
+            paths->clear();
+        return false;
+    }
+
+    this->build_index();
+    spdlog::debug("Manifest {} : {} folders, {} files", fname.c_str(), ndirs, nfiles);
+    return true;
+}
+
+bool DatasetManifest::write(const std::string &fname, uint64_t extensions_hash)
+{
+    // global order of the files
+    typedef struct
+    {
+        std::string path;
+        uint32_t dir;
+        uint32_t file;
+    } order_t;
+
+    std::vector<order_t> order;
+    for (size_t d = 0; d < this->dirs.size(); d++)
+    {
+        for (size_t f = 0; f < this->dirs[d].files.size(); f++)
+            order.push_back({manifest_join(this->dirs[d].path, this->dirs[d].files[f].name), (uint32_t)d, (uint32_t)f});
+    }
+    std::sort(order.begin(), order.end(), [](const order_t &a, const order_t &b)
+              { return a.path < b.path; });
+
+    std::string s;
+    s.reserve(64 + 48 * order.size());
+    s.append(MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+    put<uint64_t>(s, extensions_hash);
+    put<uint32_t>(s, this->dirs.size());
+    put<uint64_t>(s, order.size());
+
+    for (auto &dir : this->dirs)
+    {
+        put<int64_t>(s, dir.mtime);
+        put_string(s, dir.path);
+    }
+
+    for (auto &o : order)
+    {
+        const manifest_file_t &f = this->dirs[o.dir].files[o.file];
+        put<uint32_t>(s, o.dir);
+        put<uint64_t>(s, f.size);
+        put<int64_t>(s, f.mtime);
+        put<int32_t>(s, f.width);
+        put<int32_t>(s, f.height);
+        put<uint8_t>(s, f.format);
+        put<uint8_t>(s, f.supported ? 1 : 0);
+        put<uint32_t>(s, f.frames);
+        put<uint32_t>(s, f.hashes.size());
+        for (auto &h : f.hashes)
+        {
+            put<uint64_t>(s, h.content);
+            put<uint64_t>(s, h.ahash);
+            put<uint64_t>(s, h.dhash);
+            put<uint8_t>(s, h.flags);
+        }
+        put_string(s, f.name);
+    }
+
+    spdlog::debug("Writing manifest {} : {} folders, {} files", fname.c_str(), this->dirs.size(), order.size());
+    return write_file_atomic(fname, s);
+}
@@ -0,0 +1,73 @@
+#include "yacvat/mapped_file.h"
+#include "spdlog/spdlog.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+
+MappedFile::MappedFile(void)
+{
+    this->ptr = nullptr;
+    this->length = 0;
+}
+
+MappedFile::~MappedFile(void)
+{
+    this->close();
+}
+
+bool MappedFile::open(const std::string &fname)
+{
+    this->close();
+
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        spdlog::error("Cannot open file : {}", fname.c_str());
+        return false;
+    }
+
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size == 0))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping stays valid once the descriptor is closed
+    ::close(fd);
+
+    if (p == MAP_FAILED)
+    {
+        spdlog::error("Cannot map file : {}", fname.c_str());
+        return false;
+    }
+
+    this->ptr = (unsigned char *)p;
+    this->length = st.st_size;
+    return true;
+}
+
+void MappedFile::close(void)
+{
+    if (this->ptr != nullptr)
+        munmap(this->ptr, this->length);
+    this->ptr = nullptr;
+    this->length = 0;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length)
+{
+    if ((this->ptr == nullptr) || (offset >= this->length))
+        return;
+
+    // madvise works on whole pages
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t start = offset & ~(page - 1);
+    size_t end = std::min(this->length, offset + length);
+    madvise(this->ptr + start, end - start, MADV_WILLNEED);
+}
@@ -0,0 +1,87 @@
+#include "yacvat/minimap.h"
+
+#include <algorithm>
+
+static const float MINIMAP_SIZE = 160.0f;  // longest side of the overview (pixels)
+static const float MINIMAP_MARGIN = 8.0f;  // to the corner of the panel
+static const int MINIMAP_BINS = 24;        // cells of the density grid on each side
+
+Minimap::Minimap(void)
+{
+    this->bins.assign(MINIMAP_BINS * MINIMAP_BINS, 0);
+    this->max_count = 0;
+    this->dragging_flag = false;
+}
+
+void Minimap::layout(ImVec2 panel_min, ImVec2 panel_max, int width, int height, ImVec2 *min, ImVec2 *max)
+{
+    // bottom right corner, aspect ratio of the image
+    float ratio = MINIMAP_SIZE / std::max(1, std::max(width, height));
+    float w = std::max(1.0f, width * ratio);
+    float h = std::max(1.0f, height * ratio);
+    *max = ImVec2(panel_max.x - MINIMAP_MARGIN, panel_max.y - MINIMAP_MARGIN);
+    *min = ImVec2(std::max(panel_min.x, max->x - w), std::max(panel_min.y, max->y - h));
+}
+
+void Minimap::set_density(const std::vector<ImVec2> &points)
+{
+    std::fill(this->bins.begin(), this->bins.end(), 0);
+    this->max_count = 0;
+    for (auto &p : points)
+    {
+        if ((p.x < 0.0f) || (p.y < 0.0f) || (p.x > 1.0f) || (p.y > 1.0f))
+            continue;
+        int x = std::min(MINIMAP_BINS - 1, (int)(p.x * MINIMAP_BINS));
+        int y = std::min(MINIMAP_BINS - 1, (int)(p.y * MINIMAP_BINS));
+        uint16_t &bin = this->bins[y * MINIMAP_BINS + x];
+        if (bin < UINT16_MAX)
+            bin++;
+        this->max_count = std::max(this->max_count, (int)bin);
+    }
+}
+
+bool Minimap::draw(ImDrawList *draw_list, ImVec2 min, ImVec2 max, ImVec2 view_min, ImVec2 view_max, bool *clicked, ImVec2 *target)
+{
+    float w = max.x - min.x;
+    float h = max.y - min.y;
+
+    // density : the fuller bins are more opaque
+    if (this->max_count > 0)
+    {
+        float cell_w = w / MINIMAP_BINS;
+        float cell_h = h / MINIMAP_BINS;
+        for (int y = 0; y < MINIMAP_BINS; y++)
+        {
+            for (int x = 0; x < MINIMAP_BINS; x++)
+            {
+                int count = this->bins[y * MINIMAP_BINS + x];
+                if (count == 0)
+                    continue;
+                int alpha = 60 + (160 * count) / this->max_count;
+                ImVec2 p0(min.x + x * cell_w, min.y + y * cell_h);
+                ImVec2 p1(p0.x + cell_w, p0.y + cell_h);
+                draw_list->AddRectFilled(p0, p1, IM_COL32(255, 80, 40, alpha));
+            }
+        }
+    }
+
+    // part of the image in view, and the border of the overview
+    ImVec2 v0(min.x + view_min.x * w, min.y + view_min.y * h);
+    ImVec2 v1(min.x + view_max.x * w, min.y + view_max.y * h);
+    draw_list->AddRect(v0, v1, IM_COL32(255, 255, 255, 230), 0.0f, 0, 1.5f);
+    draw_list->AddRect(min, max, IM_COL32(0, 0, 0, 200));
+
+    // click, then drag until the button is released even out of the overview : the point under the cursor
+    bool hovered = ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect(min, max);
+    if (hovered && ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+        this->dragging_flag = true;
+    if (!ImGui::IsMouseDown(ImGuiMouseButton_Left))
+        this->dragging_flag = false;
+    *clicked = this->dragging_flag;
+    if (*clicked)
+    {
+        ImVec2 m = ImGui::GetMousePos();
+        *target = ImVec2(std::min(1.0f, std::max(0.0f, (m.x - min.x) / w)), std::min(1.0f, std::max(0.0f, (m.y - min.y) / h)));
+    }
+    return hovered || this->dragging_flag;
+}
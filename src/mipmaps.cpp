@@ -0,0 +1,173 @@
+#include "yacvat/mipmaps.h"
+#include "yacvat/gl_functions.h"
+#include "yacvat/frame_profile.h"
+#include "spdlog/spdlog.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+
+static bool load_gl(void)
+{
+    static bool tried = false;
+    gl_load();
+    if (!tried && !gl.textures)
+        spdlog::warn("glGenerateMipmap is not available : arrays and videos are shown without mipmaps");
+    tried = true;
+    return gl.textures;
+}
+
+// trilinear sampling over the levels 0 to max_level
+static void enable_levels(GLuint texture, int max_level)
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, max_level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+}
+
+MipmapBuilder::MipmapBuilder(void)
+{
+    this->texture = 0;
+    this->gpu_wait = 0;
+}
+
+MipmapBuilder::~MipmapBuilder(void)
+{
+    this->cancel();
+}
+
+void MipmapBuilder::start(ThreadPool &pool, GLuint texture, unsigned char *pixels, int width, int height, int thumbnail_size)
+{
+    this->cancel();
+
+    std::shared_ptr<job_t> job = std::make_shared<job_t>();
+    job->cancel_flag = false;
+    job->done_flag = false;
+    job->thumbnail_size = thumbnail_size;
+    this->job = job;
+    this->texture = texture;
+    pool.submit([job, pixels, width, height]()
+                { MipmapBuilder::reduce(job, pixels, width, height); });
+}
+
+void MipmapBuilder::start_gpu(const GLuint *textures, int count)
+{
+    this->cancel();
+    for (int k = 0; k < count; k++)
+    {
+        bool shared = false;
+        for (auto t : this->gpu_textures)
+            shared = shared || (t == textures[k]);
+        if ((textures[k] != 0) && !shared)
+            this->gpu_textures.push_back(textures[k]);
+    }
+    this->gpu_wait = 1;
+}
+
+void MipmapBuilder::cancel(void)
+{
+    if (this->job)
+        this->job->cancel_flag = true;
+    this->job.reset();
+    this->texture = 0;
+    this->gpu_textures.clear();
+    this->thumbnail.pixels.clear();
+}
+
+bool MipmapBuilder::poll(void)
+{
+    // the driver builds the levels once the texture has been drawn a first time
+    if (!this->gpu_textures.empty())
+    {
+        if (this->gpu_wait-- > 0)
+            return false;
+        FrameTimer timer(PHASE_UPLOAD);
+        bool loaded = load_gl();
+        for (auto t : this->gpu_textures)
+        {
+            if (!loaded)
+                break;
+            glBindTexture(GL_TEXTURE_2D, t);
+            gl.GenerateMipmap(GL_TEXTURE_2D);
+            GLint width = 0, height = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+            int levels = 0;
+            for (int size = std::max(width, height); size > 1; size /= 2)
+                levels++;
+            enable_levels(t, levels);
+        }
+        this->gpu_textures.clear();
+        return loaded;
+    }
+
+    if (!this->job || !this->job->done_flag)
+        return false;
+
+    std::shared_ptr<job_t> job = this->job;
+    this->job.reset();
+
+    FrameTimer timer(PHASE_UPLOAD);
+    glBindTexture(GL_TEXTURE_2D, this->texture);
+#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+    for (size_t k = 0; k < job->levels.size(); k++)
+    {
+        const level_t &level = job->levels[k];
+        glTexImage2D(GL_TEXTURE_2D, (GLint)k + 1, GL_RGBA, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, level.pixels.data());
+    }
+    enable_levels(this->texture, (int)job->levels.size());
+    spdlog::debug("{} mipmap levels uploaded", job->levels.size());
+    this->thumbnail = std::move(job->thumbnail);
+    return true;
+}
+
+bool MipmapBuilder::take_thumbnail(std::vector<unsigned char> &pixels, int *width, int *height)
+{
+    if (this->thumbnail.pixels.empty())
+        return false;
+    pixels.swap(this->thumbnail.pixels);
+    *width = this->thumbnail.width;
+    *height = this->thumbnail.height;
+    this->thumbnail.pixels.clear();
+    return true;
+}
+
+void MipmapBuilder::reduce(std::shared_ptr<job_t> job, unsigned char *pixels, int width, int height)
+{
+    const unsigned char *src = pixels;
+    int w = width, h = height;
+    while (((w > 1) || (h > 1)) && !job->cancel_flag)
+    {
+        // each pixel is the mean of a 2x2 block, the last row or column is repeated on odd sizes
+        level_t level;
+        level.width = std::max(1, w / 2);
+        level.height = std::max(1, h / 2);
+        level.pixels.resize((size_t)level.width * level.height * 4);
+        unsigned char *dst = level.pixels.data();
+        for (int y = 0; y < level.height; y++)
+        {
+            const unsigned char *row0 = src + (size_t)std::min(2 * y, h - 1) * w * 4;
+            const unsigned char *row1 = src + (size_t)std::min(2 * y + 1, h - 1) * w * 4;
+            for (int x = 0; x < level.width; x++)
+            {
+                size_t x0 = (size_t)std::min(2 * x, w - 1) * 4;
+                size_t x1 = (size_t)std::min(2 * x + 1, w - 1) * 4;
+                for (int c = 0; c < 4; c++)
+                    *dst++ = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+
+        job->levels.push_back(std::move(level));
+        src = job->levels.back().pixels.data();
+        w = job->levels.back().width;
+        h = job->levels.back().height;
+
+        // the first level small enough is kept for the thumbnails
+        if ((job->thumbnail_size > 0) && job->thumbnail.pixels.empty() && (std::max(w, h) <= job->thumbnail_size))
+            job->thumbnail = job->levels.back();
+    }
+    stbi_image_free(pixels);
+    job->done_flag = !job->cancel_flag;
+}
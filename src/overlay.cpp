@@ -0,0 +1,203 @@
+#include "yacvat/overlay.h"
+#include "yacvat/gl_functions.h"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+// program shared by every renderer, linked on the first frame
+static struct
+{
+    GLuint id;
+    bool failed;
+    GLint proj;
+} program;
+
+// attribute locations, bound before the link
+static const GLuint ATTRIB_RECT = 0;
+static const GLuint ATTRIB_COLOR = 1;
+static const GLuint ATTRIB_STYLE = 2;
+
+static const char *VERTEX_SHADER =
+    "uniform mat4 ProjMtx;\n"
+    "in vec4 Rect;\n"
+    "in vec4 Color;\n"
+    "in vec4 Style;\n"
+    "out vec2 Frag_Pos;\n"
+    "flat out vec4 Frag_Rect;\n"
+    "flat out vec4 Frag_Color;\n"
+    "flat out vec4 Frag_Style;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));\n"
+    "    float pad = 0.5 * Style.x + 1.0;\n"
+    "    vec2 lo = (Style.z > 0.5) ? Rect.xy - vec2(Rect.z) : min(Rect.xy, Rect.zw);\n"
+    "    vec2 hi = (Style.z > 0.5) ? Rect.xy + vec2(Rect.z) : max(Rect.xy, Rect.zw);\n"
+    "    vec2 pos = mix(lo - vec2(pad), hi + vec2(pad), corner);\n"
+    "    Frag_Pos = pos;\n"
+    "    Frag_Rect = vec4(lo, hi);\n"
+    "    Frag_Color = Color;\n"
+    "    Frag_Style = Style;\n"
+    "    gl_Position = ProjMtx * vec4(pos, 0.0, 1.0);\n"
+    "}\n";
+
+// signed distance to the shape (negative inside), the outline is centered on the shape like AddRect and AddCircle
+static const char *FRAGMENT_SHADER =
+    "in vec2 Frag_Pos;\n"
+    "flat in vec4 Frag_Rect;\n"
+    "flat in vec4 Frag_Color;\n"
+    "flat in vec4 Frag_Style;\n"
+    "out vec4 Out_Color;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 center = 0.5 * (Frag_Rect.xy + Frag_Rect.zw);\n"
+    "    vec2 half_span = 0.5 * (Frag_Rect.zw - Frag_Rect.xy);\n"
+    "    float d;\n"
+    "    if (Frag_Style.z > 0.5)\n"
+    "        d = length(Frag_Pos - center) - half_span.x;\n"
+    "    else\n"
+    "    {\n"
+    "        vec2 q = abs(Frag_Pos - center) - half_span;\n"
+    "        d = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0);\n"
+    "    }\n"
+    "    float line = clamp(0.5 * Frag_Style.x + 0.5 - abs(d), 0.0, 1.0) * Frag_Color.a;\n"
+    "    float fill = (d < 0.0) ? Frag_Style.y : 0.0;\n"
+    "    float alpha = line + (1.0 - line) * fill;\n"
+    "    if (alpha <= 0.0)\n"
+    "        discard;\n"
+    "    Out_Color = vec4(Frag_Color.rgb, alpha);\n"
+    "}\n";
+
+static bool build_program(void)
+{
+    if ((program.id != 0) || program.failed)
+        return program.id != 0;
+    program.failed = true;
+    gl_load();
+    if (!gl.shaders || !gl.instanced)
+    {
+        spdlog::warn("OpenGL instanced drawing is not available : the annotations are drawn one by one");
+        return false;
+    }
+
+    static const char *attributes[] = {"Rect", "Color", "Style"};
+    static const GLint locations[] = {ATTRIB_RECT, ATTRIB_COLOR, ATTRIB_STYLE};
+    GLuint id = gl_build_program("overlay", VERTEX_SHADER, FRAGMENT_SHADER, attributes, locations, 3);
+    if (id == 0)
+        return false;
+
+    program.id = id;
+    program.failed = false;
+    program.proj = gl.GetUniformLocation(id, "ProjMtx");
+    return true;
+}
+
+OverlayRenderer::OverlayRenderer(void)
+{
+    this->vao = 0;
+    this->vbo = 0;
+    this->capacity = 0;
+}
+
+OverlayRenderer::~OverlayRenderer(void)
+{
+    this->release();
+}
+
+void OverlayRenderer::release(void)
+{
+    if (this->vbo != 0)
+        gl.DeleteBuffers(1, &this->vbo);
+    if (this->vao != 0)
+        gl.DeleteVertexArrays(1, &this->vao);
+    this->vao = 0;
+    this->vbo = 0;
+    this->capacity = 0;
+}
+
+bool OverlayRenderer::available(void)
+{
+    return build_program();
+}
+
+void OverlayRenderer::clear(ImVec2 clip_min, ImVec2 clip_max)
+{
+    this->instances.clear();
+    this->clip_min = clip_min;
+    this->clip_max = clip_max;
+}
+
+void OverlayRenderer::add_box(float x0, float y0, float x1, float y1, const uint8_t color[4], float thickness, float fill_alpha)
+{
+    float pad = 0.5f * thickness + 1.0f;
+    if ((std::max(x0, x1) + pad < this->clip_min.x) || (std::min(x0, x1) - pad > this->clip_max.x) ||
+        (std::max(y0, y1) + pad < this->clip_min.y) || (std::min(y0, y1) - pad > this->clip_max.y))
+        return;
+    overlay_instance_t instance = {
+        {std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1)},
+        {color[0] / 255.0f, color[1] / 255.0f, color[2] / 255.0f, color[3] / 255.0f},
+        {thickness, fill_alpha, (float)OVERLAY_BOX, 0.0f}};
+    this->instances.push_back(instance);
+}
+
+void OverlayRenderer::add_circle(float x, float y, float radius, const uint8_t color[4], float thickness, float fill_alpha)
+{
+    float pad = radius + 0.5f * thickness + 1.0f;
+    if ((x + pad < this->clip_min.x) || (x - pad > this->clip_max.x) || (y + pad < this->clip_min.y) || (y - pad > this->clip_max.y))
+        return;
+    overlay_instance_t instance = {
+        {x, y, radius, 0.0f},
+        {color[0] / 255.0f, color[1] / 255.0f, color[2] / 255.0f, color[3] / 255.0f},
+        {thickness, fill_alpha, (float)OVERLAY_CIRCLE, 0.0f}};
+    this->instances.push_back(instance);
+}
+
+void OverlayRenderer::draw(ImDrawList *draw_list)
+{
+    if (this->instances.empty())
+        return;
+    draw_list->AddCallback(OverlayRenderer::render, this);
+    draw_list->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+}
+
+void OverlayRenderer::render(const ImDrawList *draw_list, const ImDrawCmd *cmd)
+{
+    (void)draw_list;
+    OverlayRenderer *overlay = (OverlayRenderer *)cmd->UserCallbackData;
+    if (!build_program())
+        return;
+
+    float proj[16];
+    if (!gl_callback_setup(cmd, proj))
+        return;
+
+    // vertex array of the instance attributes, created in the context of the first frame
+    if (overlay->vao == 0)
+    {
+        gl.GenVertexArrays(1, &overlay->vao);
+        gl.GenBuffers(1, &overlay->vbo);
+        gl.BindVertexArray(overlay->vao);
+        gl.BindBuffer(GL_ARRAY_BUFFER, overlay->vbo);
+        const GLuint attribs[3] = {ATTRIB_RECT, ATTRIB_COLOR, ATTRIB_STYLE};
+        for (int k = 0; k < 3; k++)
+        {
+            gl.EnableVertexAttribArray(attribs[k]);
+            gl.VertexAttribPointer(attribs[k], 4, GL_FLOAT, GL_FALSE, sizeof(overlay_instance_t), (void *)(intptr_t)(k * 4 * sizeof(float)));
+            gl.VertexAttribDivisor(attribs[k], 1);
+        }
+    }
+    else
+    {
+        gl.BindVertexArray(overlay->vao);
+        gl.BindBuffer(GL_ARRAY_BUFFER, overlay->vbo);
+    }
+
+    // the buffer grows to the largest frame, its storage is orphaned on every frame so the write does not wait for the previous draw
+    size_t bytes = overlay->instances.size() * sizeof(overlay_instance_t);
+    overlay->capacity = std::max(overlay->instances.size(), overlay->capacity);
+    gl.BufferData(GL_ARRAY_BUFFER, overlay->capacity * sizeof(overlay_instance_t), nullptr, GL_STREAM_DRAW);
+    gl.BufferSubData(GL_ARRAY_BUFFER, 0, bytes, overlay->instances.data());
+
+    gl.UseProgram(program.id);
+    gl.UniformMatrix4fv(program.proj, 1, GL_FALSE, proj);
+    gl.DrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)overlay->instances.size());
+}
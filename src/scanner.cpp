@@ -0,0 +1,362 @@
+#include "yacvat/scanner.h"
+#include "yacvat/image_info.h"
+#include "yacvat/files.h"
+#include "yacvat/video_source.h"
+#include "spdlog/spdlog.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+static const size_t FLUSH_SIZE = 1024; // files published at once by a task reading a large folder
+
+FolderScanner::FolderScanner(void)
+{
+}
+
+FolderScanner::~FolderScanner(void)
+{
+    this->cancel();
+}
+
+void FolderScanner::start(ThreadPool &pool, std::string folder, const std::set<std::string> &extensions, std::string manifest_fname)
+{
+    this->cancel();
+
+    this->job = std::make_shared<job_t>();
+    this->job->pool = &pool;
+    this->job->folder = folder;
+    this->job->manifest_fname = manifest_fname;
+    this->job->extensions = extensions;
+    this->job->extensions_hash = manifest_extensions_hash(extensions);
+    this->job->pending = 1;
+    this->job->found = 0;
+    this->job->changed = false;
+    this->job->cancel_flag = false;
+
+    spdlog::info("Browsing folder : {}", folder.c_str());
+
+    std::shared_ptr<job_t> _job = this->job;
+    pool.submit([_job]()
+                { FolderScanner::load(_job); });
+}
+
+void FolderScanner::cancel(void)
+{
+    if (this->job)
+        this->job->cancel_flag = true;
+    this->job.reset();
+}
+
+bool FolderScanner::running(void)
+{
+    return this->job && (this->job->pending > 0);
+}
+
+size_t FolderScanner::available(void)
+{
+    if (!this->job)
+        return 0;
+    std::lock_guard<std::mutex> lock(this->job->mutex);
+    return this->job->batch.size() + this->job->removed.size();
+}
+
+void FolderScanner::take(std::vector<std::string> &added, std::vector<std::string> &removed)
+{
+    added.clear();
+    removed.clear();
+    if (!this->job)
+        return;
+
+    // both at once : a file removed is always taken with or after its addition
+    std::lock_guard<std::mutex> lock(this->job->mutex);
+    added.swap(this->job->batch);
+    removed.swap(this->job->removed);
+}
+
+long FolderScanner::found(void)
+{
+    return this->job ? this->job->found.load() : 0;
+}
+
+void FolderScanner::folders(std::vector<std::pair<std::string, int64_t>> &folders)
+{
+    folders.clear();
+    if (!this->job)
+        return;
+    std::lock_guard<std::mutex> lock(this->job->mutex);
+    folders = this->job->folders;
+}
+
+std::shared_ptr<const DatasetManifest> FolderScanner::listing(void)
+{
+    if (!this->job)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(this->job->mutex);
+    return this->job->listing;
+}
+
+void FolderScanner::flush(std::shared_ptr<job_t> &job, std::vector<std::string> &files, bool removed)
+{
+    if (files.empty())
+        return;
+
+    job->found += removed ? -(long)files.size() : (long)files.size();
+    std::lock_guard<std::mutex> lock(job->mutex);
+    std::vector<std::string> &batch = removed ? job->removed : job->batch;
+    if (batch.empty())
+        batch.swap(files);
+    else
+        batch.insert(batch.end(), std::make_move_iterator(files.begin()), std::make_move_iterator(files.end()));
+    files.clear();
+}
+
+void FolderScanner::load(std::shared_ptr<job_t> job)
+{
+    if (!job->manifest_fname.empty())
+    {
+        std::vector<std::string> paths;
+        if (job->cache.read(job->manifest_fname, job->extensions_hash, &paths))
+        {
+            spdlog::info("Manifest : {} images listed by the previous scan", paths.size());
+            FolderScanner::flush(job, paths, false);
+        }
+    }
+
+    FolderScanner::scan_folder(job, "");
+}
+
+void FolderScanner::scan_folder(std::shared_ptr<job_t> job, std::string path)
+{
+    std::string full_path = path.empty() ? job->folder : job->folder + "/" + path;
+    const manifest_dir_t *cached = job->cache.find(path);
+
+    struct stat st;
+    if (job->cancel_flag || (stat(full_path.c_str(), &st) != 0))
+    {
+        if (!job->cancel_flag)
+        {
+            spdlog::error("Folder {} cannot be open", full_path.c_str());
+            if (cached != nullptr)
+                FolderScanner::remove_tree(job, path);
+            job->changed = true;
+        }
+        FolderScanner::finish(job);
+        return;
+    }
+
+    manifest_dir_t dir;
+    dir.path = path;
+    dir.mtime = manifest_mtime(st);
+
+    if ((cached != nullptr) && (cached->mtime == dir.mtime))
+    {
+        // no entry added, removed or renamed since the manifest
+        dir.files = cached->files;
+        dir.subdirs = cached->subdirs;
+    }
+    else
+    {
+        FolderScanner::read_folder(job, cached, dir);
+        job->changed = true;
+    }
+
+    // sub folders are checked by other tasks, counted before this one ends so pending never drops to 0 early
+    for (auto &sub : dir.subdirs)
+    {
+        job->pending++;
+        std::string _sub = sub;
+        job->pool->submit([job, _sub]()
+                          { FolderScanner::scan_folder(job, _sub); });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->folders.push_back(std::make_pair(dir.path, dir.mtime));
+        job->scanned.push_back(std::move(dir));
+    }
+
+    FolderScanner::finish(job);
+}
+
+void FolderScanner::read_folder(std::shared_ptr<job_t> &job, const manifest_dir_t *cached, manifest_dir_t &dir)
+{
+    std::string full_path = dir.path.empty() ? job->folder : job->folder + "/" + dir.path;
+    std::vector<std::string> names;
+
+    DIR *d = opendir(full_path.c_str());
+    if (d == nullptr)
+    {
+        spdlog::error("Folder {} cannot be open", full_path.c_str());
+        return;
+    }
+
+    struct dirent *diread;
+    while (((diread = readdir(d)) != nullptr) && !job->cancel_flag)
+    {
+        // hidden entries, "." and ".."
+        if (diread->d_name[0] == '.')
+            continue;
+
+        std::string fn = diread->d_name;
+        unsigned char type = diread->d_type;
+        if (type == DT_UNKNOWN)
+        {
+            // some file systems do not fill d_type
+            struct stat st;
+            if (fstatat(dirfd(d), fn.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+        }
+
+        if (type == DT_DIR)
+        {
+            dir.subdirs.push_back(manifest_join(dir.path, fn));
+            continue;
+        }
+
+        // the extension (whatever its case) selects the files, their signature tells the format
+        if (job->extensions.find(file_extension(fn)) == job->extensions.end())
+            continue;
+        names.push_back(fn);
+    }
+
+    std::sort(names.begin(), names.end());
+    std::vector<std::string> added, removed;
+    size_t c = 0; // position in the sorted files of the manifest
+
+    for (auto &fn : names)
+    {
+        if (job->cancel_flag)
+            break;
+
+        manifest_file_t f;
+        f.name = fn;
+        f.size = 0;
+        f.mtime = 0;
+        f.width = 0;
+        f.height = 0;
+        f.format = IMAGE_FORMAT_UNKNOWN;
+        f.supported = false;
+        f.frames = 0;
+
+        struct stat st;
+        if (fstatat(dirfd(d), fn.c_str(), &st, 0) == 0)
+        {
+            f.size = st.st_size;
+            f.mtime = manifest_mtime(st);
+        }
+
+        // files of the manifest before this one are gone
+        while ((cached != nullptr) && (c < cached->files.size()) && (cached->files[c].name < fn))
+        {
+            if (cached->files[c].supported)
+                manifest_entries(manifest_join(dir.path, cached->files[c].name), cached->files[c], removed);
+            c++;
+        }
+
+        const manifest_file_t *known = nullptr;
+        if ((cached != nullptr) && (c < cached->files.size()) && (cached->files[c].name == fn))
+            known = &cached->files[c++];
+
+        if ((known != nullptr) && (known->size == f.size) && (known->mtime == f.mtime))
+        {
+            f.width = known->width;
+            f.height = known->height;
+            f.format = known->format;
+            f.supported = known->supported;
+            f.frames = known->frames;
+            f.hashes = known->hashes;
+        }
+        else
+        {
+            // new or modified file : format and dimensions from its header
+            image_format_t format;
+            f.supported = probe_image_file(full_path + "/" + fn, &format, &f.width, &f.height);
+            f.format = format;
+
+            // a video is listed frame by frame : its index is built here, once
+            if (f.supported && VideoSource::handles(fn))
+            {
+                long frames = VideoSource::count_frames(full_path + "/" + fn);
+                f.supported = (frames > 0);
+                f.frames = std::max(0L, frames);
+            }
+        }
+
+        // only the files which can be decoded are listed, a video which changed only publishes its frames added or removed
+        bool listed = (known != nullptr) && known->supported;
+        if (f.supported && !listed)
+            manifest_entries(manifest_join(dir.path, fn), f, added);
+        else if (!f.supported && listed)
+            manifest_entries(manifest_join(dir.path, fn), *known, removed);
+        else if (f.supported && (f.frames > known->frames))
+            manifest_entries(manifest_join(dir.path, fn), f, added, known->frames);
+        else if (f.supported && (f.frames < known->frames))
+            manifest_entries(manifest_join(dir.path, fn), *known, removed, f.frames);
+        if (added.size() >= FLUSH_SIZE)
+            FolderScanner::flush(job, added, false);
+
+        dir.files.push_back(std::move(f));
+    }
+    closedir(d);
+
+    while ((cached != nullptr) && (c < cached->files.size()) && !job->cancel_flag)
+    {
+        if (cached->files[c].supported)
+            manifest_entries(manifest_join(dir.path, cached->files[c].name), cached->files[c], removed);
+        c++;
+    }
+
+    FolderScanner::flush(job, added, false);
+    FolderScanner::flush(job, removed, true);
+
+    // sub folders of the manifest which are gone
+    if (cached != nullptr)
+    {
+        for (auto &sub : cached->subdirs)
+        {
+            if (std::find(dir.subdirs.begin(), dir.subdirs.end(), sub) == dir.subdirs.end())
+                FolderScanner::remove_tree(job, sub);
+        }
+    }
+}
+
+void FolderScanner::remove_tree(std::shared_ptr<job_t> &job, const std::string &path)
+{
+    const manifest_dir_t *cached = job->cache.find(path);
+    if (cached == nullptr)
+        return;
+
+    std::vector<std::string> removed;
+    for (auto &f : cached->files)
+    {
+        if (f.supported)
+            manifest_entries(manifest_join(path, f.name), f, removed);
+    }
+    FolderScanner::flush(job, removed, true);
+
+    for (auto &sub : cached->subdirs)
+        FolderScanner::remove_tree(job, sub);
+}
+
+void FolderScanner::finish(std::shared_ptr<job_t> &job)
+{
+    if ((--job->pending != 0) || job->cancel_flag)
+        return;
+
+    // every other task is done
+    spdlog::info("Folder {} : {} images found", job->folder.c_str(), job->found.load());
+
+    // kept for the sizes and times of the files
+    std::shared_ptr<DatasetManifest> manifest = std::make_shared<DatasetManifest>();
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        manifest->dirs.swap(job->scanned);
+        job->listing = manifest;
+    }
+
+    if (!job->manifest_fname.empty() && job->changed)
+        manifest->write(job->manifest_fname, job->extensions_hash);
+}
@@ -0,0 +1,79 @@
+#include "yacvat/session.h"
+#include "yacvat/files.h"
+#include "spdlog/spdlog.h"
+#include "nlohmann/json.hpp"
+
+#include <fstream>
+#include <cstdlib>
+
+std::string session_path(void)
+{
+    const char *state = getenv("XDG_STATE_HOME");
+    if ((state != nullptr) && (state[0] != '\0'))
+        return std::string(state) + "/yacvat/session.json";
+    const char *home = getenv("HOME");
+    if ((home != nullptr) && (home[0] != '\0'))
+        return std::string(home) + "/.local/state/yacvat/session.json";
+    return "";
+}
+
+void session_clear(session_t &session)
+{
+    session.folder.clear();
+    session.image.clear();
+    session.zoom = 1.0f;
+    session.pan_x = 0.0f;
+    session.pan_y = 0.0f;
+    session.label.clear();
+    session.scroll = 0.0f;
+    session.neighbours.clear();
+}
+
+bool session_load(const std::string &fname, session_t &session)
+{
+    session_clear(session);
+    if (fname.empty() || !file_exists(fname))
+        return false;
+
+    try
+    {
+        std::ifstream f(fname.c_str());
+        nlohmann::json json_data = nlohmann::json::parse(f);
+        session.folder = json_data.value("folder", std::string());
+        session.image = json_data.value("image", std::string());
+        session.zoom = json_data.value("zoom", 1.0f);
+        session.pan_x = json_data.value("pan_x", 0.0f);
+        session.pan_y = json_data.value("pan_y", 0.0f);
+        session.label = json_data.value("label", std::string());
+        session.scroll = json_data.value("scroll", 0.0f);
+        session.neighbours = json_data.value("neighbours", std::vector<std::string>());
+    }
+    catch (nlohmann::json::exception &e)
+    {
+        spdlog::warn("Cannot read the session {} : {}", fname.c_str(), e.what());
+        session_clear(session);
+        return false;
+    }
+
+    return true;
+}
+
+bool session_save(const std::string &fname, const session_t &session)
+{
+    if (fname.empty())
+        return false;
+
+    nlohmann::json json_data;
+    json_data["folder"] = session.folder;
+    json_data["image"] = session.image;
+    json_data["zoom"] = session.zoom;
+    json_data["pan_x"] = session.pan_x;
+    json_data["pan_y"] = session.pan_y;
+    json_data["label"] = session.label;
+    json_data["scroll"] = session.scroll;
+    json_data["neighbours"] = session.neighbours;
+
+    if (!make_directories(parent_directory(fname)))
+        return false;
+    return write_file_atomic(fname, json_data.dump(4));
+}
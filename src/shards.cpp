@@ -0,0 +1,278 @@
+#include "yacvat/shards.h"
+#include "yacvat/files.h"
+#include "spdlog/spdlog.h"
+#include "nlohmann/json.hpp"
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+
+static const char SHARD_EXTENSION[] = ".json";
+
+AnnotationShards::AnnotationShards(void)
+{
+}
+
+void AnnotationShards::set_folder(std::string folder)
+{
+    this->root = folder + "/.yacvat";
+    this->labels_fname = this->root + "/labels.json";
+    this->shards_folder = this->root + "/shards";
+    this->known_labels.clear();
+}
+
+bool AnnotationShards::exists(void)
+{
+    return !this->root.empty() && file_exists(this->labels_fname);
+}
+
+void AnnotationShards::remove_labels(void)
+{
+    std::remove(this->labels_fname.c_str());
+}
+
+std::string AnnotationShards::shard_fname(std::string img_fname)
+{
+    return this->shards_folder + "/" + img_fname + SHARD_EXTENSION;
+}
+
+bool AnnotationShards::write_labels(std::vector<Annotation> &annotations)
+{
+    spdlog::debug("Writing labels file : {}", this->labels_fname.c_str());
+
+    if (!make_directories(this->shards_folder))
+        return false;
+
+    // array rather than object to keep the order of the labels (and their F-key shortcuts)
+    nlohmann::json json_data = nlohmann::json::array();
+    std::set<std::string> written;
+    for (long unsigned n = 0; n < annotations.size(); n++)
+    {
+        json_data.push_back({{"label", annotations[n].label.c_str()},
+                             {"type", annotations[n].type},
+                             {"color", annotations[n].color}});
+        written.insert(annotations[n].label);
+    }
+    this->known_labels.insert(written.begin(), written.end());
+
+    // labels added meanwhile by another instance are kept after ours, the ones removed or renamed here are not
+    try
+    {
+        std::ifstream f(this->labels_fname.c_str());
+        if (f.good())
+        {
+            nlohmann::json on_disk = nlohmann::json::parse(f);
+            for (auto &label : on_disk)
+            {
+                std::string name = label.at("label").get<std::string>();
+                if ((written.count(name) == 0) && (this->known_labels.count(name) == 0))
+                {
+                    json_data.push_back(label);
+                    written.insert(name);
+                }
+            }
+        }
+    }
+    catch (nlohmann::json::exception &e)
+    {
+        spdlog::warn("Cannot merge the labels file {} : {}", this->labels_fname.c_str(), e.what());
+    }
+
+    return write_file_atomic(this->labels_fname, json_data.dump(4) + "\n");
+}
+
+bool AnnotationShards::write_shards(const std::set<std::string> &img_fnames, std::vector<Annotation> &annotations, float scale)
+{
+    bool ret = true;
+
+    // gather the instances of the requested images in a single pass
+    std::map<std::string, nlohmann::json> instances;
+    for (auto &fname : img_fnames)
+    {
+        instances[fname] = nlohmann::json::object();
+    }
+
+    for (long unsigned n = 0; n < annotations.size(); n++)
+    {
+        for (long unsigned m = 0; m < annotations[n].inst.size(); m++)
+        {
+            auto it = instances.find(annotations[n].inst[m].img_fname);
+            if (it == instances.end())
+                continue;
+
+            it->second[annotations[n].label.c_str()].push_back(
+                nlohmann::json::object({
+                    {"x_start", annotations[n].inst[m].rect_on_image.get_topleft_vertex().x / scale},   // x start coordinates
+                    {"y_start", annotations[n].inst[m].rect_on_image.get_topleft_vertex().y / scale},   // y start coordinates
+                    {"x_end", annotations[n].inst[m].rect_on_image.get_bottomright_vertex().x / scale}, // x end coordinates
+                    {"y_end", annotations[n].inst[m].rect_on_image.get_bottomright_vertex().y / scale}  // y end coordinates
+                }));
+        }
+    }
+
+    for (auto it = instances.begin(); it != instances.end(); ++it)
+    {
+        std::string fname = this->shard_fname(it->first);
+        spdlog::debug("Writing shard : {}", fname.c_str());
+
+        // no instance left on the image : the shard is not needed anymore
+        if (it->second.empty())
+        {
+            std::remove(fname.c_str());
+            continue;
+        }
+
+        if (!make_directories(parent_directory(fname)))
+        {
+            ret = false;
+            continue;
+        }
+
+        nlohmann::json json_data = {{"file", it->first.c_str()}, {"instances", it->second}};
+        ret &= write_file_atomic(fname, json_data.dump(4) + "\n");
+    }
+
+    return ret;
+}
+
+void AnnotationShards::list_shards(std::string path, std::vector<std::string> &fnames)
+{
+    DIR *dir;
+    struct dirent *diread;
+
+    if ((dir = opendir(path.c_str())) == nullptr)
+        return;
+
+    size_t ext_len = strlen(SHARD_EXTENSION);
+    while ((diread = readdir(dir)) != nullptr)
+    {
+        if (diread->d_name[0] == '.')
+            continue;
+
+        std::string fn = path + "/" + diread->d_name;
+        if (diread->d_type == DT_DIR)
+        {
+            this->list_shards(fn, fnames);
+        }
+        else if ((fn.size() > ext_len) && (fn.compare(fn.size() - ext_len, ext_len, SHARD_EXTENSION) == 0))
+        {
+            fnames.push_back(fn);
+        }
+    }
+
+    closedir(dir);
+}
+
+void AnnotationShards::read(std::vector<Annotation> &annotations, std::map<std::string, int> &ninstperimage, float scale)
+{
+    spdlog::debug("Parsing labels file : {}", this->labels_fname.c_str());
+
+    // empty list of annotations
+    annotations.clear();
+    ninstperimage.clear();
+
+    // labels configuration
+    std::map<std::string, size_t> label_index;
+    try
+    {
+        std::ifstream f(this->labels_fname.c_str());
+        nlohmann::json json_data = nlohmann::json::parse(f);
+
+        for (nlohmann::json::iterator i = json_data.begin(); i != json_data.end(); ++i)
+        {
+            Annotation _ann = Annotation((*i)["label"].get<std::string>());
+            _ann.type = (*i)["type"].get<annotation_type_t>();
+            auto _vec = (*i)["color"].get<std::vector<float>>();
+            for (int n = 0; (n < 4) && (n < (int)_vec.size()); n++)
+            {
+                _ann.color[n] = _vec[n];
+            }
+            _ann.selected = false;
+
+            label_index[_ann.label] = annotations.size();
+            this->known_labels.insert(_ann.label);
+            annotations.push_back(_ann);
+        }
+    }
+    catch (nlohmann::json::exception &e)
+    {
+        spdlog::error("Cannot parse labels file {} : {}", this->labels_fname.c_str(), e.what());
+        return;
+    }
+
+    // instances, one file per image
+    std::vector<std::string> fnames;
+    this->list_shards(this->shards_folder, fnames);
+    spdlog::debug("{} shards found", fnames.size());
+
+    for (auto &fname : fnames)
+    {
+        this->read_shard(fname, annotations, label_index, ninstperimage, scale);
+    }
+}
+
+void AnnotationShards::read_shard(std::string fname, std::vector<Annotation> &annotations, std::map<std::string, size_t> &label_index, std::map<std::string, int> &ninstperimage, float scale)
+{
+    // the instances are kept only once the whole shard is read : a malformed one is skipped, not fatal
+    std::string img_fname;
+    std::vector<std::pair<size_t, AnnotationInstance>> instances;
+    try
+    {
+        std::ifstream f(fname.c_str());
+        nlohmann::json json_data = nlohmann::json::parse(f);
+
+        img_fname = json_data.at("file").get<std::string>();
+        const nlohmann::json &insts = json_data.at("instances");
+        for (auto i = insts.begin(); i != insts.end(); ++i)
+        {
+            auto it = label_index.find(i.key());
+            if (it == label_index.end())
+            {
+                spdlog::warn("Shard {} : unknown label {}", fname.c_str(), i.key());
+                continue;
+            }
+
+            for (auto &val : i.value())
+            {
+                // create a new instance
+                AnnotationInstance _inst;
+                _inst.img_fname = img_fname;
+
+                // retrieve corner positions of the instance
+                float x_start = val.at("x_start").get<float>() * scale;
+                float y_start = val.at("y_start").get<float>() * scale;
+                float x_end = val.at("x_end").get<float>() * scale;
+                float y_end = val.at("y_end").get<float>() * scale;
+
+                _inst.rect_on_image.set_bottomright_vertex(vec2f(x_end, y_end));
+                _inst.rect_on_image.set_topleft_vertex(vec2f(x_start, y_start));
+                instances.push_back(std::make_pair(it->second, _inst));
+            }
+        }
+    }
+    catch (nlohmann::json::exception &e)
+    {
+        // most likely a shard being written by another instance, or edited by hand
+        spdlog::warn("Cannot parse shard {} : {}", fname.c_str(), e.what());
+        return;
+    }
+
+    for (auto &instance : instances)
+    {
+        Annotation &ann = annotations[instance.first];
+        AnnotationInstance &_inst = instance.second;
+
+        // retrieve color
+        _inst.set_color(ann.color);
+
+        // switch state to idle
+        _inst.status_fsm.execute("from_create_to_idle");
+        _inst.hover_fsm.execute("from_hover_to_outside");
+        _inst.selected = false;
+
+        // update dictionary counting instances per image
+        ninstperimage[img_fname] = ninstperimage[img_fname] + 1;
+        ann.inst.push_back(_inst);
+    }
+}
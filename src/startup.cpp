@@ -0,0 +1,40 @@
+#include "yacvat/startup.h"
+#include "spdlog/spdlog.h"
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <utility>
+#include <stdio.h>
+
+static std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(); // reset by startup_begin
+static std::vector<std::pair<std::string, double>> marks;                             // phase and ms since the start
+
+void startup_begin(void)
+{
+    start = std::chrono::steady_clock::now();
+    marks.clear();
+}
+
+double startup_elapsed(void)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void startup_mark(const char *phase)
+{
+    marks.push_back(std::make_pair(std::string(phase), startup_elapsed()));
+}
+
+void startup_report(bool print)
+{
+    double previous = 0.0;
+    for (auto &mark : marks)
+    {
+        if (print)
+            printf("%-24s %8.1f ms %8.1f ms\n", mark.first.c_str(), mark.second - previous, mark.second);
+        else
+            spdlog::info("Startup : {} in {:.1f} ms (at {:.1f} ms)", mark.first, mark.second - previous, mark.second);
+        previous = mark.second;
+    }
+}
@@ -0,0 +1,536 @@
+#include "yacvat/tfrecord.h"
+#include "yacvat/crc32c.h"
+#include "yacvat/files.h"
+#include "yacvat/image_info.h"
+#include "yacvat/video_source.h"
+#include "yacvat/array_source.h"
+#include "spdlog/spdlog.h"
+
+#include <sys/uio.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+// protobuf wire types
+static const int WIRE_VARINT = 0;
+static const int WIRE_LEN = 2;
+
+static size_t varint_size(uint64_t v)
+{
+    size_t n = 1;
+    while (v >= 0x80)
+    {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static void put_varint(std::string &s, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        s.push_back((char)((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    s.push_back((char)v);
+}
+
+static void put_key(std::string &s, int field, int wire)
+{
+    put_varint(s, (field << 3) | wire);
+}
+
+static void put_bytes(std::string &s, int field, const void *data, size_t length)
+{
+    put_key(s, field, WIRE_LEN);
+    put_varint(s, length);
+    s.append((const char *)data, length);
+}
+
+static void put_bytes(std::string &s, int field, const std::string &data)
+{
+    put_bytes(s, field, data.data(), data.size());
+}
+
+static void put_fixed32(std::string &s, uint32_t v)
+{
+    for (int k = 0; k < 4; k++)
+        s.push_back((char)((v >> (8 * k)) & 0xff));
+}
+
+static void put_fixed64(std::string &s, uint64_t v)
+{
+    for (int k = 0; k < 8; k++)
+        s.push_back((char)((v >> (8 * k)) & 0xff));
+}
+
+// Feature { oneof kind { BytesList bytes_list = 1; FloatList float_list = 2; Int64List int64_list = 3; } }
+static std::string bytes_feature(const std::vector<std::string> &values)
+{
+    std::string list, feature;
+    for (auto &v : values)
+        put_bytes(list, 1, v);
+    put_bytes(feature, 1, list);
+    return feature;
+}
+
+static std::string bytes_feature(const std::string &value)
+{
+    return bytes_feature(std::vector<std::string>(1, value));
+}
+
+static std::string float_feature(const std::vector<float> &values)
+{
+    std::string packed, list, feature;
+    for (float v : values)
+    {
+        uint32_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        put_fixed32(packed, bits);
+    }
+    if (!values.empty())
+        put_bytes(list, 1, packed);
+    put_bytes(feature, 2, list);
+    return feature;
+}
+
+static std::string int64_feature(const std::vector<int64_t> &values)
+{
+    std::string packed, list, feature;
+    for (int64_t v : values)
+        put_varint(packed, (uint64_t)v);
+    if (!values.empty())
+        put_bytes(list, 1, packed);
+    put_bytes(feature, 3, list);
+    return feature;
+}
+
+static std::string int64_feature(int64_t value)
+{
+    return int64_feature(std::vector<int64_t>(1, value));
+}
+
+// Features { map<string, Feature> feature = 1; } : every entry is a message { key = 1; value = 2; }
+static void put_feature(std::string &features, const char *key, const std::string &feature)
+{
+    std::string entry;
+    put_bytes(entry, 1, key, strlen(key));
+    put_bytes(entry, 2, feature);
+    put_bytes(features, 1, entry);
+}
+
+// header of the image/encoded entry, up to the image bytes which end the entry
+static void put_encoded_feature_head(std::string &features, uint64_t length)
+{
+    static const char key[] = "image/encoded";
+    uint64_t list_length = 1 + varint_size(length) + length;
+    uint64_t feature_length = 1 + varint_size(list_length) + list_length;
+    uint64_t entry_length = 1 + varint_size(sizeof(key) - 1) + sizeof(key) - 1 + 1 + varint_size(feature_length) + feature_length;
+
+    put_key(features, 1, WIRE_LEN);
+    put_varint(features, entry_length);
+    put_bytes(features, 1, key, sizeof(key) - 1);
+    put_key(features, 2, WIRE_LEN);
+    put_varint(features, feature_length);
+    put_key(features, 1, WIRE_LEN);
+    put_varint(features, list_length);
+    put_key(features, 1, WIRE_LEN);
+    put_varint(features, length);
+}
+
+static std::string image_format(const unsigned char *data, size_t length, const std::string &fname)
+{
+    if ((length >= 3) && (data[0] == 0xff) && (data[1] == 0xd8) && (data[2] == 0xff))
+        return "jpeg";
+    if ((length >= 8) && (memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0))
+        return "png";
+
+    // other formats : lower case extension
+    std::string ext;
+    size_t dot = fname.find_last_of('.');
+    if (dot != std::string::npos)
+        ext = fname.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+static float clamp01(float v)
+{
+    return std::min(1.0f, std::max(0.0f, v));
+}
+
+static std::string shard_fname(const std::string &folder, const std::string &name, int n, int count)
+{
+    char suffix[64];
+    if (count > 0)
+        snprintf(suffix, sizeof(suffix), "-%05d-of-%05d.tfrecord", n, count);
+    else
+        snprintf(suffix, sizeof(suffix), "-%05d.tfrecord", n);
+    return folder + "/" + name + suffix;
+}
+
+// record files of an older export with the same prefix and another number of files
+static void remove_stale_shards(const std::string &folder, const std::string &name, int count)
+{
+    DIR *dir = opendir(folder.c_str());
+    if (dir == nullptr)
+        return;
+
+    struct dirent *diread;
+    while ((diread = readdir(dir)) != nullptr)
+    {
+        // <name>-00000-of-00012.tfrecord
+        std::string fn = diread->d_name;
+        int n = 0, total = 0, length = 0;
+        if ((fn.size() <= name.size() + 1) || (fn.compare(0, name.size() + 1, name + "-") != 0))
+            continue;
+        if ((sscanf(fn.c_str() + name.size(), "-%5d-of-%5d.tfrecord%n", &n, &total, &length) != 2) || (name.size() + length != fn.size()))
+            continue;
+        if (total == count)
+            continue;
+        std::string fname = folder + "/" + fn;
+        if (std::remove(fname.c_str()) == 0)
+            spdlog::info("TFRecord export : removed {} of a previous export", fname.c_str());
+    }
+    closedir(dir);
+}
+
+// label map of the object detection api, ids start at 1
+static std::string label_map(const std::vector<std::string> &classes)
+{
+    std::string s;
+    for (size_t n = 0; n < classes.size(); n++)
+    {
+        std::string escaped;
+        for (char c : classes[n])
+        {
+            if ((c == '\'') || (c == '\\'))
+                escaped.push_back('\\');
+            escaped.push_back(c);
+        }
+        s += "item {\n  id: " + std::to_string(n + 1) + "\n  name: '" + escaped + "'\n}\n";
+    }
+    return s;
+}
+
+// writev until every byte is written
+static bool write_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0)
+    {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        // skip what was written
+        while ((iovcnt > 0) && ((size_t)n >= iov->iov_len))
+        {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+TFRecordExporter::TFRecordExporter(void)
+{
+}
+
+TFRecordExporter::~TFRecordExporter(void)
+{
+    if (this->job)
+    {
+        // unblock the stages, the files written so far are left as they are
+        this->job->images_queue.close();
+        this->job->records_queue.close();
+    }
+    this->join();
+}
+
+void TFRecordExporter::join(void)
+{
+    if (this->reader.joinable())
+        this->reader.join();
+    if (this->serializer.joinable())
+        this->serializer.join();
+    if (this->writer.joinable())
+        this->writer.join();
+}
+
+bool TFRecordExporter::start(std::string output_folder, std::string images_folder, std::vector<image_boxes_t> &images, std::vector<std::string> &classes, uint64_t max_file_size)
+{
+    if (this->running())
+    {
+        spdlog::warn("A TFRecord export is already running");
+        return false;
+    }
+    this->join();
+
+    this->job = std::make_shared<job_t>();
+    this->job->output_folder = output_folder;
+    this->job->images_folder = images_folder;
+    this->job->classes = classes;
+    this->job->max_file_size = max_file_size;
+
+    // a record embeds the encoded file : the frames of the videos and the arrays have none, they are left out
+    this->job->skipped = 0;
+    for (auto &img : images)
+    {
+        std::string video;
+        long frame;
+        if (video_frame_of(img.fname, &video, &frame) || ArraySource::handles(img.fname))
+            this->job->skipped++;
+        else
+            this->job->images.push_back(std::move(img));
+    }
+    images.clear();
+    if (this->job->skipped > 0)
+        spdlog::info("TFRecord export : skipped {} video frames and arrays (no encoded image to embed)", this->job->skipped);
+    this->job->done = 0;
+    this->job->failed = 0;
+    this->job->written = 0;
+    this->job->finished = false;
+
+    // records are named after the images folder
+    size_t pos = images_folder.find_last_of('/');
+    this->job->name = (pos == std::string::npos) ? images_folder : images_folder.substr(pos + 1);
+    if (this->job->name.empty())
+        this->job->name = "data";
+
+    spdlog::info("Exporting {} images to TFRecord folder {}", this->job->images.size(), output_folder.c_str());
+
+    if (!make_directories(output_folder) || !write_file_atomic(output_folder + "/label_map.pbtxt", label_map(classes)))
+    {
+        this->job->failed = this->job->images.size();
+        this->job->done = this->job->images.size();
+        this->job->finished = true;
+        return false;
+    }
+
+    this->reader = std::thread(&TFRecordExporter::read_stage, this->job);
+    this->serializer = std::thread(&TFRecordExporter::serialize_stage, this->job);
+    this->writer = std::thread(&TFRecordExporter::write_stage, this->job);
+    return true;
+}
+
+bool TFRecordExporter::running(void)
+{
+    return this->job && !this->job->finished;
+}
+
+long TFRecordExporter::done(void)
+{
+    return this->job ? this->job->done.load() : 0;
+}
+
+long TFRecordExporter::total(void)
+{
+    return this->job ? this->job->images.size() : 0;
+}
+
+long TFRecordExporter::failed(void)
+{
+    return this->job ? this->job->failed.load() : 0;
+}
+
+long TFRecordExporter::skipped(void)
+{
+    return this->job ? this->job->skipped : 0;
+}
+
+uint64_t TFRecordExporter::written(void)
+{
+    return this->job ? this->job->written.load() : 0;
+}
+
+void TFRecordExporter::read_stage(std::shared_ptr<job_t> job)
+{
+    for (size_t n = 0; n < job->images.size(); n++)
+    {
+        image_item_t item;
+        item.index = n;
+        item.file = std::make_shared<MappedFile>();
+
+        const std::string &fname = job->images[n].fname;
+        if (!item.file->open(job->images_folder + "/" + fname) ||
+            !probe_image_buffer(item.file->data(), item.file->size(), &item.width, &item.height) || (item.width <= 0) || (item.height <= 0))
+        {
+            spdlog::warn("TFRecord export : cannot read {}", fname.c_str());
+            job->failed++;
+            job->done++;
+            continue;
+        }
+
+        // the kernel reads the file while the previous images are serialized
+        item.file->prefetch(0, item.file->size());
+        item.format = image_format(item.file->data(), item.file->size(), fname);
+
+        if (!job->images_queue.push(std::move(item)))
+            break;
+    }
+    job->images_queue.close();
+}
+
+void TFRecordExporter::serialize_stage(std::shared_ptr<job_t> job)
+{
+    image_item_t item;
+    while (job->images_queue.pop(item))
+    {
+        const image_boxes_t &img = job->images[item.index];
+        float width = item.width;
+        float height = item.height;
+
+        std::vector<float> xmin, xmax, ymin, ymax;
+        std::vector<std::string> texts;
+        std::vector<int64_t> labels;
+        for (auto &b : img.boxes)
+        {
+            xmin.push_back(clamp01(std::min(b.x_start, b.x_end) / width));
+            xmax.push_back(clamp01(std::max(b.x_start, b.x_end) / width));
+            ymin.push_back(clamp01(std::min(b.y_start, b.y_end) / height));
+            ymax.push_back(clamp01(std::max(b.y_start, b.y_end) / height));
+            texts.push_back(job->classes[b.label]);
+            labels.push_back(b.label + 1);
+        }
+
+        // the encoded image is the last entry of the map so that the message ends with its bytes
+        std::string features;
+        put_feature(features, "image/height", int64_feature(item.height));
+        put_feature(features, "image/width", int64_feature(item.width));
+        put_feature(features, "image/filename", bytes_feature(img.fname));
+        put_feature(features, "image/source_id", bytes_feature(img.fname));
+        put_feature(features, "image/format", bytes_feature(item.format));
+        put_feature(features, "image/object/bbox/xmin", float_feature(xmin));
+        put_feature(features, "image/object/bbox/xmax", float_feature(xmax));
+        put_feature(features, "image/object/bbox/ymin", float_feature(ymin));
+        put_feature(features, "image/object/bbox/ymax", float_feature(ymax));
+        put_feature(features, "image/object/class/text", bytes_feature(texts));
+        put_feature(features, "image/object/class/label", int64_feature(labels));
+        put_encoded_feature_head(features, item.file->size());
+
+        // Example { Features features = 1; }
+        std::string example;
+        example.reserve(features.size() + 16);
+        put_key(example, 1, WIRE_LEN);
+        put_varint(example, features.size() + item.file->size());
+        example += features;
+
+        // record : length, masked crc of the length, data, masked crc of the data
+        uint64_t length = example.size() + item.file->size();
+        record_t record;
+        record.head.reserve(12 + example.size());
+        put_fixed64(record.head, length);
+        put_fixed32(record.head, crc32c_mask(crc32c(record.head.data(), 8)));
+        record.head += example;
+
+        uint32_t crc = crc32c(example.data(), example.size());
+        crc = crc32c_extend(crc, item.file->data(), item.file->size());
+        put_fixed32(record.tail, crc32c_mask(crc));
+
+        record.file = std::move(item.file);
+        if (!job->records_queue.push(std::move(record)))
+            break;
+    }
+
+    // the reader stops at its next push if the writer gave up
+    job->images_queue.close();
+    job->records_queue.close();
+}
+
+void TFRecordExporter::write_stage(std::shared_ptr<job_t> job)
+{
+    int fd = -1;
+    int nfiles = 0;
+    long nrecords = 0;
+    uint64_t file_size = 0;
+    bool error = false;
+
+    record_t record;
+    while (job->records_queue.pop(record))
+    {
+        uint64_t size = record.head.size() + record.file->size() + record.tail.size();
+
+        // next file once the current one is full, a record is never split
+        if ((fd >= 0) && (file_size > 0) && (file_size + size > job->max_file_size))
+        {
+            ::close(fd);
+            fd = -1;
+        }
+
+        if (fd < 0)
+        {
+            std::string fname = shard_fname(job->output_folder, job->name, nfiles, 0);
+            fd = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+            {
+                spdlog::error("Cannot write file : {}", fname.c_str());
+                error = true;
+                break;
+            }
+            nfiles++;
+            file_size = 0;
+        }
+
+        struct iovec iov[3];
+        iov[0].iov_base = (void *)record.head.data();
+        iov[0].iov_len = record.head.size();
+        iov[1].iov_base = (void *)record.file->data();
+        iov[1].iov_len = record.file->size();
+        iov[2].iov_base = (void *)record.tail.data();
+        iov[2].iov_len = record.tail.size();
+
+        if (!write_all(fd, iov, 3))
+        {
+            spdlog::error("TFRecord export : write failed ({})", strerror(errno));
+            error = true;
+            break;
+        }
+
+        file_size += size;
+        job->written += size;
+        job->done++;
+        nrecords++;
+
+        // unmap as soon as written
+        record.file.reset();
+    }
+
+    if (fd >= 0)
+        ::close(fd);
+
+    // the images still in the pipeline are lost
+    job->records_queue.close();
+    job->images_queue.close();
+    if (error)
+        job->failed += job->images.size() - job->done;
+
+    // the number of files is known now
+    for (int n = 0; n < nfiles; n++)
+    {
+        std::string from = shard_fname(job->output_folder, job->name, n, 0);
+        std::string to = shard_fname(job->output_folder, job->name, n, nfiles);
+        if (std::rename(from.c_str(), to.c_str()) != 0)
+            spdlog::error("Cannot rename {} to {}", from.c_str(), to.c_str());
+    }
+    if (nfiles > 0)
+        remove_stale_shards(job->output_folder, job->name, nfiles);
+
+    spdlog::info("TFRecord export : {} images in {} files, {} bytes, {} failed", nrecords, nfiles, job->written.load(), job->failed.load());
+    job->done = job->images.size();
+    job->finished = true;
+}
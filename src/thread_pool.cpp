@@ -0,0 +1,132 @@
+#include "yacvat/thread_pool.h"
+#include "yacvat/wakeup.h"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+// worker running the current thread, if any
+static thread_local ThreadPool *current_pool = nullptr;
+static thread_local unsigned int current_index = 0;
+
+ThreadPool::ThreadPool(unsigned int nthreads)
+{
+    this->queued = 0;
+    this->next_queue = 0;
+    this->pending = 0;
+    this->stop_flag = false;
+
+    if (nthreads == 0)
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned int n = 0; n < nthreads; n++)
+        this->queues.push_back(std::unique_ptr<worker_queue_t>(new worker_queue_t));
+
+    spdlog::debug("Starting a pool of {} threads", nthreads);
+    for (unsigned int n = 0; n < nthreads; n++)
+        this->workers.push_back(std::thread(&ThreadPool::run, this, n));
+}
+
+ThreadPool::~ThreadPool(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stop_flag = true;
+    }
+    this->cond.notify_all();
+
+    for (auto &w : this->workers)
+        w.join();
+}
+
+void ThreadPool::submit(std::function<void(void)> task)
+{
+    unsigned int index = (current_pool == this) ? current_index : (this->next_queue++ % this->queues.size());
+
+    {
+        std::lock_guard<std::mutex> lock(this->queues[index]->mutex);
+        this->queues[index]->tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->pending++;
+        this->queued++;
+    }
+    this->cond.notify_one();
+}
+
+void ThreadPool::wait(void)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->done_cond.wait(lock, [this]
+                         { return this->pending == 0; });
+}
+
+bool ThreadPool::take(unsigned int index, std::function<void(void)> &task)
+{
+    // newest task of the worker
+    {
+        worker_queue_t &q = *this->queues[index];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty())
+        {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            this->queued--;
+            return true;
+        }
+    }
+
+    // oldest task of another worker : the largest piece of work left
+    for (unsigned int k = 1; k < this->queues.size(); k++)
+    {
+        worker_queue_t &q = *this->queues[(index + k) % this->queues.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty())
+        {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            this->queued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::run(unsigned int index)
+{
+    current_pool = this;
+    current_index = index;
+
+    while (true)
+    {
+        std::function<void(void)> task;
+        if (!this->take(index, task))
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->cond.wait(lock, [this]
+                            { return this->stop_flag || (this->queued > 0); });
+
+            // stop requested and nothing left to do
+            if (this->queued <= 0)
+                return;
+            continue;
+        }
+
+        task();
+
+        bool drained;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->pending--;
+            drained = (this->pending == 0);
+            if (drained)
+                this->done_cond.notify_all();
+        }
+
+        // the ui sleeps while idle : it shows the results once the work queued is done
+        if (drained)
+            ui_wakeup();
+    }
+}
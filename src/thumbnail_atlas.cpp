@@ -0,0 +1,550 @@
+#include "yacvat/thumbnail_atlas.h"
+#include "yacvat/image_info.h"
+#include "yacvat/files.h"
+#include "yacvat/frame_profile.h"
+#include "spdlog/spdlog.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const size_t CELL_BYTES = THUMBNAIL_CELL * THUMBNAIL_CELL * 4;
+static const int IMAGES_PER_TASK = 8;       // thumbnails computed by a task before it is queued again
+static const int64_t SAVE_INTERVAL = 10000; // ms between two saves of the index
+static const size_t INSTALL_PER_POLL = 8192; // records installed by a frame (the cache of a large folder comes in a few frames)
+static const char INDEX_MAGIC[8] = {'Y', 'C', 'V', 'T', 'T', 'H', 'M', '1'};
+static const size_t INDEX_RECORD_MIN = sizeof(uint16_t) + 2 * sizeof(uint64_t) + 3 * sizeof(uint32_t) + 2 * sizeof(uint16_t); // record of an empty path
+
+// states of the items
+static const uint8_t ITEM_IDLE = 0;
+static const uint8_t ITEM_WANTED = 1;
+static const uint8_t ITEM_CLAIMED = 2;
+
+static int64_t now_ms(void)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// formats decoded by stb_image
+static bool has_thumbnail(const manifest_file_t &f)
+{
+    if (!f.supported || (f.frames > 0))
+        return false;
+    switch ((image_format_t)f.format)
+    {
+    case IMAGE_FORMAT_JPEG:
+    case IMAGE_FORMAT_PNG:
+    case IMAGE_FORMAT_BMP:
+    case IMAGE_FORMAT_GIF:
+    case IMAGE_FORMAT_TGA:
+    case IMAGE_FORMAT_PNM:
+    case IMAGE_FORMAT_PSD:
+    case IMAGE_FORMAT_HDR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+template <typename T>
+static void put(std::string &out, T value)
+{
+    out.append((const char *)&value, sizeof(value));
+}
+
+template <typename T>
+static bool get(const std::string &in, size_t &offset, T *value)
+{
+    if (offset + sizeof(T) > in.size())
+        return false;
+    memcpy(value, in.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+static bool read_index(const std::string &fname, std::vector<thumbnail_record_t> &records)
+{
+    records.clear();
+    std::ifstream f(fname.c_str(), std::ios::binary);
+    if (!f.good())
+        return false;
+    std::stringstream buffer;
+    buffer << f.rdbuf();
+    std::string in = buffer.str();
+
+    size_t offset = sizeof(INDEX_MAGIC);
+    uint32_t cell = 0, count = 0;
+    if ((in.size() < offset) || (memcmp(in.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) ||
+        !get(in, offset, &cell) || !get(in, offset, &count) || (cell != (uint32_t)THUMBNAIL_CELL))
+    {
+        spdlog::warn("Thumbnails : the index {} is not readable, the thumbnails are computed again", fname.c_str());
+        return false;
+    }
+
+    // a corrupt count cannot allocate more records than the file holds
+    if (count > (in.size() - offset) / INDEX_RECORD_MIN)
+    {
+        spdlog::warn("Thumbnails : the index {} is truncated, the thumbnails are computed again", fname.c_str());
+        return false;
+    }
+    records.resize(count);
+    for (auto &r : records)
+    {
+        uint16_t length = 0;
+        if (!get(in, offset, &length) || (offset + length > in.size()))
+        {
+            records.clear();
+            return false;
+        }
+        r.path.assign(in.data() + offset, length);
+        offset += length;
+        if (!get(in, offset, &r.size) || !get(in, offset, &r.mtime) || !get(in, offset, &r.cell) || !get(in, offset, &r.width) ||
+            !get(in, offset, &r.height) || !get(in, offset, &r.image_width) || !get(in, offset, &r.image_height))
+        {
+            records.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+// mean of the pixels of the image under each pixel of the thumbnail, which fits the cell
+static void reduce(const unsigned char *pixels, int width, int height, unsigned char *cell, uint16_t *out_width, uint16_t *out_height)
+{
+    float ratio = std::min(1.0f, std::min((float)THUMBNAIL_CELL / width, (float)THUMBNAIL_CELL / height));
+    int w = std::max(1, std::min(THUMBNAIL_CELL, (int)(width * ratio + 0.5f)));
+    int h = std::max(1, std::min(THUMBNAIL_CELL, (int)(height * ratio + 0.5f)));
+    for (int y = 0; y < h; y++)
+    {
+        int y0 = (int)((long)y * height / h), y1 = std::max(y0 + 1, (int)((long)(y + 1) * height / h));
+        for (int x = 0; x < w; x++)
+        {
+            int x0 = (int)((long)x * width / w), x1 = std::max(x0 + 1, (int)((long)(x + 1) * width / w));
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for (int sy = y0; sy < y1; sy++)
+            {
+                const unsigned char *p = pixels + ((size_t)sy * width + x0) * 4;
+                for (int sx = x0; sx < x1; sx++, p += 4)
+                {
+                    sum[0] += p[0];
+                    sum[1] += p[1];
+                    sum[2] += p[2];
+                    sum[3] += p[3];
+                }
+            }
+            uint32_t n = (uint32_t)((y1 - y0) * (x1 - x0));
+            unsigned char *q = cell + ((size_t)y * THUMBNAIL_CELL + x) * 4;
+            for (int c = 0; c < 4; c++)
+                q[c] = (unsigned char)((sum[c] + n / 2) / n);
+        }
+    }
+    *out_width = (uint16_t)w;
+    *out_height = (uint16_t)h;
+}
+
+ThumbnailAtlas::job_s::~job_s(void)
+{
+    if (this->fd >= 0)
+        ::close(this->fd);
+}
+
+ThumbnailAtlas::ThumbnailAtlas(void)
+{
+    this->installed = 0;
+    this->mapped_cells = 0;
+}
+
+ThumbnailAtlas::~ThumbnailAtlas(void)
+{
+    this->cancel();
+}
+
+void ThumbnailAtlas::start(ThreadPool &pool, std::string folder, std::shared_ptr<const DatasetManifest> listing)
+{
+    std::shared_ptr<job_t> previous = this->job;
+    this->cancel();
+    if (!listing)
+        return;
+
+    this->folder = folder;
+    this->cells_fname = folder + "/.yacvat-thumbs";
+    this->job = std::make_shared<job_t>();
+    this->job->folder = folder;
+    this->job->cells_fname = this->cells_fname;
+    this->job->index_fname = this->cells_fname + ".idx";
+    this->job->fd = -1;
+    this->job->cursor = 0;
+    this->job->planned = false;
+    this->job->next_cell = 0;
+    this->job->saving = false;
+    this->job->last_save = now_ms();
+    this->job->pending = 1;
+    this->job->done = 0;
+    this->job->total = 0;
+    this->job->cancel_flag = false;
+    this->job->done_flag = false;
+    this->job->writers = 0;
+    if (previous && (previous->cells_fname == this->cells_fname))
+        this->job->previous = previous;
+
+    std::shared_ptr<job_t> _job = this->job;
+    ThreadPool *_pool = &pool;
+    pool.submit([_job, _pool, listing]()
+                { ThumbnailAtlas::plan(_job, _pool, listing); });
+}
+
+void ThumbnailAtlas::cancel(void)
+{
+    if (this->job)
+        this->job->cancel_flag = true;
+    this->job.reset();
+    this->folder.clear();
+    this->records.clear();
+    this->installed = 0;
+    this->cells.close();
+    this->mapped_cells = 0;
+}
+
+bool ThumbnailAtlas::started(const std::string &folder)
+{
+    return !this->folder.empty() && (this->folder == folder);
+}
+
+bool ThumbnailAtlas::running(void)
+{
+    return this->job && !this->job->done_flag;
+}
+
+void ThumbnailAtlas::progress(long *done, long *total)
+{
+    *done = this->job ? this->job->done.load() : 0;
+    *total = this->job ? this->job->total.load() : 0;
+}
+
+void ThumbnailAtlas::poll(void)
+{
+    if (!this->job)
+        return;
+
+    // read first : once it is true every record is published
+    bool done = this->job->done_flag;
+    std::vector<thumbnail_record_t> fresh;
+    {
+        std::lock_guard<std::mutex> lock(this->job->mutex);
+        size_t end = std::min(this->job->records.size(), this->installed + INSTALL_PER_POLL);
+        if (this->installed < end)
+            fresh.assign(this->job->records.begin() + this->installed, this->job->records.begin() + end);
+        this->installed = end;
+        done = done && (end == this->job->records.size());
+    }
+
+    // the cells are written before their records are published : a mapping of the file as it is now covers them
+    bool remap = false;
+    for (auto &r : fresh)
+    {
+        remap = remap || (r.cell >= this->mapped_cells);
+        this->records[r.path] = std::move(r);
+    }
+    if (remap)
+    {
+        FrameTimer timer(PHASE_UPLOAD);
+        if (this->cells.open(this->cells_fname))
+            this->mapped_cells = (uint32_t)(this->cells.size() / CELL_BYTES);
+    }
+
+    if (done)
+    {
+        spdlog::info("{} thumbnails in the cache", this->records.size());
+        this->job.reset();
+        this->installed = 0;
+    }
+}
+
+const thumbnail_record_t *ThumbnailAtlas::find(const std::string &entry)
+{
+    auto it = this->records.find(entry);
+    return (it == this->records.end()) ? nullptr : &it->second;
+}
+
+const unsigned char *ThumbnailAtlas::pixels(const thumbnail_record_t *record)
+{
+    if ((record == nullptr) || (record->width == 0) || (record->cell >= this->mapped_cells))
+        return nullptr;
+    return this->cells.data() + (size_t)record->cell * CELL_BYTES;
+}
+
+void ThumbnailAtlas::prefetch(const thumbnail_record_t *record)
+{
+    if ((record != nullptr) && (record->cell < this->mapped_cells))
+        this->cells.prefetch((size_t)record->cell * CELL_BYTES, CELL_BYTES);
+}
+
+void ThumbnailAtlas::want(const std::string &entry)
+{
+    if (!this->job || !this->job->planned)
+        return;
+    auto it = this->job->item_index.find(entry);
+    if (it == this->job->item_index.end())
+        return;
+
+    // once : the entry is queued until a task claims it
+    uint8_t state = ITEM_IDLE;
+    if (!this->job->states[it->second].compare_exchange_strong(state, ITEM_WANTED))
+        return;
+    std::lock_guard<std::mutex> lock(this->job->mutex);
+    this->job->wanted.push_back(it->second);
+}
+
+void ThumbnailAtlas::plan(std::shared_ptr<job_t> job, ThreadPool *pool, std::shared_ptr<const DatasetManifest> listing)
+{
+    // images of the listing which can have a thumbnail
+    std::unordered_map<std::string, const manifest_file_t *> files;
+    std::vector<std::string> paths;
+    for (auto &dir : listing->dirs)
+    {
+        for (auto &f : dir.files)
+        {
+            if (!has_thumbnail(f))
+                continue;
+            paths.push_back(manifest_join(dir.path, f.name));
+            files[paths.back()] = &f;
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    // the job replaced on the same cache writes no more once its writes in progress end : its cells are not handed out twice
+    if (job->previous)
+    {
+        while (job->previous->writers > 0)
+            std::this_thread::yield();
+        job->previous.reset();
+    }
+
+    // the thumbnails of the cache whose image did not change are kept, with their cells
+    std::vector<thumbnail_record_t> cached;
+    read_index(job->index_fname, cached);
+    struct stat st;
+    uint32_t cells = (stat(job->cells_fname.c_str(), &st) == 0) ? (uint32_t)std::min((uint64_t)st.st_size / CELL_BYTES, (uint64_t)UINT32_MAX) : 0;
+    std::vector<bool> used;
+    std::vector<thumbnail_record_t> records;
+    for (auto &r : cached)
+    {
+        auto it = files.find(r.path);
+        if ((it == files.end()) || (it->second->size != r.size) || (it->second->mtime != r.mtime) || (r.cell >= cells))
+            continue;
+        if (r.cell >= used.size())
+            used.resize(r.cell + 1, false);
+        if (used[r.cell])
+            continue;
+        used[r.cell] = true;
+        files.erase(it);
+        records.push_back(r);
+    }
+
+    job->fd = ::open(job->cells_fname.c_str(), O_RDWR | O_CREAT, 0644);
+    if (job->fd < 0)
+    {
+        spdlog::error("Cannot open the thumbnails cache : {}", job->cells_fname.c_str());
+        files.clear();
+    }
+
+    // the images left in the order of the list
+    for (auto &path : paths)
+    {
+        auto it = files.find(path);
+        if (it == files.end())
+            continue;
+        job->item_index[path] = job->items.size();
+        job->items.push_back(item_t{path, it->second->size, it->second->mtime});
+    }
+    job->states.reset(new std::atomic<uint8_t>[job->items.size()]);
+    for (size_t n = 0; n < job->items.size(); n++)
+        job->states[n] = ITEM_IDLE;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->records.swap(records);
+        for (uint32_t c = 0; c < used.size(); c++)
+        {
+            if (!used[c])
+                job->free_cells.push_back(c);
+        }
+        job->next_cell = (uint32_t)used.size();
+    }
+    job->total = job->items.size();
+    job->planned = true;
+    spdlog::info("Thumbnails : {} in the cache, {} to compute", cached.size(), job->items.size());
+
+    // a few thumbnails per task, as many tasks as threads : the other jobs of the pool are queued in between
+    long tasks = std::min((long)pool->size(), (long)job->items.size());
+    job->pending = tasks;
+    for (long t = 0; t < tasks; t++)
+    {
+        pool->submit([job, pool]()
+                     { ThumbnailAtlas::compute(job, pool); });
+    }
+    if (tasks == 0)
+    {
+        if (cached.size() != job->records.size())
+            ThumbnailAtlas::save(job);
+        job->done_flag = true;
+    }
+}
+
+bool ThumbnailAtlas::next_item(std::shared_ptr<job_t> &job, size_t *item)
+{
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        while (!job->wanted.empty())
+        {
+            size_t n = job->wanted.back();
+            job->wanted.pop_back();
+            uint8_t state = ITEM_WANTED;
+            if (job->states[n].compare_exchange_strong(state, ITEM_CLAIMED))
+            {
+                *item = n;
+                return true;
+            }
+        }
+    }
+
+    for (;;)
+    {
+        size_t n = job->cursor++;
+        if (n >= job->items.size())
+            return false;
+        uint8_t state = job->states[n].load();
+        while ((state != ITEM_CLAIMED) && !job->states[n].compare_exchange_weak(state, ITEM_CLAIMED))
+            ;
+        if (state != ITEM_CLAIMED)
+        {
+            *item = n;
+            return true;
+        }
+    }
+}
+
+void ThumbnailAtlas::compute(std::shared_ptr<job_t> job, ThreadPool *pool)
+{
+    std::vector<unsigned char> cell(CELL_BYTES);
+    bool left = true;
+    for (int k = 0; (k < IMAGES_PER_TASK) && !job->cancel_flag; k++)
+    {
+        size_t n;
+        if (!ThumbnailAtlas::next_item(job, &n))
+        {
+            left = false;
+            break;
+        }
+
+        // an image which cannot be decoded gets an empty thumbnail : it is not decoded again until it changes
+        const item_t &item = job->items[n];
+        thumbnail_record_t record = {item.path, item.size, item.mtime, 0, 0, 0, 0, 0};
+        std::fill(cell.begin(), cell.end(), 0);
+        int width = 0, height = 0;
+        unsigned char *pixels = stbi_load((job->folder + "/" + item.path).c_str(), &width, &height, NULL, 4);
+        if (pixels != nullptr)
+        {
+            reduce(pixels, width, height, cell.data(), &record.width, &record.height);
+            record.image_width = width;
+            record.image_height = height;
+            stbi_image_free(pixels);
+        }
+
+        // cancelled during the decode : the cells may belong to the job which replaced this one
+        job->writers++;
+        if (job->cancel_flag)
+        {
+            job->writers--;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            if (!job->free_cells.empty())
+            {
+                record.cell = job->free_cells.back();
+                job->free_cells.pop_back();
+            }
+            else
+                record.cell = job->next_cell++;
+        }
+        if (pwrite(job->fd, cell.data(), CELL_BYTES, (off_t)record.cell * CELL_BYTES) != (ssize_t)CELL_BYTES)
+        {
+            spdlog::error("Cannot write the thumbnails cache : {}", job->cells_fname.c_str());
+            job->cancel_flag = true;
+            job->writers--;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->records.push_back(std::move(record));
+        }
+        job->writers--;
+        job->done++;
+    }
+
+    // queued again behind the tasks of the other jobs
+    if (left && !job->cancel_flag)
+    {
+        if ((now_ms() - job->last_save >= SAVE_INTERVAL) && !job->saving.exchange(true))
+        {
+            ThumbnailAtlas::save(job);
+            job->saving = false;
+        }
+        pool->submit([job, pool]()
+                     { ThumbnailAtlas::compute(job, pool); });
+        return;
+    }
+
+    // the last task saves the index, after the save in progress if any
+    if (--job->pending == 0)
+    {
+        while (job->saving.exchange(true))
+            std::this_thread::yield();
+        ThumbnailAtlas::save(job);
+        job->done_flag = true;
+        job->saving = false;
+    }
+}
+
+void ThumbnailAtlas::save(std::shared_ptr<job_t> &job)
+{
+    // a cancelled job leaves the index to the job which replaced it
+    job->writers++;
+    if (job->cancel_flag)
+    {
+        job->writers--;
+        return;
+    }
+
+    std::string out(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        count = job->records.size();
+        put(out, (uint32_t)THUMBNAIL_CELL);
+        put(out, (uint32_t)job->records.size());
+        for (auto &r : job->records)
+        {
+            put(out, (uint16_t)r.path.size());
+            out.append(r.path);
+            put(out, r.size);
+            put(out, r.mtime);
+            put(out, r.cell);
+            put(out, r.width);
+            put(out, r.height);
+            put(out, r.image_width);
+            put(out, r.image_height);
+        }
+    }
+    job->last_save = now_ms();
+    spdlog::debug("Thumbnails : saving the index of {} thumbnails", count);
+    write_file_atomic(job->index_fname, out);
+    job->writers--;
+}
@@ -0,0 +1,237 @@
+#include "yacvat/thumbnail_grid.h"
+#include "yacvat/gl_functions.h"
+#include "yacvat/thumbnail_atlas.h"
+#include "yacvat/frame_profile.h"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+static const int LAYERS = 2048;          // cells resident in the texture (32 MB), more than a screen of the grid
+static const long UPLOADS_PER_FRAME = 64; // cells uploaded by a frame, the others wait for the next ones
+
+// program shared by every grid, linked on the first frame
+static struct
+{
+    GLuint id;
+    bool failed;
+    GLint proj;
+    GLint atlas;
+} program;
+
+// attribute locations, bound before the link
+static const GLuint ATTRIB_RECT = 0;
+static const GLuint ATTRIB_TEX = 1;
+
+static const char *VERTEX_SHADER =
+    "uniform mat4 ProjMtx;\n"
+    "in vec4 Rect;\n"
+    "in vec4 Tex;\n"
+    "out vec3 Frag_UV;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));\n"
+    "    Frag_UV = vec3(corner * Tex.xy, Tex.z);\n"
+    "    gl_Position = ProjMtx * vec4(mix(Rect.xy, Rect.zw, corner), 0.0, 1.0);\n"
+    "}\n";
+
+static const char *FRAGMENT_SHADER =
+    "uniform sampler2DArray Atlas;\n"
+    "in vec3 Frag_UV;\n"
+    "out vec4 Out_Color;\n"
+    "void main()\n"
+    "{\n"
+    "    Out_Color = texture(Atlas, Frag_UV);\n"
+    "}\n";
+
+static bool build_program(void)
+{
+    if ((program.id != 0) || program.failed)
+        return program.id != 0;
+    program.failed = true;
+    gl_load();
+    if (!gl.shaders || !gl.textures || !gl.instanced)
+    {
+        spdlog::warn("OpenGL array textures are not available : the grid shows the names of the images only");
+        return false;
+    }
+
+    static const char *attributes[] = {"Rect", "Tex"};
+    static const GLint locations[] = {ATTRIB_RECT, ATTRIB_TEX};
+    GLuint id = gl_build_program("thumbnail", VERTEX_SHADER, FRAGMENT_SHADER, attributes, locations, 2);
+    if (id == 0)
+        return false;
+
+    program.id = id;
+    program.failed = false;
+    program.proj = gl.GetUniformLocation(id, "ProjMtx");
+    program.atlas = gl.GetUniformLocation(id, "Atlas");
+    return true;
+}
+
+ThumbnailGrid::ThumbnailGrid(void)
+{
+    this->texture = 0;
+    this->hand = 0;
+    this->frame = 0;
+    this->uploads = 0;
+    this->vao = 0;
+    this->vbo = 0;
+    this->capacity = 0;
+}
+
+ThumbnailGrid::~ThumbnailGrid(void)
+{
+    this->release();
+}
+
+void ThumbnailGrid::release(void)
+{
+    if (this->texture != 0)
+        glDeleteTextures(1, &this->texture);
+    if (this->vbo != 0)
+        gl.DeleteBuffers(1, &this->vbo);
+    if (this->vao != 0)
+        gl.DeleteVertexArrays(1, &this->vao);
+    this->texture = 0;
+    this->vao = 0;
+    this->vbo = 0;
+    this->capacity = 0;
+    this->reset();
+}
+
+bool ThumbnailGrid::available(void)
+{
+    return build_program();
+}
+
+void ThumbnailGrid::begin(void)
+{
+    this->instances.clear();
+    this->frame++;
+    this->uploads = 0;
+}
+
+void ThumbnailGrid::reset(void)
+{
+    this->layers.clear();
+    std::fill(this->layer_cells.begin(), this->layer_cells.end(), UINT32_MAX);
+    std::fill(this->layer_frames.begin(), this->layer_frames.end(), 0);
+}
+
+int ThumbnailGrid::layer(uint32_t cell, const unsigned char *pixels)
+{
+    auto it = this->layers.find(cell);
+    if (it != this->layers.end())
+    {
+        this->layer_frames[it->second] = this->frame;
+        return it->second;
+    }
+    if ((pixels == nullptr) || (this->uploads >= UPLOADS_PER_FRAME))
+        return -1;
+
+    // storage of every layer, allocated once
+    if (this->texture == 0)
+    {
+        glGenTextures(1, &this->texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, this->texture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        gl.TexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, THUMBNAIL_CELL, THUMBNAIL_CELL, LAYERS, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        this->layer_cells.assign(LAYERS, UINT32_MAX);
+        this->layer_frames.assign(LAYERS, 0);
+    }
+
+    // the next layer not drawn by this frame, going round : the layers drawn long ago come first
+    int found = -1;
+    for (int k = 0; (k < LAYERS) && (found < 0); k++)
+    {
+        size_t l = (this->hand + k) % LAYERS;
+        if (this->layer_frames[l] != this->frame)
+            found = (int)l;
+    }
+    if (found < 0)
+        return -1;
+    this->hand = (found + 1) % LAYERS;
+    if (this->layer_cells[found] != UINT32_MAX)
+        this->layers.erase(this->layer_cells[found]);
+
+    FrameTimer timer(PHASE_UPLOAD);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, this->texture);
+#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+    gl.TexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, found, THUMBNAIL_CELL, THUMBNAIL_CELL, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    this->layer_cells[found] = cell;
+    this->layer_frames[found] = this->frame;
+    this->layers[cell] = found;
+    this->uploads++;
+    return found;
+}
+
+bool ThumbnailGrid::add(uint32_t cell, const unsigned char *pixels, int width, int height, ImVec2 min, ImVec2 max)
+{
+    int l = this->layer(cell, pixels);
+    if (l < 0)
+        return false;
+    grid_instance_t instance = {
+        {min.x, min.y, max.x, max.y},
+        {(float)width / THUMBNAIL_CELL, (float)height / THUMBNAIL_CELL, (float)l, 0.0f}};
+    this->instances.push_back(instance);
+    return true;
+}
+
+void ThumbnailGrid::draw(ImDrawList *draw_list)
+{
+    if (this->instances.empty())
+        return;
+    draw_list->AddCallback(ThumbnailGrid::render, this);
+    draw_list->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+}
+
+void ThumbnailGrid::render(const ImDrawList *draw_list, const ImDrawCmd *cmd)
+{
+    (void)draw_list;
+    ThumbnailGrid *grid = (ThumbnailGrid *)cmd->UserCallbackData;
+    if (!build_program())
+        return;
+
+    float proj[16];
+    if (!gl_callback_setup(cmd, proj))
+        return;
+
+    // vertex array of the instance attributes, created in the context of the first frame
+    if (grid->vao == 0)
+    {
+        gl.GenVertexArrays(1, &grid->vao);
+        gl.GenBuffers(1, &grid->vbo);
+        gl.BindVertexArray(grid->vao);
+        gl.BindBuffer(GL_ARRAY_BUFFER, grid->vbo);
+        const GLuint attribs[2] = {ATTRIB_RECT, ATTRIB_TEX};
+        for (int k = 0; k < 2; k++)
+        {
+            gl.EnableVertexAttribArray(attribs[k]);
+            gl.VertexAttribPointer(attribs[k], 4, GL_FLOAT, GL_FALSE, sizeof(grid_instance_t), (void *)(intptr_t)(k * 4 * sizeof(float)));
+            gl.VertexAttribDivisor(attribs[k], 1);
+        }
+    }
+    else
+    {
+        gl.BindVertexArray(grid->vao);
+        gl.BindBuffer(GL_ARRAY_BUFFER, grid->vbo);
+    }
+
+    // the buffer grows to the largest frame, its storage is orphaned on every frame so the write does not wait for the previous draw
+    size_t bytes = grid->instances.size() * sizeof(grid_instance_t);
+    grid->capacity = std::max(grid->instances.size(), grid->capacity);
+    gl.BufferData(GL_ARRAY_BUFFER, grid->capacity * sizeof(grid_instance_t), nullptr, GL_STREAM_DRAW);
+    gl.BufferSubData(GL_ARRAY_BUFFER, 0, bytes, grid->instances.data());
+
+    gl.UseProgram(program.id);
+    gl.UniformMatrix4fv(program.proj, 1, GL_FALSE, proj);
+    gl.Uniform1i(program.atlas, 0);
+    gl.ActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, grid->texture);
+    gl.DrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)grid->instances.size());
+}
@@ -0,0 +1,50 @@
+#include "yacvat/thumbnails.h"
+
+ThumbnailCache::ThumbnailCache(size_t budget)
+{
+    this->bytes = 0;
+    this->budget = budget;
+}
+
+void ThumbnailCache::put(const std::string &fname, int width, int height, std::vector<unsigned char> &pixels)
+{
+    auto i = this->index.find(fname);
+    if (i != this->index.end())
+    {
+        this->bytes -= i->second->second.pixels.size();
+        this->entries.erase(i->second);
+        this->index.erase(i);
+    }
+
+    this->entries.push_front(entry_t(fname, thumbnail_t()));
+    thumbnail_t &thumbnail = this->entries.front().second;
+    thumbnail.width = width;
+    thumbnail.height = height;
+    thumbnail.pixels.swap(pixels);
+    this->bytes += thumbnail.pixels.size();
+    this->index[fname] = this->entries.begin();
+
+    // the least recently used go first, the new one is always kept
+    while ((this->bytes > this->budget) && (this->entries.size() > 1))
+    {
+        this->bytes -= this->entries.back().second.pixels.size();
+        this->index.erase(this->entries.back().first);
+        this->entries.pop_back();
+    }
+}
+
+const thumbnail_t *ThumbnailCache::get(const std::string &fname)
+{
+    auto i = this->index.find(fname);
+    if (i == this->index.end())
+        return nullptr;
+    this->entries.splice(this->entries.begin(), this->entries, i->second);
+    return &this->entries.front().second;
+}
+
+void ThumbnailCache::clear(void)
+{
+    this->entries.clear();
+    this->index.clear();
+    this->bytes = 0;
+}
@@ -0,0 +1,385 @@
+#include "yacvat/video_source.h"
+#include "yacvat/manifest.h"
+#include "yacvat/files.h"
+#include "spdlog/spdlog.h"
+#include "nlohmann/json.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <sys/stat.h>
+
+static const char INDEX_MAGIC[8] = {'Y', 'C', 'V', 'T', 'I', 'D', 'X', '1'};
+static const size_t HEADER_MAX = 1024;    // longest stream header of a .y4m
+static const size_t FRAME_LINE_MAX = 256; // longest FRAME line
+
+// hidden file next to the video : camera/clip.y4m -> camera/.clip.y4m.yacvat-index
+static std::string index_fname(const std::string &fname)
+{
+    size_t slash = fname.find_last_of('/');
+    if (slash == std::string::npos)
+        return "." + fname + ".yacvat-index";
+    return fname.substr(0, slash + 1) + "." + fname.substr(slash + 1) + ".yacvat-index";
+}
+
+// "420jpeg", "420p10", "444", "mono", "mono16", ...
+static bool parse_chroma(const std::string &s, video_chroma_t *chroma, int *depth)
+{
+    std::string rest;
+    if (s.compare(0, 4, "mono") == 0)
+    {
+        *chroma = CHROMA_MONO;
+        rest = s.substr(4);
+    }
+    else if (s.compare(0, 3, "420") == 0)
+    {
+        *chroma = CHROMA_420;
+        rest = s.substr(3);
+    }
+    else if (s.compare(0, 3, "422") == 0)
+    {
+        *chroma = CHROMA_422;
+        rest = s.substr(3);
+    }
+    else if (s.compare(0, 3, "444") == 0)
+    {
+        *chroma = CHROMA_444;
+        rest = s.substr(3);
+    }
+    else
+        return false;
+
+    // sitings of 4:2:0 only change where the chroma samples are, not their number
+    *depth = 8;
+    if ((rest == "") || (rest == "jpeg") || (rest == "paldv") || (rest == "mpeg2"))
+        return true;
+    if (!rest.empty() && (rest[0] == 'p'))
+        rest = rest.substr(1);
+    char *end;
+    long d = strtol(rest.c_str(), &end, 10);
+    if ((end == rest.c_str()) || (*end != '\0') || (d < 8) || (d > 16))
+        return false;
+    *depth = d;
+    return true;
+}
+
+// size of the chroma planes and of a whole frame
+static void plane_sizes(const video_format_t &format, int widths[3], int heights[3])
+{
+    widths[0] = format.width;
+    heights[0] = format.height;
+    int cw = (format.chroma == CHROMA_444) ? format.width : (format.width + 1) / 2;
+    int ch = (format.chroma == CHROMA_420) ? (format.height + 1) / 2 : format.height;
+    for (int k = 1; k < 3; k++)
+    {
+        widths[k] = (format.chroma == CHROMA_MONO) ? 0 : cw;
+        heights[k] = (format.chroma == CHROMA_MONO) ? 0 : ch;
+    }
+}
+
+static size_t frame_bytes(const video_format_t &format)
+{
+    int widths[3], heights[3];
+    plane_sizes(format, widths, heights);
+    size_t bytes = 0;
+    for (int k = 0; k < 3; k++)
+        bytes += (size_t)widths[k] * heights[k];
+    return bytes * ((format.depth > 8) ? 2 : 1);
+}
+
+static bool probe_y4m(const std::string &fname, video_format_t *format)
+{
+    FILE *f = fopen(fname.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+    char head[HEADER_MAX];
+    size_t n = fread(head, 1, sizeof(head), f);
+    fclose(f);
+
+    const char *nl = (const char *)memchr(head, '\n', n);
+    if ((n < 10) || (memcmp(head, "YUV4MPEG2 ", 10) != 0) || (nl == nullptr))
+        return false;
+
+    format->width = 0;
+    format->height = 0;
+    format->chroma = CHROMA_420;
+    format->depth = 8;
+    format->header = nl - head + 1;
+    format->y4m = true;
+
+    std::istringstream tokens(std::string(head + 10, nl - head - 10));
+    std::string token;
+    while (tokens >> token)
+    {
+        if (token[0] == 'W')
+            format->width = atoi(token.c_str() + 1);
+        else if (token[0] == 'H')
+            format->height = atoi(token.c_str() + 1);
+        else if ((token[0] == 'C') && !parse_chroma(token.substr(1), &format->chroma, &format->depth))
+        {
+            spdlog::warn("{} : unsupported colour space {}", fname.c_str(), token.c_str() + 1);
+            return false;
+        }
+    }
+    return (format->width > 0) && (format->height > 0);
+}
+
+static bool probe_yuv(const std::string &fname, video_format_t *format)
+{
+    std::ifstream f((fname + ".json").c_str());
+    if (!f.good())
+        return false;
+
+    try
+    {
+        nlohmann::json desc = nlohmann::json::parse(f);
+        format->width = desc.at("width").get<int>();
+        format->height = desc.at("height").get<int>();
+        format->depth = desc.value("depth", 8);
+        format->header = desc.value("offset", (size_t)0);
+        format->y4m = false;
+        std::string chroma = desc.value("chroma", std::string("420"));
+        int depth;
+        if (!parse_chroma(chroma, &format->chroma, &depth) || (format->depth < 8) || (format->depth > 16))
+        {
+            spdlog::warn("{} : unsupported format {}, {} bits", fname.c_str(), chroma.c_str(), format->depth);
+            return false;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        spdlog::warn("{}.json : {}", fname.c_str(), e.what());
+        return false;
+    }
+    return (format->width > 0) && (format->height > 0);
+}
+
+VideoSource::VideoSource(void)
+{
+    memset(&this->fmt, 0, sizeof(this->fmt));
+    this->index.count = 0;
+    this->index.first = 0;
+    this->index.stride = 0;
+    this->count = 0;
+}
+
+bool VideoSource::handles(const std::string &fname)
+{
+    std::string ext = file_extension(fname);
+    return (ext == "y4m") || (ext == "yuv");
+}
+
+bool VideoSource::probe(const std::string &fname, video_format_t *format)
+{
+    bool ok = (file_extension(fname) == "y4m") ? probe_y4m(fname, format) : probe_yuv(fname, format);
+    if (ok)
+        format->frame_size = frame_bytes(*format);
+    return ok;
+}
+
+long VideoSource::count_frames(const std::string &fname)
+{
+    video_format_t format;
+    MappedFile file;
+    frame_index_t index;
+    if (!VideoSource::probe(fname, &format) || !file.open(fname) || !VideoSource::get_index(fname, format, file, &index))
+        return -1;
+    return index.count;
+}
+
+bool VideoSource::get_index(const std::string &fname, const video_format_t &format, MappedFile &file, frame_index_t *index)
+{
+    index->offsets.clear();
+    if (!format.y4m)
+    {
+        // fixed size frames after the offset
+        index->first = format.header;
+        index->stride = format.frame_size;
+        index->count = (file.size() > format.header) ? (file.size() - format.header) / format.frame_size : 0;
+        return index->count > 0;
+    }
+
+    if (VideoSource::load_index(fname, index))
+        return true;
+    if (!VideoSource::build_index(fname, format, file, index))
+        return false;
+    VideoSource::save_index(fname, *index);
+    return true;
+}
+
+bool VideoSource::build_index(const std::string &fname, const video_format_t &format, MappedFile &file, frame_index_t *index)
+{
+    const unsigned char *data = file.data();
+    size_t size = file.size();
+    size_t pos = format.header;
+    std::vector<uint64_t> offsets;
+
+    // one small read per frame : the frame lines may carry parameters, their length is only known by reading them
+    while (pos < size)
+    {
+        const unsigned char *nl = (const unsigned char *)memchr(data + pos, '\n', std::min(FRAME_LINE_MAX, size - pos));
+        if ((size - pos < 5) || (memcmp(data + pos, "FRAME", 5) != 0) || (nl == nullptr))
+        {
+            spdlog::warn("{} : no frame at offset {}, {} frames kept", fname.c_str(), pos, offsets.size());
+            break;
+        }
+        size_t start = nl - data + 1;
+        if (start + format.frame_size > size)
+        {
+            spdlog::warn("{} : last frame truncated", fname.c_str());
+            break;
+        }
+        offsets.push_back(start);
+        pos = start + format.frame_size;
+    }
+    if (offsets.empty())
+        return false;
+
+    // frame lines all the same : a stride is enough
+    index->count = offsets.size();
+    index->first = offsets[0];
+    index->stride = (offsets.size() > 1) ? offsets[1] - offsets[0] : format.frame_size;
+    for (size_t n = 1; (n < offsets.size()) && (index->stride != 0); n++)
+    {
+        if (offsets[n] - offsets[n - 1] != index->stride)
+            index->stride = 0;
+    }
+    if (index->stride == 0)
+        index->offsets.swap(offsets);
+
+    spdlog::debug("Video {} : {} frames indexed{}", fname.c_str(), index->count, (index->stride == 0) ? ", irregular" : "");
+    return true;
+}
+
+bool VideoSource::load_index(const std::string &fname, frame_index_t *index)
+{
+    std::string ifname = index_fname(fname);
+    struct stat st;
+    MappedFile file;
+    if (!file_exists(ifname) || (stat(fname.c_str(), &st) != 0) || !file.open(ifname))
+        return false;
+
+    // magic, size and time of the video, count, first, stride, then the offsets of irregular frames
+    const size_t header = sizeof(INDEX_MAGIC) + 5 * sizeof(uint64_t);
+    uint64_t fields[5];
+    if ((file.size() < header) || (memcmp(file.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0))
+        return false;
+    memcpy(fields, file.data() + sizeof(INDEX_MAGIC), sizeof(fields));
+    if ((fields[0] != (uint64_t)st.st_size) || ((int64_t)fields[1] != manifest_mtime(st)))
+        return false;
+
+    index->count = fields[2];
+    index->first = fields[3];
+    index->stride = fields[4];
+    index->offsets.clear();
+    if (index->stride == 0)
+    {
+        if ((index->count > (file.size() - header) / sizeof(uint64_t)))
+            return false;
+        index->offsets.resize(index->count);
+        memcpy(index->offsets.data(), file.data() + header, index->count * sizeof(uint64_t));
+    }
+    return index->count > 0;
+}
+
+bool VideoSource::save_index(const std::string &fname, const frame_index_t &index)
+{
+    struct stat st;
+    if (stat(fname.c_str(), &st) != 0)
+        return false;
+
+    uint64_t fields[5] = {(uint64_t)st.st_size, (uint64_t)manifest_mtime(st), index.count, index.first, index.stride};
+    std::string s(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    s.append((const char *)fields, sizeof(fields));
+    s.append((const char *)index.offsets.data(), index.offsets.size() * sizeof(uint64_t));
+
+    // a read only folder : the index is built again next time
+    return write_file_atomic(index_fname(fname), s);
+}
+
+bool VideoSource::open(const std::string &fname)
+{
+    this->close();
+    if (!VideoSource::probe(fname, &this->fmt) || !this->file.open(fname))
+        return false;
+    if (!VideoSource::get_index(fname, this->fmt, this->file, &this->index))
+    {
+        spdlog::error("{} : no frame found", fname.c_str());
+        this->file.close();
+        return false;
+    }
+
+    this->fname = fname;
+    this->count = this->index.count;
+    spdlog::debug("Video {} : {} x {}, {} bits, {} frames", fname.c_str(), this->fmt.width, this->fmt.height, this->fmt.depth, this->count);
+    return true;
+}
+
+void VideoSource::close(void)
+{
+    this->file.close();
+    this->fname.clear();
+    this->index.offsets.clear();
+    this->index.count = 0;
+    this->count = 0;
+}
+
+size_t VideoSource::offset(long n)
+{
+    return (this->index.stride == 0) ? this->index.offsets[n] : this->index.first + n * this->index.stride;
+}
+
+bool VideoSource::frame(long n, video_frame_t *frame)
+{
+    if (!this->is_open() || (n < 0) || (n >= this->count))
+        return false;
+
+    // the index may be older than a file rewritten in place
+    size_t start = this->offset(n);
+    if (start + this->fmt.frame_size > this->file.size())
+        return false;
+
+    size_t bytes = (this->fmt.depth > 8) ? 2 : 1;
+    plane_sizes(this->fmt, frame->width, frame->height);
+    const unsigned char *p = this->file.data() + start;
+    for (int k = 0; k < 3; k++)
+    {
+        frame->planes[k] = (frame->width[k] > 0) ? p : nullptr;
+        p += (size_t)frame->width[k] * frame->height[k] * bytes;
+    }
+    frame->depth = this->fmt.depth;
+    return true;
+}
+
+void VideoSource::prefetch(long n, long count)
+{
+    for (long k = std::max(0L, n); (k < n + count) && (k < this->count); k++)
+        this->file.prefetch(this->offset(k), this->fmt.frame_size);
+}
+
+std::string video_frame_name(const std::string &video, long frame)
+{
+    // zero padded : the frames are in order in the sorted list
+    char number[32];
+    snprintf(number, sizeof(number), "%06ld", frame);
+    return video + "/" + number;
+}
+
+bool video_frame_of(const std::string &name, std::string *video, long *frame)
+{
+    size_t slash = name.find_last_of('/');
+    if ((slash == std::string::npos) || (slash + 1 == name.size()))
+        return false;
+    if (name.find_first_not_of("0123456789", slash + 1) != std::string::npos)
+        return false;
+    std::string parent = name.substr(0, slash);
+    if (!VideoSource::handles(parent))
+        return false;
+
+    *video = parent;
+    *frame = atol(name.c_str() + slash + 1);
+    return true;
+}
@@ -0,0 +1,239 @@
+#include "yacvat/voc.h"
+#include "yacvat/files.h"
+#include "yacvat/image_info.h"
+#include "spdlog/spdlog.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+static const size_t CHUNK_SIZE = 64; // images per task
+
+// minimal streaming xml writer : tags are written as they come, with indentation
+class XmlWriter
+{
+public:
+    XmlWriter(std::ostream &os) : os(os), depth(0) {}
+
+    void open(const char *tag)
+    {
+        this->indent();
+        this->os << "<" << tag << ">\n";
+        this->depth++;
+    }
+
+    void close(const char *tag)
+    {
+        this->depth--;
+        this->indent();
+        this->os << "</" << tag << ">\n";
+    }
+
+    void element(const char *tag, const std::string &value)
+    {
+        this->indent();
+        this->os << "<" << tag << ">";
+        this->escape(value);
+        this->os << "</" << tag << ">\n";
+    }
+
+    void element(const char *tag, long value)
+    {
+        this->indent();
+        this->os << "<" << tag << ">" << value << "</" << tag << ">\n";
+    }
+
+private:
+    std::ostream &os;
+    int depth;
+
+    void indent(void)
+    {
+        for (int k = 0; k < this->depth; k++)
+            this->os.put('\t');
+    }
+
+    void escape(const std::string &s)
+    {
+        for (char c : s)
+        {
+            switch (c)
+            {
+            case '<':
+                this->os << "&lt;";
+                break;
+            case '>':
+                this->os << "&gt;";
+                break;
+            case '&':
+                this->os << "&amp;";
+                break;
+            case '"':
+                this->os << "&quot;";
+                break;
+            case '\'':
+                this->os << "&apos;";
+                break;
+            default:
+                this->os.put(c);
+            }
+        }
+    }
+};
+
+// x.jpg -> x.xml, keeping the subfolders
+static std::string xml_fname_of(const std::string &img_fname)
+{
+    size_t slash = img_fname.find_last_of('/');
+    size_t dot = img_fname.find_last_of('.');
+    if ((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash)))
+        return img_fname + ".xml";
+    return img_fname.substr(0, dot) + ".xml";
+}
+
+// voc pixel coordinates are 1-based integers inside the image
+static long voc_coordinate(float v, int size)
+{
+    return std::min((long)size, std::max(1L, (long)std::lround(v) + 1));
+}
+
+VocExporter::VocExporter(void)
+{
+}
+
+bool VocExporter::start(ThreadPool &pool, std::string output_folder, std::string images_folder, std::vector<image_boxes_t> &images, std::vector<std::string> &classes)
+{
+    if (this->running())
+    {
+        spdlog::warn("A VOC export is already running");
+        return false;
+    }
+
+    this->job = std::make_shared<job_t>();
+    this->job->output_folder = output_folder;
+    this->job->images_folder = images_folder;
+    this->job->images.swap(images);
+    this->job->classes = classes;
+    this->job->done = 0;
+    this->job->failed = 0;
+
+    spdlog::info("Exporting {} images to VOC folder {}", this->job->images.size(), output_folder.c_str());
+
+    if (!make_directories(output_folder))
+    {
+        this->job->failed = this->job->images.size();
+        this->job->done = this->job->images.size();
+        return false;
+    }
+
+    // small chunks keep all the threads busy until the end, whatever the cost of each image
+    for (size_t start = 0; start < this->job->images.size(); start += CHUNK_SIZE)
+    {
+        size_t end = std::min(start + CHUNK_SIZE, this->job->images.size());
+        std::shared_ptr<job_t> _job = this->job;
+        pool.submit([_job, start, end]()
+                    { VocExporter::write_chunk(_job, start, end); });
+    }
+
+    return true;
+}
+
+bool VocExporter::running(void)
+{
+    return this->job && (this->job->done < (long)this->job->images.size());
+}
+
+long VocExporter::done(void)
+{
+    return this->job ? this->job->done.load() : 0;
+}
+
+long VocExporter::total(void)
+{
+    return this->job ? this->job->images.size() : 0;
+}
+
+long VocExporter::failed(void)
+{
+    return this->job ? this->job->failed.load() : 0;
+}
+
+void VocExporter::write_chunk(std::shared_ptr<job_t> job, size_t start, size_t end)
+{
+    // only the last component of the images folder is written in the <folder> tag
+    size_t pos = job->images_folder.find_last_of('/');
+    std::string folder_name = (pos == std::string::npos) ? job->images_folder : job->images_folder.substr(pos + 1);
+
+    std::string last_dir; // parent folder already created by this task
+    for (size_t n = start; n < end; n++)
+    {
+        const image_boxes_t &img = job->images[n];
+        std::string img_path = job->images_folder + "/" + img.fname;
+        std::string fname = job->output_folder + "/" + xml_fname_of(img.fname);
+
+        // without the size of the image the boxes cannot be written in its bounds : no file rather than a wrong one
+        int width = 0, height = 0, depth = 0;
+        if (!probe_image_size(img_path, &width, &height, &depth) || (width <= 0) || (height <= 0))
+        {
+            spdlog::warn("VOC export : unknown size for {}", img.fname.c_str());
+            job->failed++;
+            job->done++;
+            continue;
+        }
+
+        std::string dir = parent_directory(fname);
+        if (dir != last_dir)
+        {
+            if (!make_directories(dir))
+            {
+                job->failed++;
+                job->done++;
+                continue;
+            }
+            last_dir = dir;
+        }
+
+        std::ofstream f(fname.c_str(), std::ios::out | std::ios::trunc);
+        XmlWriter xml(f);
+
+        xml.open("annotation");
+        xml.element("folder", folder_name);
+        xml.element("filename", img.fname);
+        xml.element("path", img_path);
+        xml.open("source");
+        xml.element("database", "Unknown");
+        xml.close("source");
+        xml.open("size");
+        xml.element("width", width);
+        xml.element("height", height);
+        xml.element("depth", depth);
+        xml.close("size");
+        xml.element("segmented", 0);
+
+        for (auto &b : img.boxes)
+        {
+            xml.open("object");
+            xml.element("name", job->classes[b.label]);
+            xml.element("pose", "Unspecified");
+            xml.element("truncated", 0);
+            xml.element("difficult", 0);
+            xml.open("bndbox");
+            xml.element("xmin", voc_coordinate(std::min(b.x_start, b.x_end), width));
+            xml.element("ymin", voc_coordinate(std::min(b.y_start, b.y_end), height));
+            xml.element("xmax", voc_coordinate(std::max(b.x_start, b.x_end), width));
+            xml.element("ymax", voc_coordinate(std::max(b.y_start, b.y_end), height));
+            xml.close("bndbox");
+            xml.close("object");
+        }
+
+        xml.close("annotation");
+
+        f.close();
+        if (f.fail())
+        {
+            spdlog::error("Cannot write VOC file : {}", fname.c_str());
+            job->failed++;
+        }
+        job->done++;
+    }
+}
@@ -0,0 +1,61 @@
+#include "yacvat/wakeup.h"
+#include "spdlog/spdlog.h"
+
+#include <atomic>
+
+static std::atomic<Uint32> event_type(0);   // 0 until registered
+static std::atomic<bool> posted(false);      // an event is in the queue
+static std::atomic<Uint32> timer_target(0);  // tick of the next timer, 0 if none
+
+void ui_wakeup_init(void)
+{
+    Uint32 type = SDL_RegisterEvents(1);
+    if (type == (Uint32)-1)
+    {
+        spdlog::error("No SDL event left to wake up the ui : it is drawn continuously");
+        return;
+    }
+    event_type = type;
+}
+
+void ui_wakeup(void)
+{
+    Uint32 type = event_type;
+    if ((type == 0) || posted.exchange(true))
+        return;
+
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = type;
+    if (SDL_PushEvent(&event) != 1)
+        posted = false;
+}
+
+static Uint32 timer_callback(Uint32 interval, void *param)
+{
+    (void)interval;
+    (void)param;
+    timer_target = 0;
+    ui_wakeup();
+    return 0; // one shot
+}
+
+void ui_wakeup_after(Uint32 ms)
+{
+    // a timer firing earlier already draws a frame, which plans the next one if still needed
+    Uint32 target = SDL_GetTicks() + ms;
+    Uint32 current = timer_target;
+    if ((current != 0) && ((Sint32)(current - target) <= 0))
+        return;
+    timer_target = target;
+    if (SDL_AddTimer(ms, timer_callback, nullptr) == 0)
+        timer_target = 0;
+}
+
+bool ui_wakeup_event(const SDL_Event &event)
+{
+    if ((event_type == 0) || (event.type != event_type))
+        return false;
+    posted = false;
+    return true;
+}
@@ -0,0 +1,308 @@
+#include "yacvat/watcher.h"
+#include "yacvat/manifest.h"
+#include "yacvat/files.h"
+#include "yacvat/image_info.h"
+#include "yacvat/video_source.h"
+#include "yacvat/wakeup.h"
+#include "spdlog/spdlog.h"
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+static const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+FolderWatcher::FolderWatcher(void)
+{
+    this->inotify_fd = -1;
+    this->stop_pipe[0] = -1;
+    this->stop_pipe[1] = -1;
+}
+
+FolderWatcher::~FolderWatcher(void)
+{
+    this->stop();
+}
+
+bool FolderWatcher::start(std::string folder, const std::set<std::string> &extensions, const std::vector<std::pair<std::string, int64_t>> &folders)
+{
+    this->stop();
+
+    this->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->inotify_fd < 0)
+    {
+        spdlog::warn("Cannot watch folder {} : {}", folder.c_str(), strerror(errno));
+        return false;
+    }
+
+    if (pipe(this->stop_pipe) != 0)
+    {
+        close(this->inotify_fd);
+        this->inotify_fd = -1;
+        return false;
+    }
+
+    this->folder = folder;
+    this->extensions = extensions;
+    this->initial = folders;
+    this->worker = std::thread(&FolderWatcher::run, this);
+    return true;
+}
+
+void FolderWatcher::stop(void)
+{
+    if (this->worker.joinable())
+    {
+        char c = 0;
+        if (write(this->stop_pipe[1], &c, 1) != 1)
+            spdlog::error("Cannot stop the folder watcher");
+        this->worker.join();
+    }
+
+    if (this->inotify_fd >= 0)
+        close(this->inotify_fd);
+    for (int k = 0; k < 2; k++)
+    {
+        if (this->stop_pipe[k] >= 0)
+            close(this->stop_pipe[k]);
+        this->stop_pipe[k] = -1;
+    }
+    this->inotify_fd = -1;
+    this->watches.clear();
+    this->watched.clear();
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->events.clear();
+}
+
+void FolderWatcher::take(std::vector<watch_event_t> &events)
+{
+    events.clear();
+    std::lock_guard<std::mutex> lock(this->mutex);
+    events.swap(this->events);
+}
+
+void FolderWatcher::publish(std::vector<watch_event_t> &batch)
+{
+    if (batch.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->events.insert(this->events.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+    batch.clear();
+    ui_wakeup();
+}
+
+bool FolderWatcher::accepted(const std::string &name)
+{
+    // videos are listed frame by frame by the scan only : a stream being written would change on every event
+    return (name[0] != '.') && (this->extensions.find(file_extension(name)) != this->extensions.end()) && !VideoSource::handles(name);
+}
+
+bool FolderWatcher::decodable(const std::string &path)
+{
+    image_format_t format;
+    int width, height;
+    if (probe_image_file(this->folder + "/" + path, &format, &width, &height))
+        return true;
+    spdlog::warn("Ignoring {} : {} cannot be decoded", path.c_str(), image_format_name(format));
+    return false;
+}
+
+void FolderWatcher::add_watch(const std::string &path, std::vector<watch_event_t> &batch, bool list)
+{
+    std::string full_path = path.empty() ? this->folder : this->folder + "/" + path;
+    int wd = inotify_add_watch(this->inotify_fd, full_path.c_str(), WATCH_MASK);
+    if (wd < 0)
+    {
+        // usually the limit of fs.inotify.max_user_watches
+        spdlog::warn("Cannot watch folder {} : {}", full_path.c_str(), strerror(errno));
+        return;
+    }
+    this->watches[wd] = path;
+    this->watched[path] = wd;
+
+    if (!list)
+        return;
+
+    // images already there when the watch started, and sub folders to watch
+    DIR *dir = opendir(full_path.c_str());
+    if (dir == nullptr)
+        return;
+
+    struct dirent *diread;
+    std::vector<std::string> subdirs;
+    while ((diread = readdir(dir)) != nullptr)
+    {
+        if (diread->d_name[0] == '.')
+            continue;
+
+        std::string fn = diread->d_name;
+        unsigned char type = diread->d_type;
+        if (type == DT_UNKNOWN)
+        {
+            struct stat st;
+            if (fstatat(dirfd(dir), fn.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+        }
+
+        if (type == DT_DIR)
+            subdirs.push_back(manifest_join(path, fn));
+        else if (this->accepted(fn) && this->decodable(manifest_join(path, fn)))
+            batch.push_back({WATCH_ADDED, manifest_join(path, fn), ""});
+    }
+    closedir(dir);
+
+    for (auto &sub : subdirs)
+    {
+        if (this->watched.find(sub) == this->watched.end())
+            this->add_watch(sub, batch, true);
+    }
+}
+
+void FolderWatcher::drop_watches(const std::string &path)
+{
+    std::string prefix = path + "/";
+    for (auto it = this->watches.begin(); it != this->watches.end();)
+    {
+        if ((it->second == path) || (it->second.compare(0, prefix.size(), prefix) == 0))
+        {
+            inotify_rm_watch(this->inotify_fd, it->first);
+            this->watched.erase(it->second);
+            it = this->watches.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void FolderWatcher::run(void)
+{
+    std::vector<watch_event_t> batch;
+
+    // watch everything first, then list the folders which changed since their scan
+    for (auto &f : this->initial)
+        this->add_watch(f.first, batch, false);
+    for (auto &f : this->initial)
+    {
+        struct stat st;
+        std::string full_path = f.first.empty() ? this->folder : this->folder + "/" + f.first;
+        if ((stat(full_path.c_str(), &st) == 0) && (manifest_mtime(st) != f.second))
+            this->add_watch(f.first, batch, true);
+    }
+    this->initial.clear();
+    this->publish(batch);
+    spdlog::info("Watching {} folders of {}", this->watches.size(), this->folder.c_str());
+
+    // buffer aligned for struct inotify_event
+    alignas(struct inotify_event) char buffer[64 * 1024];
+
+    while (true)
+    {
+        struct pollfd fds[2];
+        fds[0].fd = this->inotify_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = this->stop_pipe[0];
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents)
+            break;
+
+        ssize_t length = read(this->inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            continue;
+
+        // files moved out, waiting for the other end of the move in the same read
+        std::unordered_map<uint32_t, std::string> moved_from;
+
+        for (char *p = buffer; p < buffer + length;)
+        {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                spdlog::warn("Too many changes in {}, reopen the folder to list them all", this->folder.c_str());
+                continue;
+            }
+
+            auto w = this->watches.find(ev->wd);
+            if (w == this->watches.end())
+                continue;
+            if (ev->mask & IN_IGNORED)
+            {
+                this->watched.erase(w->second);
+                this->watches.erase(w);
+                continue;
+            }
+            if ((ev->len == 0) || (ev->name[0] == '.'))
+                continue;
+
+            std::string path = manifest_join(w->second, ev->name);
+
+            if (ev->mask & IN_ISDIR)
+            {
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    this->add_watch(path, batch, true);
+                }
+                else if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+                {
+                    this->drop_watches(path);
+                    batch.push_back({WATCH_FOLDER_REMOVED, path, ""});
+                }
+                continue;
+            }
+
+            if (ev->mask & IN_CLOSE_WRITE)
+            {
+                if (this->accepted(ev->name) && this->decodable(path))
+                    batch.push_back({WATCH_ADDED, path, ""});
+            }
+            else if (ev->mask & IN_DELETE)
+            {
+                if (this->accepted(ev->name))
+                    batch.push_back({WATCH_REMOVED, path, ""});
+            }
+            else if (ev->mask & IN_MOVED_FROM)
+            {
+                moved_from[ev->cookie] = path;
+            }
+            else if (ev->mask & IN_MOVED_TO)
+            {
+                auto from = moved_from.find(ev->cookie);
+                bool from_accepted = (from != moved_from.end()) && this->accepted(from->second.substr(from->second.find_last_of('/') + 1));
+                if (from_accepted && this->accepted(ev->name))
+                    batch.push_back({WATCH_RENAMED, from->second, path});
+                else if (from_accepted)
+                    batch.push_back({WATCH_REMOVED, from->second, ""});
+                else if (this->accepted(ev->name) && this->decodable(path))
+                    batch.push_back({WATCH_ADDED, path, ""});
+                if (from != moved_from.end())
+                    moved_from.erase(from);
+            }
+        }
+
+        // moved out of the watched tree
+        for (auto &m : moved_from)
+        {
+            if (this->accepted(m.second.substr(m.second.find_last_of('/') + 1)))
+                batch.push_back({WATCH_REMOVED, m.second, ""});
+        }
+
+        this->publish(batch);
+    }
+}
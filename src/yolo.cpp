@@ -0,0 +1,253 @@
+#include "yacvat/yolo.h"
+#include "yacvat/files.h"
+#include "yacvat/image_info.h"
+#include "spdlog/spdlog.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+static const char JOURNAL_FNAME[] = ".yacvat-yolo-sync";
+
+// usual yolo layout : dataset/images/x.jpg -> dataset/labels/x.txt
+static std::string labels_folder_of(const std::string &folder)
+{
+    size_t pos = folder.find_last_of('/');
+    std::string last = (pos == std::string::npos) ? folder : folder.substr(pos + 1);
+    if (last == "images")
+        return ((pos == std::string::npos) ? std::string("") : folder.substr(0, pos + 1)) + "labels";
+    return folder + "/labels";
+}
+
+// x.jpg -> x.txt, keeping the subfolders
+static std::string label_fname_of(const std::string &img_fname)
+{
+    size_t slash = img_fname.find_last_of('/');
+    size_t dot = img_fname.find_last_of('.');
+    if ((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash)))
+        return img_fname + ".txt";
+    return img_fname.substr(0, dot) + ".txt";
+}
+
+// FNV-1a over the values of the boxes
+static uint64_t hash_boxes(const std::vector<image_box_t> &boxes)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (auto &b : boxes)
+    {
+        float v[4] = {b.x_start, b.y_start, b.x_end, b.y_end};
+        unsigned char bytes[sizeof(int) + sizeof(v)];
+        memcpy(bytes, &b.label, sizeof(int));
+        memcpy(bytes + sizeof(int), v, sizeof(v));
+        for (unsigned k = 0; k < sizeof(bytes); k++)
+        {
+            h ^= bytes[k];
+            h *= 0x100000001b3ULL;
+        }
+    }
+    return h;
+}
+
+static float clamp01(float v)
+{
+    return std::min(1.0f, std::max(0.0f, v));
+}
+
+YoloSync::YoloSync(void)
+{
+    this->stop_flag = false;
+    this->busy_flag = false;
+    this->nwritten = 0;
+    this->worker = std::thread(&YoloSync::run, this);
+}
+
+YoloSync::~YoloSync(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stop_flag = true;
+    }
+    this->cond.notify_all();
+    this->worker.join();
+}
+
+void YoloSync::set_folder(std::string folder)
+{
+    this->images_folder = folder;
+    this->labels_folder = labels_folder_of(folder);
+}
+
+bool YoloSync::exists(void)
+{
+    return !this->labels_folder.empty() && file_exists(this->labels_folder + "/" + JOURNAL_FNAME);
+}
+
+void YoloSync::request(std::vector<image_boxes_t> &images, std::vector<std::string> &classes)
+{
+    job_t job;
+    job.images_folder = this->images_folder;
+    job.labels_folder = this->labels_folder;
+    job.images.swap(images);
+    job.classes = classes;
+
+    spdlog::debug("YOLO sync requested for {} images", job.images.size());
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back(std::move(job));
+    }
+    this->cond.notify_one();
+}
+
+bool YoloSync::busy(void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->busy_flag || !this->jobs.empty();
+}
+
+void YoloSync::run(void)
+{
+    while (true)
+    {
+        job_t job;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->cond.wait(lock, [this]
+                            { return this->stop_flag || !this->jobs.empty(); });
+
+            // stop requested and nothing left to do
+            if (this->jobs.empty())
+                return;
+
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+            this->busy_flag = true;
+        }
+
+        this->process(job);
+        this->busy_flag = false;
+    }
+}
+
+void YoloSync::load_journal(job_t &job)
+{
+    this->synced.clear();
+    this->sizes.clear();
+    this->synced_classes.clear();
+    this->synced_folder = job.labels_folder;
+
+    // hashes of the previous syncs, the last line of an image wins
+    std::string journal_fname = job.labels_folder + "/" + JOURNAL_FNAME;
+    std::ifstream f(journal_fname.c_str());
+    std::string line;
+    long nlines = 0;
+    while (std::getline(f, line))
+    {
+        size_t pos = line.find(' ');
+        if (pos == std::string::npos)
+            continue;
+        this->synced[line.substr(pos + 1)] = strtoull(line.substr(0, pos).c_str(), nullptr, 16);
+        nlines++;
+    }
+    f.close();
+
+    std::ifstream fc((job.labels_folder + "/classes.txt").c_str());
+    std::stringstream ss;
+    ss << fc.rdbuf();
+    this->synced_classes = ss.str();
+
+    // compact the journal when most of its lines are outdated
+    if (nlines > 2 * (long)this->synced.size() + 1024)
+    {
+        spdlog::debug("Compacting YOLO journal : {} lines for {} images", nlines, this->synced.size());
+        std::ostringstream os;
+        for (auto it = this->synced.begin(); it != this->synced.end(); ++it)
+            os << std::hex << it->second << std::dec << " " << it->first << "\n";
+        write_file_atomic(journal_fname, os.str());
+    }
+
+    spdlog::debug("YOLO journal : {} images already synced", this->synced.size());
+}
+
+void YoloSync::process(job_t &job)
+{
+    if (job.labels_folder != this->synced_folder)
+        this->load_journal(job);
+
+    if (!make_directories(job.labels_folder))
+        return;
+
+    // class names, one per line, in the order of the class ids
+    std::string classes;
+    for (auto &c : job.classes)
+        classes += c + "\n";
+    if (classes != this->synced_classes)
+    {
+        if (write_file_atomic(job.labels_folder + "/classes.txt", classes))
+            this->synced_classes = classes;
+    }
+
+    std::ofstream journal((job.labels_folder + "/" + JOURNAL_FNAME).c_str(), std::ios::out | std::ios::app);
+    long nwritten = 0;
+
+    for (auto &img : job.images)
+    {
+        uint64_t h = hash_boxes(img.boxes);
+        auto it = this->synced.find(img.fname);
+
+        // unchanged since the last sync (no file is expected for an image never annotated)
+        if (((it != this->synced.end()) && (it->second == h)) || ((it == this->synced.end()) && img.boxes.empty()))
+            continue;
+
+        std::string fname = job.labels_folder + "/" + label_fname_of(img.fname);
+
+        if (img.boxes.empty())
+        {
+            // background image : no label file
+            std::remove(fname.c_str());
+        }
+        else
+        {
+            // true size of the image, probed once it is known (a failure is not kept, it is retried on the next sync)
+            auto s = this->sizes.find(img.fname);
+            if (s == this->sizes.end())
+            {
+                int width = 0, height = 0;
+                if (!probe_image_size(job.images_folder + "/" + img.fname, &width, &height) || (width <= 0) || (height <= 0))
+                {
+                    spdlog::warn("YOLO sync : unknown size for {}", img.fname.c_str());
+                    continue;
+                }
+                s = this->sizes.insert(std::make_pair(img.fname, std::make_pair(width, height))).first;
+            }
+            float width = s->second.first;
+            float height = s->second.second;
+
+            std::string content;
+            char line[128];
+            for (auto &b : img.boxes)
+            {
+                float x0 = clamp01(std::min(b.x_start, b.x_end) / width);
+                float x1 = clamp01(std::max(b.x_start, b.x_end) / width);
+                float y0 = clamp01(std::min(b.y_start, b.y_end) / height);
+                float y1 = clamp01(std::max(b.y_start, b.y_end) / height);
+                snprintf(line, sizeof(line), "%d %.6f %.6f %.6f %.6f\n", b.label, 0.5 * (x0 + x1), 0.5 * (y0 + y1), x1 - x0, y1 - y0);
+                content += line;
+            }
+
+            if (!make_directories(parent_directory(fname)) || !write_file_atomic(fname, content))
+                continue;
+        }
+
+        this->synced[img.fname] = h;
+        journal << std::hex << h << std::dec << " " << img.fname << "\n";
+        nwritten++;
+    }
+
+    journal.close();
+    this->nwritten += nwritten;
+    spdlog::info("YOLO sync : {} label files updated out of {} images", nwritten, job.images.size());
+}
@@ -0,0 +1,46 @@
+// Build step : rasterise the fonts of the ui and write the atlas as a C++ source linked into yacvatlib
+// usage : bake_fonts <output.cpp>
+
+#include "yacvat/font_atlas.h"
+
+#include <stdio.h>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage : %s <output.cpp>\n", argv[0]);
+        return 1;
+    }
+
+    ImFontAtlas atlas;
+    font_atlas_add_fonts(&atlas);
+    std::vector<unsigned char> blob;
+    if (!font_atlas_bake(&atlas, blob))
+    {
+        fprintf(stderr, "cannot build the font atlas\n");
+        return 1;
+    }
+
+    FILE *f = fopen(argv[1], "w");
+    if (f == nullptr)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    fprintf(f, "// Generated by bake_fonts : atlas of the fonts of the ui (%zu bytes)\n", blob.size());
+    fprintf(f, "#include <stddef.h>\n\n");
+    fprintf(f, "extern const unsigned char font_atlas_blob[];\n");
+    fprintf(f, "extern const size_t font_atlas_blob_size;\n\n");
+    fprintf(f, "alignas(16) const unsigned char font_atlas_blob[%zu] =\n{", blob.size());
+    for (size_t n = 0; n < blob.size(); n++)
+        fprintf(f, "%s0x%02x,", (n % 16 == 0) ? "\n    " : " ", blob[n]);
+    fprintf(f, "\n};\n\nconst size_t font_atlas_blob_size = %zu;\n", blob.size());
+    if (fclose(f) != 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    return 0;
+}